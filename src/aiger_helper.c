@@ -46,8 +46,8 @@ void encode_and_as(aiger* aig, unsigned* next_lit, int_queue* aiger_lits, unsign
  */
 void encode_or_as(aiger* aig, unsigned* next_lit, int_queue* aiger_lits, unsigned dest_aiger_lit) {
     // negate literals in aiger_lits first
-    for (int_queue_element* element = aiger_lits->first; element != NULL; element = element->next) {
-        element->value = (int)aiger_not(element->value);
+    for (size_t i = 0; i < int_queue_count(aiger_lits); i++) {
+        int_queue_set(aiger_lits, i, (int)aiger_not(int_queue_get(aiger_lits, i)));
     }
     encode_and_as(aig, next_lit, aiger_lits, dest_aiger_lit);
 }
@@ -90,8 +90,8 @@ unsigned encode_and(aiger* aig, unsigned* next_lit, int_queue* aiger_lits) {
 
 unsigned encode_or(aiger* aig, unsigned* next_lit, int_queue* aiger_lits) {
     // negate literals in aiger_lits first
-    for (int_queue_element* element = aiger_lits->first; element != NULL; element = element->next) {
-        element->value = (int)aiger_not(element->value);
+    for (size_t i = 0; i < int_queue_count(aiger_lits); i++) {
+        int_queue_set(aiger_lits, i, (int)aiger_not(int_queue_get(aiger_lits, i)));
     }
     return aiger_not(encode_and(aig, next_lit, aiger_lits));
 }
@@ -0,0 +1,215 @@
+//
+//  batch.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "circuit.h"
+#include "logging.h"
+#include "qcir.h"
+#include "statistics.h"
+
+typedef struct {
+    vector* instances;
+    const SolverOptions* options;
+    FILE* output;
+    verbosity verbosity;  // logging verbosity is thread local, workers inherit the one of the caller
+
+    pthread_mutex_t mutex;  // protects next_instance, num_failed, and output
+    size_t next_instance;
+    size_t num_failed;
+} batch_state;
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static bool has_qcir_extension(const char* name) {
+    const char* extension = ".qcir";
+    const size_t length = strlen(name);
+    const size_t extension_length = strlen(extension);
+    return length > extension_length && strcmp(name + length - extension_length, extension) == 0;
+}
+
+static vector* collect_directory(const char* directory) {
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        logging_error("Cannot open directory %s\n", directory);
+        return NULL;
+    }
+    vector* files = vector_init();
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!has_qcir_extension(entry->d_name)) {
+            continue;
+        }
+        const size_t length = strlen(directory) + strlen(entry->d_name) + 2;
+        char* path = malloc(length);
+        snprintf(path, length, "%s/%s", directory, entry->d_name);
+        vector_add(files, path);
+    }
+    closedir(dir);
+
+    // sort such that the output order is reproducible
+    char** paths = malloc(sizeof(char*) * vector_count(files));
+    for (size_t i = 0; i < vector_count(files); i++) {
+        paths[i] = vector_get(files, i);
+    }
+    qsort(paths, vector_count(files), sizeof(char*), compare_strings);
+    for (size_t i = 0; i < vector_count(files); i++) {
+        vector_set(files, i, paths[i]);
+    }
+    free(paths);
+    return files;
+}
+
+static vector* collect_list(const char* list) {
+    FILE* file = fopen(list, "r");
+    if (file == NULL) {
+        logging_error("Cannot open instance list %s\n", list);
+        return NULL;
+    }
+    vector* files = vector_init();
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &size, file)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
+        vector_add(files, strdup(line));
+    }
+    free(line);
+    fclose(file);
+    return files;
+}
+
+vector* batch_collect_instances(const char* path) {
+    struct stat path_stat;
+    if (stat(path, &path_stat) != 0) {
+        logging_error("Cannot access %s\n", path);
+        return NULL;
+    }
+    if (S_ISDIR(path_stat.st_mode)) {
+        return collect_directory(path);
+    }
+    return collect_list(path);
+}
+
+void batch_free_instances(vector* instances) {
+    for (size_t i = 0; i < vector_count(instances); i++) {
+        free(vector_get(instances, i));
+    }
+    vector_free(instances);
+}
+
+static const char* result_name(qbf_res result) {
+    switch (result) {
+        case QBF_RESULT_SAT:
+            return "sat";
+        case QBF_RESULT_UNSAT:
+            return "unsat";
+        default:
+            return "unknown";
+    }
+}
+
+static void solve_instance(batch_state* state, SolverOptions* options, const char* file_name) {
+    Stats* total = statistics_init(10000);
+    Stats* parsing = statistics_init(10000);
+    statistics_start_timer(total);
+    statistics_start_timer(parsing);
+    Circuit* circuit = circuit_init();
+    int error = circuit_open_and_read_qcir_file(circuit, file_name, false);
+    statistics_stop_and_record_timer(parsing);
+
+    if (error) {
+        circuit_free(circuit);
+        pthread_mutex_lock(&state->mutex);
+        fprintf(state->output, "%s,error,,,,,,\n", file_name);
+        state->num_failed++;
+        pthread_mutex_unlock(&state->mutex);
+    } else {
+        Solver* solver = solver_init(options, circuit);
+        qbf_res result = solver_sat(solver);
+        statistics_stop_and_record_timer(total);
+
+        pthread_mutex_lock(&state->mutex);
+        fprintf(state->output, "%s,%s,%f,%f,%f,%f,%f,%f\n", file_name, result_name(result),
+                total->accumulated_value,
+                parsing->accumulated_value,
+                solver_get_phase_time(solver, SOLVER_PHASE_REENCODING),
+                solver_get_phase_time(solver, SOLVER_PHASE_PREPROCESSING),
+                solver_get_phase_time(solver, SOLVER_PHASE_BUILDING_ABSTRACTION),
+                solver_get_phase_time(solver, SOLVER_PHASE_SOLVING));
+        fflush(state->output);
+        pthread_mutex_unlock(&state->mutex);
+        solver_free(solver);
+    }
+    statistics_free(parsing);
+    statistics_free(total);
+}
+
+static void* batch_worker(void* data) {
+    batch_state* state = data;
+    logging_set_verbosity(state->verbosity);
+
+    // every worker has its own copy of the options as the solver may keep a pointer
+    SolverOptions options = *state->options;
+
+    while (true) {
+        pthread_mutex_lock(&state->mutex);
+        const size_t index = state->next_instance++;
+        pthread_mutex_unlock(&state->mutex);
+        if (index >= vector_count(state->instances)) {
+            break;
+        }
+        solve_instance(state, &options, vector_get(state->instances, index));
+    }
+    return NULL;
+}
+
+size_t batch_solve(vector* instances, const SolverOptions* options, size_t num_workers, FILE* output) {
+    api_expect(num_workers > 0, "at least one worker is needed\n");
+    api_expect(!options->certify && !options->partial_assignment, "certification and partial assignments are not supported in batch mode\n");
+
+    batch_state state;
+    state.instances = instances;
+    state.options = options;
+    state.output = output;
+    state.verbosity = logging_get_verbosity();
+    pthread_mutex_init(&state.mutex, NULL);
+    state.next_instance = 0;
+    state.num_failed = 0;
+
+    if (num_workers > vector_count(instances)) {
+        num_workers = vector_count(instances);
+    }
+
+    fprintf(output, "file,result,time,parse,reencode,preprocess,build_abstraction,solve\n");
+    fflush(output);
+
+    pthread_t* workers = malloc(sizeof(pthread_t) * num_workers);
+    for (size_t i = 0; i < num_workers; i++) {
+        pthread_create(&workers[i], NULL, batch_worker, &state);
+    }
+    for (size_t i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    pthread_mutex_destroy(&state.mutex);
+    return state.num_failed;
+}
@@ -0,0 +1,32 @@
+//
+//  batch.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef batch_h
+#define batch_h
+
+#include <stdio.h>
+
+#include "solver.h"
+#include "vector.h"
+
+/**
+ * Returns the list of instances given by path, which is either a directory,
+ * in which case all *.qcir files are returned in sorted order, or a file
+ * containing one instance per line. Returns NULL on error.
+ */
+vector* batch_collect_instances(const char* path);
+void batch_free_instances(vector*);
+
+/**
+ * Solves all instances on num_workers threads and writes one CSV line per
+ * instance in the order of completion: file, result, and the time in seconds
+ * in total and per phase. Returns the number of instances that could not be
+ * solved. Certification and partial assignments are not supported.
+ */
+size_t batch_solve(vector* instances, const SolverOptions*, size_t num_workers, FILE* output);
+
+#endif /* batch_h */
@@ -0,0 +1,306 @@
+//
+//  bench.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "batch.h"
+#include "circuit.h"
+#include "qcir.h"
+#include "solver.h"
+#include "statistics.h"
+#include "logging.h"
+#include "getopt.h"
+
+typedef enum {
+    BENCH_PHASE_PARSING = 0,
+    BENCH_PHASE_REENCODING,
+    BENCH_PHASE_PREPROCESSING,
+    BENCH_PHASE_BUILDING_ABSTRACTION,
+    BENCH_PHASE_SOLVING,
+    BENCH_PHASE_NUM
+} bench_phase;
+
+static const char* phase_names[BENCH_PHASE_NUM] = {
+    "parse",
+    "reencode",
+    "preprocess",
+    "build_abstraction",
+    "solve"
+};
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} output_format;
+
+typedef struct {
+    qbf_res result;
+    double min[BENCH_PHASE_NUM];
+    double median[BENCH_PHASE_NUM];
+    double max[BENCH_PHASE_NUM];
+    long peak_rss;  // in KiB
+} bench_result;
+
+static void print_usage(const char* name) {
+    printf("usage: %s [options] directory/list\n\n"
+           "Runs every *.qcir file in directory (or every file in list, one per line)\n"
+           "in process and reports per-phase minimum/median/maximum wall-clock time\n"
+           "in seconds.\n\n"
+           "options:\n"
+           "  --repetitions N           number of measured runs per instance (default 5)\n"
+           "  --warmup N                number of unmeasured runs per instance (default 1)\n"
+           "  --format csv/json         output format (default csv)\n"
+           "  --output FILE             write results to FILE instead of stdout\n"
+           "  --preprocessing 1/0       enable/disable preprocessing (default 1)\n"
+           "  --miniscoping 1/0         enable/disable miniscoping (default 0)\n"
+           "  -h/--help                 show this message and exit\n", name);
+}
+
+static bool parse_boolean_argument(const char* cmd, const char* arg) {
+    if (strlen(arg) != 1 || (arg[0] != '1' && arg[0] != '0')) {
+        logging_fatal("Wrong argument %s for %s, expect 0/1\n", arg, cmd);
+    }
+    return arg[0] == '1';
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static long get_peak_rss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // reported in bytes
+#else
+    return usage.ru_maxrss;  // reported in kilobytes
+#endif
+}
+
+/**
+ * Runs all phases on a freshly parsed circuit and stores the time spent in each phase.
+ */
+static bool run_instance(const char* file_name, SolverOptions* options, double* times, qbf_res* result) {
+    Stats* parsing_time = statistics_init(10000);
+    statistics_start_timer(parsing_time);
+    Circuit* circuit = circuit_init();
+    int error = circuit_open_and_read_qcir_file(circuit, file_name, false);
+    statistics_stop_and_record_timer(parsing_time);
+    times[BENCH_PHASE_PARSING] = parsing_time->accumulated_value;
+    statistics_free(parsing_time);
+    if (error) {
+        circuit_free(circuit);
+        return false;
+    }
+
+    Solver* solver = solver_init(options, circuit);
+    *result = solver_sat(solver);
+    times[BENCH_PHASE_REENCODING] = solver_get_phase_time(solver, SOLVER_PHASE_REENCODING);
+    times[BENCH_PHASE_PREPROCESSING] = solver_get_phase_time(solver, SOLVER_PHASE_PREPROCESSING);
+    times[BENCH_PHASE_BUILDING_ABSTRACTION] = solver_get_phase_time(solver, SOLVER_PHASE_BUILDING_ABSTRACTION);
+    times[BENCH_PHASE_SOLVING] = solver_get_phase_time(solver, SOLVER_PHASE_SOLVING);
+    solver_free(solver);
+    return true;
+}
+
+static bool benchmark_instance(const char* file_name, SolverOptions* options, size_t warmup, size_t repetitions, bench_result* bench) {
+    assert(repetitions > 0);
+    double times[BENCH_PHASE_NUM];
+
+    for (size_t i = 0; i < warmup; i++) {
+        if (!run_instance(file_name, options, times, &bench->result)) {
+            return false;
+        }
+    }
+
+    double* samples = malloc(sizeof(double) * BENCH_PHASE_NUM * repetitions);
+    for (size_t i = 0; i < repetitions; i++) {
+        if (!run_instance(file_name, options, times, &bench->result)) {
+            free(samples);
+            return false;
+        }
+        for (size_t phase = 0; phase < BENCH_PHASE_NUM; phase++) {
+            samples[phase * repetitions + i] = times[phase];
+        }
+    }
+
+    for (size_t phase = 0; phase < BENCH_PHASE_NUM; phase++) {
+        double* phase_samples = samples + phase * repetitions;
+        qsort(phase_samples, repetitions, sizeof(double), compare_doubles);
+        bench->min[phase] = phase_samples[0];
+        bench->max[phase] = phase_samples[repetitions - 1];
+        if (repetitions % 2 == 1) {
+            bench->median[phase] = phase_samples[repetitions / 2];
+        } else {
+            bench->median[phase] = (phase_samples[repetitions / 2 - 1] + phase_samples[repetitions / 2]) / 2;
+        }
+    }
+    free(samples);
+
+    // the resident set size is monotone over the process lifetime, thus, it is an upper bound
+    // for instances that are not the most memory consuming so far
+    bench->peak_rss = get_peak_rss();
+    return true;
+}
+
+static const char* result_name(qbf_res result) {
+    switch (result) {
+        case QBF_RESULT_SAT:
+            return "sat";
+        case QBF_RESULT_UNSAT:
+            return "unsat";
+        default:
+            return "unknown";
+    }
+}
+
+static void print_csv_header(FILE* output) {
+    fprintf(output, "file,result");
+    for (size_t phase = 0; phase < BENCH_PHASE_NUM; phase++) {
+        fprintf(output, ",%s_min,%s_median,%s_max", phase_names[phase], phase_names[phase], phase_names[phase]);
+    }
+    fprintf(output, ",peak_rss_kib\n");
+}
+
+static void print_csv_result(FILE* output, const char* file_name, bench_result* bench) {
+    fprintf(output, "%s,%s", file_name, result_name(bench->result));
+    for (size_t phase = 0; phase < BENCH_PHASE_NUM; phase++) {
+        fprintf(output, ",%f,%f,%f", bench->min[phase], bench->median[phase], bench->max[phase]);
+    }
+    fprintf(output, ",%ld\n", bench->peak_rss);
+}
+
+static void print_json_result(FILE* output, const char* file_name, bench_result* bench, bool first) {
+    fprintf(output, "%s\n  {\"file\": \"%s\", \"result\": \"%s\", \"phases\": {", first ? "" : ",", file_name, result_name(bench->result));
+    for (size_t phase = 0; phase < BENCH_PHASE_NUM; phase++) {
+        fprintf(output, "%s\"%s\": {\"min\": %f, \"median\": %f, \"max\": %f}", phase == 0 ? "" : ", ", phase_names[phase], bench->min[phase], bench->median[phase], bench->max[phase]);
+    }
+    fprintf(output, "}, \"peak_rss_kib\": %ld}", bench->peak_rss);
+}
+
+int main(int argc, char* const argv[]) {
+    const char* directory = NULL;
+    const char* volatile output_file_name = NULL;
+    volatile size_t repetitions = 5;
+    volatile size_t warmup = 1;
+    volatile output_format format = FORMAT_CSV;
+    SolverOptions* options = solver_get_default_options();
+
+    const char* ch;
+    while ((ch = GETOPT(argc, argv)) != NULL) {
+        GETOPT_SWITCH(ch) {
+        GETOPT_OPT("-h"):
+        GETOPT_OPT("--help"):
+            print_usage(argv[0]);
+            return 0;
+            break;
+        GETOPT_OPTARG("--repetitions"):
+            repetitions = strtoul(optarg, NULL, 0);
+            if (repetitions == 0) {
+                logging_error("Illegal number of repetitions %s\n", optarg);
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        GETOPT_OPTARG("--warmup"):
+            warmup = strtoul(optarg, NULL, 0);
+            break;
+        GETOPT_OPTARG("--format"):
+            if (strcmp(optarg, "csv") == 0) {
+                format = FORMAT_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                format = FORMAT_JSON;
+            } else {
+                logging_error("Unknown output format %s, expect csv/json\n", optarg);
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        GETOPT_OPTARG("--output"):
+            output_file_name = optarg;
+            break;
+        GETOPT_OPTARG("--preprocessing"):
+            options->preprocess = parse_boolean_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--miniscoping"):
+            options->miniscoping = parse_boolean_argument(ch, optarg);
+            break;
+        GETOPT_MISSING_ARG:
+            printf("missing argument to %s\n", ch);
+            /* FALLTHROUGH */
+        GETOPT_DEFAULT:
+            printf("unknown argument %s\n", ch);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    directory = argv[optind];
+
+    FILE* output = stdout;
+    if (output_file_name != NULL) {
+        output = fopen(output_file_name, "w");
+        if (output == NULL) {
+            logging_error("Cannot open output file %s\n", output_file_name);
+            return 1;
+        }
+    } else {
+        // solver messages would interleave with the results
+        logging_set_verbosity(VERBOSITY_NONE);
+    }
+
+    vector* instances = batch_collect_instances(directory);
+    if (instances == NULL) {
+        return 1;
+    }
+
+    if (format == FORMAT_CSV) {
+        print_csv_header(output);
+    } else {
+        fprintf(output, "[");
+    }
+
+    bool first = true;
+    int exit_code = 0;
+    for (size_t i = 0; i < vector_count(instances); i++) {
+        const char* file_name = vector_get(instances, i);
+        bench_result bench;
+        if (!benchmark_instance(file_name, options, warmup, repetitions, &bench)) {
+            logging_error("Failed to benchmark %s\n", file_name);
+            exit_code = 1;
+            continue;
+        }
+        if (format == FORMAT_CSV) {
+            print_csv_result(output, file_name, &bench);
+        } else {
+            print_json_result(output, file_name, &bench, first);
+        }
+        first = false;
+        fflush(output);
+    }
+
+    if (format == FORMAT_JSON) {
+        fprintf(output, "\n]\n");
+    }
+
+    if (output != stdout) {
+        fclose(output);
+    }
+    batch_free_instances(instances);
+    free(options);
+    return exit_code;
+}
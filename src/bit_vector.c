@@ -33,6 +33,12 @@
 
 typedef uint64_t word;
 
+#define BITS_PER_WORD (sizeof(word) * 8)
+
+// Maximal number of non-zero words that are tracked in sparse mode.
+// Vectors with at most this many words are always dense.
+#define SPARSE_MAX_WORDS 16
+
 // Implement clausal abstraction as bit-vector
 struct bit_vector {
     size_t offset;
@@ -40,15 +46,48 @@ struct bit_vector {
     size_t num_words;
     size_t iteration;
     word* data;
+    
+    // Cached summaries, recomputed lazily when invalidated
+    size_t count;
+    bool count_valid;
+    size_t min_index;  // relative to offset, BIT_VECTOR_NO_ENTRY if empty
+    size_t max_index;
+    bool bounds_valid;
+    
+    // Sparse representation: sorted indices of all words that may be non-zero.
+    // Falls back to dense mode if more than SPARSE_MAX_WORDS words are touched.
+    bool sparse;
+    size_t num_touched;
+    size_t touched[SPARSE_MAX_WORDS];
 };
 
+static inline size_t count_trailing_zeros(word w) {
+    assert(w != 0);
+    return (size_t)__builtin_ctzll(w);
+}
+
+static inline size_t count_leading_zeros(word w) {
+    assert(w != 0);
+    return (size_t)__builtin_clzll(w);
+}
+
+static inline size_t population_count(word w) {
+    return (size_t)__builtin_popcountll(w);
+}
+
 bit_vector* bit_vector_init(size_t offset, size_t max_num) {
     bit_vector* ca = malloc(sizeof(bit_vector));
     ca->offset = offset;
     ca->max = max_num;
-    ca->num_words = max_num / sizeof(word) + 1;
-    ca->data = malloc(sizeof(word) * ca->num_words);
-    bit_vector_reset(ca);
+    ca->num_words = max_num / BITS_PER_WORD + 1;
+    ca->data = calloc(ca->num_words, sizeof(word));
+    ca->iteration = 0;
+    ca->count = 0;
+    ca->count_valid = true;
+    ca->min_index = ca->max_index = BIT_VECTOR_NO_ENTRY;
+    ca->bounds_valid = true;
+    ca->sparse = ca->num_words > SPARSE_MAX_WORDS;
+    ca->num_touched = 0;
     return ca;
 }
 
@@ -61,74 +100,249 @@ void bit_vector_free(bit_vector* bv) {
 }
 
 void bit_vector_reset(bit_vector* ca) {
-    memset(ca->data, 0, ca->num_words * sizeof(word));
+    if (ca->sparse) {
+        for (size_t i = 0; i < ca->num_touched; i++) {
+            ca->data[ca->touched[i]] = 0;
+        }
+    } else {
+        memset(ca->data, 0, ca->num_words * sizeof(word));
+    }
+    ca->count = 0;
+    ca->count_valid = true;
+    ca->min_index = ca->max_index = BIT_VECTOR_NO_ENTRY;
+    ca->bounds_valid = true;
+    ca->sparse = ca->num_words > SPARSE_MAX_WORDS;
+    ca->num_touched = 0;
+}
+
+/**
+ * Records that word_num may become non-zero. Switches to dense mode if there
+ * are too many such words.
+ */
+static void touch_word(bit_vector* ca, size_t word_num) {
+    assert(ca->sparse);
+    size_t position = ca->num_touched;
+    while (position > 0 && ca->touched[position - 1] >= word_num) {
+        if (ca->touched[position - 1] == word_num) {
+            return;
+        }
+        position--;
+    }
+    if (ca->num_touched == SPARSE_MAX_WORDS) {
+        ca->sparse = false;
+        return;
+    }
+    memmove(&ca->touched[position + 1], &ca->touched[position], (ca->num_touched - position) * sizeof(size_t));
+    ca->touched[position] = word_num;
+    ca->num_touched++;
 }
 
 void bit_vector_add(bit_vector* ca, size_t index) {
     size_t bv_index = index - ca->offset;
-    size_t word_num = bv_index / sizeof(word);
-    size_t position = bv_index % sizeof(word);
-    ca->data[word_num] |= ((word)1 << position);
+    size_t word_num = bv_index / BITS_PER_WORD;
+    size_t position = bv_index % BITS_PER_WORD;
+    assert(word_num < ca->num_words);
+    const word mask = (word)1 << position;
+    if (ca->data[word_num] & mask) {
+        return;
+    }
+    if (ca->sparse && ca->data[word_num] == 0) {
+        touch_word(ca, word_num);
+    }
+    ca->data[word_num] |= mask;
+    
+    ca->count++;
+    if (ca->bounds_valid && bv_index < ca->max) {
+        if (ca->min_index == BIT_VECTOR_NO_ENTRY) {
+            ca->min_index = ca->max_index = bv_index;
+        } else {
+            ca->min_index = bv_index < ca->min_index ? bv_index : ca->min_index;
+            ca->max_index = bv_index > ca->max_index ? bv_index : ca->max_index;
+        }
+    }
 }
 
 void bit_vector_remove(bit_vector* ca, size_t index) {
     size_t bv_index = index - ca->offset;
-    size_t word_num = bv_index / sizeof(word);
-    size_t position = bv_index % sizeof(word);
-    ca->data[word_num] &= ~((word)1 << position);
+    size_t word_num = bv_index / BITS_PER_WORD;
+    size_t position = bv_index % BITS_PER_WORD;
+    assert(word_num < ca->num_words);
+    const word mask = (word)1 << position;
+    if (!(ca->data[word_num] & mask)) {
+        return;
+    }
+    ca->data[word_num] &= ~mask;
+    
+    ca->count--;
+    if (bv_index == ca->min_index || bv_index == ca->max_index) {
+        ca->bounds_valid = false;
+    }
 }
 
 bool bit_vector_contains(bit_vector* ca, size_t index) {
     size_t bv_index = index - ca->offset;
-    size_t word_num = bv_index / sizeof(word);
-    size_t position = bv_index % sizeof(word);
+    size_t word_num = bv_index / BITS_PER_WORD;
+    size_t position = bv_index % BITS_PER_WORD;
+    assert(word_num < ca->num_words);
     return ca->data[word_num] & ((word)1 << position);
 }
 
 void bit_vector_update_or(bit_vector* target, const bit_vector* source) {
     assert(target->offset == source->offset);
     size_t min = target->num_words > source->num_words ? source->num_words : target->num_words;
-    for (size_t i = 0; i < min; i++) {
-        target->data[i] |= source->data[i];
+    
+    if (source->sparse) {
+        for (size_t i = 0; i < source->num_touched && source->touched[i] < min; i++) {
+            const size_t word_num = source->touched[i];
+            if (source->data[word_num] == 0) {
+                continue;
+            }
+            if (target->sparse && target->data[word_num] == 0) {
+                touch_word(target, word_num);
+            }
+            target->data[word_num] |= source->data[word_num];
+        }
+    } else {
+        // simple loop over restrict pointers such that it gets vectorized
+        word* restrict target_data = target->data;
+        const word* restrict source_data = source->data;
+        for (size_t i = 0; i < min; i++) {
+            target_data[i] |= source_data[i];
+        }
+        target->sparse = false;
+    }
+    
+    target->count_valid = false;
+    if (target->bounds_valid && source->bounds_valid && source->num_words <= target->num_words) {
+        if (target->min_index == BIT_VECTOR_NO_ENTRY) {
+            target->min_index = source->min_index;
+            target->max_index = source->max_index;
+        } else if (source->min_index != BIT_VECTOR_NO_ENTRY) {
+            target->min_index = source->min_index < target->min_index ? source->min_index : target->min_index;
+            target->max_index = source->max_index > target->max_index ? source->max_index : target->max_index;
+        }
+    } else {
+        target->bounds_valid = false;
     }
 }
 
 void bit_vector_update_and(bit_vector* target, const bit_vector* source) {
     assert(target->offset == source->offset);
     size_t min = target->num_words > source->num_words ? source->num_words : target->num_words;
+    word* restrict target_data = target->data;
+    const word* restrict source_data = source->data;
     for (size_t i = 0; i < min; i++) {
-        target->data[i] &= source->data[i];
+        target_data[i] &= source_data[i];
     }
+    // the set of touched words of target is still a superset of the non-zero words
+    target->count_valid = false;
+    target->bounds_valid = false;
 }
 
-size_t bit_vector_min(bit_vector* bv) {
-    for (size_t i = 0; i < bv->max; i++) {
-        size_t word_num = i / sizeof(word);
-        size_t position = i % sizeof(word);
-        if (bv->data[word_num] & ((word)1 << position)) {
-            return i + bv->offset;
+/**
+ * Calls f on every word that may be non-zero, in increasing order.
+ */
+#define FOR_EACH_WORD(bv, word_num, body) \
+    if ((bv)->sparse) { \
+        for (size_t _i = 0; _i < (bv)->num_touched; _i++) { \
+            const size_t word_num = (bv)->touched[_i]; \
+            body \
+        } \
+    } else { \
+        for (size_t word_num = 0; word_num < (bv)->num_words; word_num++) { \
+            body \
+        } \
+    }
+
+size_t bit_vector_count(bit_vector* bv) {
+    if (!bv->count_valid) {
+        size_t count = 0;
+        FOR_EACH_WORD(bv, word_num, {
+            count += population_count(bv->data[word_num]);
+        })
+        bv->count = count;
+        bv->count_valid = true;
+    }
+    return bv->count;
+}
+
+static void compute_bounds(bit_vector* bv) {
+    size_t min = BIT_VECTOR_NO_ENTRY;
+    size_t max = BIT_VECTOR_NO_ENTRY;
+    FOR_EACH_WORD(bv, word_num, {
+        const word w = bv->data[word_num];
+        if (w != 0) {
+            const size_t lowest = word_num * BITS_PER_WORD + count_trailing_zeros(w);
+            const size_t highest = word_num * BITS_PER_WORD + (BITS_PER_WORD - 1 - count_leading_zeros(w));
+            if (lowest < bv->max) {
+                if (min == BIT_VECTOR_NO_ENTRY) {
+                    min = lowest;
+                }
+                // entries at index max or above are never reported
+                max = highest < bv->max ? highest : bv->max - 1;
+            }
+        }
+    })
+    if (max != BIT_VECTOR_NO_ENTRY) {
+        // the highest word may contain entries above max only, find the largest valid one
+        while (!(bv->data[max / BITS_PER_WORD] & ((word)1 << (max % BITS_PER_WORD)))) {
+            max--;
         }
     }
-    return BIT_VECTOR_NO_ENTRY;
+    bv->min_index = min;
+    bv->max_index = max;
+    bv->bounds_valid = true;
+}
+
+size_t bit_vector_min(bit_vector* bv) {
+    if (!bv->bounds_valid) {
+        compute_bounds(bv);
+    }
+    return bv->min_index == BIT_VECTOR_NO_ENTRY ? BIT_VECTOR_NO_ENTRY : bv->min_index + bv->offset;
 }
 
 size_t bit_vector_max(bit_vector* bv) {
-    for (size_t i = 0; i < bv->max; i++) {
-        size_t j = bv->max - i - 1;
-        size_t word_num = j / sizeof(word);
-        size_t position = j % sizeof(word);
-        if (bv->data[word_num] & ((word)1 << position)) {
-            return j + bv->offset;
-        }
+    if (!bv->bounds_valid) {
+        compute_bounds(bv);
     }
-    return BIT_VECTOR_NO_ENTRY;
+    return bv->max_index == BIT_VECTOR_NO_ENTRY ? BIT_VECTOR_NO_ENTRY : bv->max_index + bv->offset;
 }
 
 bool bit_vector_equal(bit_vector* lhs, bit_vector* rhs) {
     assert(lhs->offset == rhs->offset);
-    size_t min = lhs->num_words > rhs->num_words ? lhs->num_words : rhs->num_words;
-    for (size_t i = 0; i < min; i++) {
-        if (lhs->data[i] != rhs->data[i]) {
+    if (lhs->count_valid && rhs->count_valid && lhs->count != rhs->count) {
+        return false;
+    }
+    if (lhs->bounds_valid && rhs->bounds_valid && lhs->max == rhs->max
+        && (lhs->min_index != rhs->min_index || lhs->max_index != rhs->max_index)) {
+        return false;
+    }
+    
+    size_t min = lhs->num_words > rhs->num_words ? rhs->num_words : lhs->num_words;
+    const word* restrict lhs_data = lhs->data;
+    const word* restrict rhs_data = rhs->data;
+    // compare in blocks without early exit inside a block such that it gets vectorized
+    const size_t block = 8;
+    size_t i = 0;
+    for (; i + block <= min; i += block) {
+        word difference = 0;
+        for (size_t j = 0; j < block; j++) {
+            difference |= lhs_data[i + j] ^ rhs_data[i + j];
+        }
+        if (difference != 0) {
+            return false;
+        }
+    }
+    for (; i < min; i++) {
+        if (lhs_data[i] != rhs_data[i]) {
+            return false;
+        }
+    }
+    
+    // remaining words of the larger vector must be empty
+    const bit_vector* larger = lhs->num_words > rhs->num_words ? lhs : rhs;
+    for (i = min; i < larger->num_words; i++) {
+        if (larger->data[i] != 0) {
             return false;
         }
     }
@@ -147,18 +361,40 @@ bool bit_vector_iterate(bit_vector* ca) {
     return ca->iteration - 1 < ca->max;
 }
 
-size_t bit_vector_next(bit_vector* ca) {
-    for (size_t i = ca->iteration; i < ca->max; i++) {
-        size_t word_num = i / sizeof(word);
-        size_t position = i % sizeof(word);
-        if (ca->data[word_num] == 0) {
-            i = sizeof(word) * (word_num + 1) - 1;
-            continue;
+/**
+ * Returns the first word number greater or equal to word_num that may be non-zero.
+ */
+static size_t next_candidate_word(bit_vector* ca, size_t word_num) {
+    if (!ca->sparse) {
+        return word_num;
+    }
+    for (size_t i = 0; i < ca->num_touched; i++) {
+        if (ca->touched[i] >= word_num) {
+            return ca->touched[i];
         }
-        if (ca->data[word_num] & ((word)1 << position)) {
-            ca->iteration = i + 1;
-            return i + ca->offset;
+    }
+    return ca->num_words;
+}
+
+size_t bit_vector_next(bit_vector* ca) {
+    size_t i = ca->iteration;
+    size_t word_num = next_candidate_word(ca, i / BITS_PER_WORD);
+    if (word_num != i / BITS_PER_WORD) {
+        i = word_num * BITS_PER_WORD;
+    }
+    while (i < ca->max && word_num < ca->num_words) {
+        // mask out bits below i that were already visited
+        const word remaining = ca->data[word_num] & (~(word)0 << (i % BITS_PER_WORD));
+        if (remaining != 0) {
+            const size_t index = word_num * BITS_PER_WORD + count_trailing_zeros(remaining);
+            if (index >= ca->max) {
+                break;
+            }
+            ca->iteration = index + 1;
+            return index + ca->offset;
         }
+        word_num = next_candidate_word(ca, word_num + 1);
+        i = word_num * BITS_PER_WORD;
     }
     ca->iteration = ca->max + 1;
     return BIT_VECTOR_NO_ENTRY;
@@ -29,6 +29,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define BIT_VECTOR_NO_ENTRY UINT64_MAX
 
@@ -45,6 +46,7 @@ void bit_vector_update_and(bit_vector* target, const bit_vector* source);
 size_t bit_vector_min(bit_vector*);
 size_t bit_vector_max(bit_vector*);
 bool bit_vector_equal(bit_vector*, bit_vector*);
+size_t bit_vector_count(bit_vector*);  // number of entries
 
 // Iteration
 size_t bit_vector_init_iteration(bit_vector*);
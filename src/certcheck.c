@@ -107,8 +107,8 @@ static void encode_and_as(CertCheck* check, int_queue* aiger_lits, unsigned dest
  */
 static void encode_or_as(CertCheck* check, int_queue* aiger_lits, unsigned dest_aiger_lit) {
     // negate literals in aiger_lits first
-    for (int_queue_element* element = aiger_lits->first; element != NULL; element = element->next) {
-        element->value = (int)aiger_not(element->value);
+    for (size_t i = 0; i < int_queue_count(aiger_lits); i++) {
+        int_queue_set(aiger_lits, i, (int)aiger_not(int_queue_get(aiger_lits, i)));
     }
     encode_and_as(check, aiger_lits, dest_aiger_lit);
 }
@@ -201,6 +201,7 @@ static void import_circuit(CertCheck* check) {
         }
     }
     assert(int_queue_is_empty(&gate_aiger_inputs));
+    int_queue_free(&gate_aiger_inputs);
     
     // set output
     var_t output_var = lit_to_var(circuit->output);
@@ -11,7 +11,7 @@
 #include "aiger_helper.h"
 #include "circuit_abstraction.h"
 
-static char buffer[1024] = { 0 };
+static _Thread_local char buffer[1024] = { 0 };
 
 static const char* int2str(unsigned literal) {
     snprintf(buffer, 1024, "%d", literal);
@@ -28,8 +28,17 @@ void certification_init(certification* cert, Circuit* circuit) {
     int_queue_init(&cert->queues[1]);
     cert->current_queue = 0;
     
-    cert->function_lit = map_init();
-    cert->precondition_lit = map_init();
+    cert->function_lit = map_init_size(circuit->num_vars);
+    cert->precondition_lit = map_init_size(circuit->num_vars);
+}
+
+void certification_free(certification* cert) {
+    aiger_reset(cert->skolem);
+    aiger_reset(cert->herbrand);
+    int_queue_free(&cert->queues[0]);
+    int_queue_free(&cert->queues[1]);
+    map_free(cert->function_lit);
+    map_free(cert->precondition_lit);
 }
 
 static void import_variables_recursive(certification* cert, Scope* scope) {
@@ -162,9 +171,7 @@ void certification_pop(certification* cert) {
 }
 
 void certification_clear(certification* cert) {
-    while (!int_queue_is_empty(&cert->queues[cert->current_queue])) {
-        int_queue_pop(&cert->queues[cert->current_queue]);
-    }
+    int_queue_reset(&cert->queues[cert->current_queue]);
 }
 
 bool certification_queue_is_empty(certification* cert) {
@@ -176,8 +183,12 @@ void certification_append_function_case(certification* cert, CircuitAbstraction*
     for (size_t i = 0; i < vector_count(abs->scope->vars); i++) {
         const Var* var = vector_get(abs->scope->vars, i);
         bool negated = (var->shared.value <= 0);
-        unsigned function_lit = (uintptr_t)map_get(cert->function_lit, var->shared.id);
-        unsigned last_precondition = (uintptr_t)map_get(cert->precondition_lit, var->shared.id);
+        // the maps are not modified structurally below, thus, the references stay valid
+        void** function_lit_ref = map_get_reference(cert->function_lit, var->shared.id);
+        void** precondition_lit_ref = map_get_reference(cert->precondition_lit, var->shared.id);
+        assert(function_lit_ref != NULL && precondition_lit_ref != NULL);
+        unsigned function_lit = (uintptr_t)*function_lit_ref;
+        unsigned last_precondition = (uintptr_t)*precondition_lit_ref;
         
         if (!negated) {
             // !last_precondition && precondition_aiger_lit => x
@@ -191,7 +202,7 @@ void certification_append_function_case(certification* cert, CircuitAbstraction*
             int_queue_push(&cert->queues[cert->current_queue], aiger_not(function_lit));
             int_queue_push(&cert->queues[cert->current_queue], aiger_not(function_case));
             unsigned new_function_lit = certification_define_and(cert, abs->scope->qtype);
-            map_update(cert->function_lit, var->shared.id, (void*)(uintptr_t)aiger_not(new_function_lit));
+            *function_lit_ref = (void*)(uintptr_t)aiger_not(new_function_lit);
         }
         
         // last_precondition |= precondition_aiger_lit
@@ -200,7 +211,7 @@ void certification_append_function_case(certification* cert, CircuitAbstraction*
         int_queue_push(&cert->queues[cert->current_queue], aiger_not(current_precondition));
         unsigned new_precondition = certification_define_and(cert, abs->scope->qtype);
         
-        map_update(cert->precondition_lit, var->shared.id, (void*)(uintptr_t)aiger_not(new_precondition));
+        *precondition_lit_ref = (void*)(uintptr_t)aiger_not(new_precondition);
     }
 }
 
@@ -224,6 +235,10 @@ void certification_define_outputs(certification* cert, CircuitAbstraction* abs,
 }
 
 void certification_print(certification* cert, qbf_res result) {
+    certification_write(cert, result, stdout);
+}
+
+void certification_write(certification* cert, qbf_res result, FILE* file) {
     aiger* strategy = (result == QBF_RESULT_SAT) ? cert->skolem : cert->herbrand;
     if (aiger_check(strategy)) {
         printf("%s\n", aiger_error(strategy));
@@ -238,5 +253,5 @@ void certification_print(certification* cert, qbf_res result) {
         aiger_add_comment(strategy, "UNSAT");
     }
     aiger_reencode(strategy);
-    aiger_write_to_file(strategy, aiger_ascii_mode, stdout);
+    aiger_write_to_file(strategy, aiger_ascii_mode, file);
 }
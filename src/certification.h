@@ -39,6 +39,7 @@ typedef struct circuit_abstraction CircuitAbstraction;
 
 
 void certification_init(certification*, Circuit*);
+void certification_free(certification*);
 
 void certification_import_variables(certification*, Circuit*);
 
@@ -57,5 +58,6 @@ bool certification_queue_is_empty(certification*);
 
 void certification_define_outputs(certification*, CircuitAbstraction*, qbf_res);
 void certification_print(certification*, qbf_res);
+void certification_write(certification*, qbf_res, FILE*);  // can be called at most once
 
 #endif /* certification_h */
@@ -0,0 +1,247 @@
+//
+//  checkpoint.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include "checkpoint.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"
+
+static char* temporary_file_name(const char* file_name) {
+    const size_t length = strlen(file_name);
+    char* name = malloc(length + 5);
+    memcpy(name, file_name, length);
+    memcpy(name + length, ".tmp", 5);
+    return name;
+}
+
+FILE* checkpoint_begin(const char* file_name, const char* snapshot, uint64_t fingerprint) {
+    char* name = temporary_file_name(file_name);
+    FILE* file = fopen(name, "w");
+    if (file == NULL) {
+        logging_error("Cannot write checkpoint %s: %s\n", name, strerror(errno));
+    }
+    free(name);
+    if (file == NULL) {
+        return NULL;
+    }
+    fputs(snapshot, file);
+    fprintf(file, "#checkpoint %d %" PRIu64 "\n", CHECKPOINT_VERSION, fingerprint);
+    return file;
+}
+
+void checkpoint_write_statistics(FILE* file, const char* name, Stats* s) {
+    fprintf(file, "#stats %s ", name);
+    statistics_write(s, file);
+    fprintf(file, "\n");
+}
+
+void checkpoint_write_level(FILE* file, size_t index, Stats* s, refinement_db* refinements, refinement_db* blocking_clauses) {
+    fprintf(file, "#level %zu ", index);
+    statistics_write(s, file);
+    fprintf(file, "\n");
+    if (refinements != NULL) {
+        refinement_db_write(refinements, file, "#refinement");
+    }
+    if (blocking_clauses != NULL) {
+        refinement_db_write(blocking_clauses, file, "#blocking");
+    }
+}
+
+void checkpoint_write_counterexamples(FILE* file, const int_vector* counterexamples) {
+    bool line_start = true;
+    for (size_t i = 0; i < int_vector_count((int_vector*)counterexamples); i++) {
+        const int lit = int_vector_get((int_vector*)counterexamples, i);
+        if (line_start) {
+            fprintf(file, "#counterexample");
+        }
+        fprintf(file, " %d", lit);
+        line_start = lit == 0;
+        if (line_start) {
+            fprintf(file, "\n");
+        }
+    }
+}
+
+bool checkpoint_commit(FILE* file, const char* file_name) {
+    fprintf(file, "#end\n");
+    bool success = !ferror(file);
+    success = fclose(file) == 0 && success;
+    char* name = temporary_file_name(file_name);
+    if (success && rename(name, file_name) != 0) {
+        success = false;
+    }
+    if (!success) {
+        logging_error("Cannot write checkpoint %s: %s\n", file_name, strerror(errno));
+        remove(name);
+    }
+    free(name);
+    return success;
+}
+
+
+static checkpoint_level* level_init(const char* statistics) {
+    checkpoint_level* level = malloc(sizeof(checkpoint_level));
+    level->statistics = strdup(statistics);
+    level->refinements = int_vector_init();
+    level->blocking_clauses = int_vector_init();
+    return level;
+}
+
+static void level_free(checkpoint_level* level) {
+    free(level->statistics);
+    int_vector_free(level->refinements);
+    int_vector_free(level->blocking_clauses);
+    free(level);
+}
+
+void checkpoint_free(Checkpoint* checkpoint) {
+    for (size_t i = 0; i < vector_count(checkpoint->statistics); i++) {
+        free(vector_get(checkpoint->statistics, i));
+    }
+    vector_free(checkpoint->statistics);
+    for (size_t i = 0; i < vector_count(checkpoint->levels); i++) {
+        level_free(vector_get(checkpoint->levels, i));
+    }
+    vector_free(checkpoint->levels);
+    int_vector_free(checkpoint->counterexamples);
+    free(checkpoint);
+}
+
+/**
+ * Appends the literals of line, which has to be terminated by 0, to lits.
+ * Returns false if the line is malformed.
+ */
+static bool parse_clause(const char* line, int_vector* lits) {
+    while (true) {
+        char* end;
+        errno = 0;
+        const long lit = strtol(line, &end, 10);
+        if (end == line || errno != 0 || lit > INT_MAX || lit < -INT_MAX) {
+            return false;
+        }
+        int_vector_add(lits, (int)lit);
+        line = end;
+        if (lit == 0) {
+            break;
+        }
+    }
+    while (*line == ' ') {
+        line++;
+    }
+    return *line == '\0';
+}
+
+static bool starts_with(const char* line, const char* prefix) {
+    return strncmp(line, prefix, strlen(prefix)) == 0;
+}
+
+static bool parse_line(Checkpoint* checkpoint, const char* line, bool* has_header) {
+    unsigned version;
+    uint64_t fingerprint;
+    size_t index;
+    int length;
+    if (sscanf(line, "#checkpoint %u %" SCNu64, &version, &fingerprint) == 2) {
+        if (version != CHECKPOINT_VERSION) {
+            return false;
+        }
+        checkpoint->fingerprint = fingerprint;
+        *has_header = true;
+        return true;
+    }
+    if (!*has_header) {
+        // the snapshot of the circuit
+        return true;
+    }
+    checkpoint_level* level = NULL;
+    if (vector_count(checkpoint->levels) > 0) {
+        level = vector_get(checkpoint->levels, vector_count(checkpoint->levels) - 1);
+    }
+    if (starts_with(line, "#stats ")) {
+        vector_add(checkpoint->statistics, strdup(line + strlen("#stats ")));
+        return true;
+    } else if (sscanf(line, "#level %zu %n", &index, &length) == 1) {
+        if (index != vector_count(checkpoint->levels)) {
+            return false;
+        }
+        vector_add(checkpoint->levels, level_init(line + length));
+        return true;
+    } else if (starts_with(line, "#refinement ")) {
+        return level != NULL && parse_clause(line + strlen("#refinement "), level->refinements);
+    } else if (starts_with(line, "#blocking ")) {
+        return level != NULL && parse_clause(line + strlen("#blocking "), level->blocking_clauses);
+    } else if (starts_with(line, "#counterexample ")) {
+        return parse_clause(line + strlen("#counterexample "), checkpoint->counterexamples);
+    }
+    return false;
+}
+
+Checkpoint* checkpoint_read(const char* file_name) {
+    FILE* file = fopen(file_name, "r");
+    if (file == NULL) {
+        logging_error("Cannot open checkpoint %s: %s\n", file_name, strerror(errno));
+        return NULL;
+    }
+    Checkpoint* checkpoint = malloc(sizeof(Checkpoint));
+    checkpoint->fingerprint = 0;
+    checkpoint->statistics = vector_init();
+    checkpoint->levels = vector_init();
+    checkpoint->counterexamples = int_vector_init();
+
+    bool has_header = false;
+    bool complete = false;
+    size_t line_number = 0;
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while (!complete && (length = getline(&line, &size, file)) != -1) {
+        line_number++;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (has_header && strcmp(line, "#end") == 0) {
+            complete = true;
+        } else if (!parse_line(checkpoint, line, &has_header)) {
+            logging_error("Malformed checkpoint %s at line %zu\n", file_name, line_number);
+            break;
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if (!complete) {
+        if (!has_header) {
+            logging_error("%s contains no checkpoint\n", file_name);
+        }
+        checkpoint_free(checkpoint);
+        return NULL;
+    }
+    return checkpoint;
+}
+
+bool checkpoint_restore_statistics(Checkpoint* checkpoint, const char* name, Stats* s) {
+    const size_t length = strlen(name);
+    for (size_t i = 0; i < vector_count(checkpoint->statistics); i++) {
+        const char* line = vector_get(checkpoint->statistics, i);
+        if (strncmp(line, name, length) == 0 && line[length] == ' ') {
+            return statistics_merge(s, line + length + 1);
+        }
+    }
+    return false;
+}
+
+checkpoint_level* checkpoint_get_level(Checkpoint* checkpoint, size_t index) {
+    if (index >= vector_count(checkpoint->levels)) {
+        return NULL;
+    }
+    return vector_get(checkpoint->levels, index);
+}
@@ -0,0 +1,80 @@
+//
+//  checkpoint.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "refinement.h"
+#include "statistics.h"
+#include "vector.h"
+
+/**
+ * Checkpoints of the solver state, see the options checkpoint and resume.
+ *
+ * A checkpoint is a QCIR file: the circuit after preprocessing (with a symbol
+ * table of the original ids) followed by comment lines that hold the state
+ * learned so far.
+ *
+ *     #checkpoint <version> <fingerprint>
+ *     #stats <name> <values>
+ *     #level <index> <values>
+ *     #refinement <literals> 0
+ *     #blocking <literals> 0
+ *     #counterexample <literals> 0
+ *     #end
+ *
+ * The fingerprint identifies the circuit the abstraction is built from, see
+ * circuit_fingerprint, such that the literals of the learned clauses are
+ * meaningful when resuming. Levels are numbered in depth-first order of the
+ * abstraction tree, the refinement and blocking lines following a level
+ * belong to it. Values are written by statistics_write.
+ *
+ * A checkpoint is written to a temporary file that replaces the previous one
+ * once it is complete, so an interrupted write leaves the last checkpoint
+ * intact.
+ */
+
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    char* statistics;             // values, see statistics_merge
+    int_vector* refinements;      // clauses separated by 0
+    int_vector* blocking_clauses; // clauses separated by 0
+} checkpoint_level;
+
+typedef struct {
+    uint64_t fingerprint;
+    vector* statistics;           // lines "name values" of #stats
+    vector* levels;               // checkpoint_level, indexed by level
+    int_vector* counterexamples;  // separated by 0
+} Checkpoint;
+
+// Writing, returns NULL if the temporary file cannot be created
+FILE* checkpoint_begin(const char* file_name, const char* snapshot, uint64_t fingerprint);
+void checkpoint_write_statistics(FILE*, const char* name, Stats*);
+// The clauses are the active ones of the databases, which may be NULL
+void checkpoint_write_level(FILE*, size_t index, Stats*, refinement_db* refinements, refinement_db* blocking_clauses);
+void checkpoint_write_counterexamples(FILE*, const int_vector* counterexamples);
+// Replaces file_name by the written checkpoint, returns whether it succeeded
+bool checkpoint_commit(FILE*, const char* file_name);
+
+// Reading, returns NULL if the file cannot be read or contains no complete checkpoint
+Checkpoint* checkpoint_read(const char* file_name);
+void checkpoint_free(Checkpoint*);
+
+// Adds the stored values of name to s, returns false if there are none
+bool checkpoint_restore_statistics(Checkpoint*, const char* name, Stats* s);
+
+// Returns NULL if the checkpoint contains no such level
+checkpoint_level* checkpoint_get_level(Checkpoint*, size_t index);
+
+#endif /* checkpoint_h */
@@ -17,6 +17,7 @@
 #include "logging.h"
 #include "util.h"
 #include "map.h"
+#include "queue.h"
 
 #define EVALUATION_NO_MAX (-1)
 
@@ -24,6 +25,7 @@
 void remove_var(Circuit*, var_t);
 void remove_gate(Circuit*, var_t);
 void remove_scope(Circuit*, Scope*);
+static void free_gate(Gate*);
 
 static void enlarge(void** buffer, size_t* size, size_t bytes, size_t num) {
     size_t old_size = *size;
@@ -58,6 +60,8 @@ Circuit* circuit_init() {
     circuit->output = -1;
     circuit->vars = vector_init();
     circuit->phase = BUILDING;
+    circuit->extensible = false;
+    circuit->t_lit_offset = 0;
     circuit->num_vars = 0;
     
     // Scope handling
@@ -67,50 +71,55 @@ Circuit* circuit_init() {
     circuit->previous_scope = NULL;
     circuit->top_level = circuit_init_scope(circuit, QUANT_EXISTS);
     
+    circuit->scope_influence = NULL;
+    circuit->relevant_scopes = NULL;
+    
     circuit->queue = NULL;
     
     return circuit;
 }
 
-/*static void free_scope_recursively(Scope* scope) {
-    assert(scope);
-    return;
-    if (scope == NULL) {
-        return;
+static void free_scope_recursively(Scope* scope) {
+    for (size_t i = 0; i < scope->num_next; i++) {
+        free_scope_recursively(scope->next[i]);
     }
-    //free_scope_recursively(scope->next);
+    free(scope->next);
     vector_free(scope->vars);
     free(scope);
-}*/
+}
 
 void circuit_free(Circuit* circuit) {
     assert(circuit);
-    return;
     
-    /*for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_shared* node = circuit->nodes[i];
-        if (node == NULL) {
+    for (size_t i = 1; i <= circuit->max_num; i++) {
+        node* current = circuit->nodes[i];
+        if (current == NULL) {
             continue;
         }
         if (circuit->types[i] == NODE_GATE) {
-            Gate* gate = circuit->nodes[i];
-            Occ* next = NULL;
-            for (Occ* occ = gate->first_occ; occ != NULL; occ = next) {
-                next = occ->next_in_gate;
-                free(occ);
+            free_gate(current);
+        } else if (circuit->types[i] == NODE_SCOPE) {
+            ScopeNode* scope_node = current;
+            if (scope_node->scope->prev == NULL) {
+                // scope is linked into the quantifier tree during reencoding
+                free_scope_recursively(scope_node->scope);
             }
-            free(gate);
-        } else {
-            assert(circuit->types[i] == NODE_VAR);
-            Var* var = circuit->nodes[i];
-            free(var);
+            free(scope_node);
         }
     }
-    free(circuit->nodes);
-    free(circuit->types);
+    
+    // variables are owned by circuit->vars, including the removed ones
+    for (size_t i = 0; i < vector_count(circuit->vars); i++) {
+        free(vector_get(circuit->vars, i));
+    }
     vector_free(circuit->vars);
+    
     free_scope_recursively(circuit->top_level);
-    free(circuit);*/
+    free(circuit->nodes);
+    free(circuit->types);
+    scope_set_free(circuit->scope_influence);
+    scope_set_free(circuit->relevant_scopes);
+    free(circuit);
 }
 
 void circuit_adjust(Circuit* circuit, size_t max_num) {
@@ -153,9 +162,6 @@ static void init_node_shared(node_shared* shared, var_t id) {
     
     shared->value = 0;
     
-    shared->influences = NULL;
-    shared->relevant_for = NULL;
-    shared->dfs_processed = false;
 }
 
 Var* circuit_new_var(Circuit* circuit, Scope* scope, var_t var_id) {
@@ -164,6 +170,7 @@ Var* circuit_new_var(Circuit* circuit, Scope* scope, var_t var_id) {
     
     var->scope = scope;
     var->removed = false;
+    var->frozen = false;
     var->polarity = POLARITY_UNDEFINED;
     var->var_id = circuit->num_vars++;
     var->orig_quant = scope->qtype;
@@ -240,12 +247,18 @@ static void remove_scope_node(Circuit* circuit, var_t node_id) {
     
     Scope* scope = scope_node->scope;
     assert(vector_count(scope->vars) == 0 || scope_node->shared.value != 0);
-    while (vector_count(scope->vars) > 0) {
-        Var* var = vector_get(scope->vars, 0);
-        remove_var(circuit, var->shared.id);
+    const bool replace_with_singleton_gate = scope_node->shared.value == 0;
+    if (vector_count(scope->vars) > 0) {
+        // Removing the last variable frees the scope, make sure that it does
+        // not try to remove this scope node again
+        scope->node = 0;
+        while (vector_count(scope->vars) > 1) {
+            Var* var = vector_get(scope->vars, 0);
+            remove_var(circuit, var->shared.id);
+        }
+        Var* last = vector_get(scope->vars, 0);
+        remove_var(circuit, last->shared.id);
     }
-    
-    bool replace_with_singleton_gate = vector_count(scope->vars) == 0 && scope_node->shared.value == 0;
     node_shared shared = scope_node->shared;
     lit_t sub = scope_node->sub;
     
@@ -264,6 +277,13 @@ static void remove_scope_node(Circuit* circuit, var_t node_id) {
         assert(sub_node != NULL);
         assert(sub_node->num_occ > 0);
         sub_node->num_occ--;
+        
+        if (shared.num_occ > 0 || shared.id == lit_to_var(circuit->output)) {
+            // The node is still referenced, replace it by a constant gate
+            // such that the parents see its value when they are propagated
+            Gate* gate = circuit_add_gate(circuit, shared.id, shared.value > 0 ? GATE_AND : GATE_OR);
+            gate->shared = shared;
+        }
     }
 }
 
@@ -335,10 +355,8 @@ static void merge_scopes(Circuit* circuit, Scope* from, Scope* to) {
         }
     }
     
-    if (from->node != 0) {
-        remove_scope_node(circuit, from->node);
-        from->node = 0;
-    }
+    // also removes the scope node of from, if any
+    free_scope(circuit, from);
 }
 
 void remove_scope(Circuit* circuit, Scope* scope) {
@@ -595,15 +613,19 @@ static Gate* copy_and_negate(Circuit* circuit, Gate* gate) {
     return copy;
 }
 
-static void topological_sort_dfs(Circuit*, var_t*, var_t*, node_type*, lit_t);
+/**
+ * Stack frame of the depth-first search in topological_sort_dfs.
+ */
+typedef struct {
+    var_t node;
+    size_t next_input;  // index of the next input (gate) or sub-formula (scope node) to process
+    Scope* last_scope;  // scope nodes only, previous scope that is restored when leaving the node
+} dfs_frame;
 
-static lit_t process_occurrence(Circuit* circuit, lit_t lit, var_t* new_ids, var_t* new_id, node_type* new_types) {
+static lit_t process_occurrence(Circuit* circuit, lit_t lit, const var_t* new_ids) {
     const var_t marked = circuit->max_num + 1;  // special id to declare nodes as marked in DFS
     const var_t occ_var = lit_to_var(lit);
     
-    assert(lit > 0 || circuit->types[occ_var] == NODE_VAR);
-    
-    topological_sort_dfs(circuit, new_ids, new_id, new_types, lit);
     const var_t new_occ_var = new_ids[occ_var];
     assert(new_occ_var > 0 && new_occ_var < marked);
     const lit_t new_lit = create_lit(new_occ_var, lit < 0);
@@ -615,26 +637,24 @@ static lit_t process_occurrence(Circuit* circuit, lit_t lit, var_t* new_ids, var
         other->num_occ++;
     }
     
-    // Update scope bit vector
-    //bit_vector_update_or(node->scopes, other->scopes);
     return new_lit;
 }
 
 /**
- * Rearanges node id's such that id of parent node is larger than the nodes of
- * all its children. Does Depth-first search over the circuit data structure.
- *
- * Does also reassign scope id's during traversal.
+ * Called when the DFS reaches a node for the first time. Leafs get their new
+ * id immediately, for inner nodes the pre-order work is done.
+ * Returns true if the inputs of the node have to be visited, i.e., the frame
+ * has to be pushed on the DFS stack.
  */
-void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_type* new_types, lit_t lit) {
+static bool topological_sort_enter(Circuit* circuit, var_t* new_ids, var_t* new_id, node_type* new_types, dfs_frame* frame) {
     const var_t marked = circuit->max_num + 1;  // special id to declare nodes as marked in DFS
-    var_t node = lit_to_var(lit);
+    const var_t node = frame->node;
     assert(node > 0);
     assert(circuit->nodes[node] != NULL);
     api_expect(new_ids[node] != marked, "circuit is cyclic\n");
     
     if (new_ids[node] != 0) {
-        return;
+        return false;
     }
     
     if (circuit->types[node] == NODE_VAR) {
@@ -644,6 +664,7 @@ void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_
         new_types[new_node] = NODE_VAR;
         Var* var = circuit->nodes[node];
         var->shared.id = new_node;
+        return false;
     } else if (circuit->types[node] == NODE_SCOPE) {
         api_expect(new_ids[node] == 0, "quantified subformula can only be used once\n");
         new_ids[node] = marked;
@@ -651,8 +672,8 @@ void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_
         scope_node->min_node = *new_id;
         
         // Adjust scope pointer
-        Scope* last_scope = circuit->previous_scope;
-        link_scope(last_scope, scope_node->scope);
+        frame->last_scope = circuit->previous_scope;
+        link_scope(frame->last_scope, scope_node->scope);
         circuit->previous_scope = scope_node->scope;
         
         // Assign scope id
@@ -665,17 +686,32 @@ void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_
         if (circuit->current_depth > circuit->max_depth) {
             circuit->max_depth = circuit->current_depth;
         }
-        
-        scope_node->sub = process_occurrence(circuit, scope_node->sub, new_ids, new_id, new_types);
-        
-        const var_t new_node = (*new_id)++;
-        new_ids[node] = new_node;
+    } else {
+        assert(circuit->types[node] == NODE_GATE);
+        new_ids[node] = marked;
+        Gate* gate = circuit->nodes[node];
+        gate->min_node = *new_id;
+        gate->reachable = true;
+    }
+    return true;
+}
+
+/**
+ * Called after all inputs of an inner node are processed, assigns the new id.
+ */
+static void topological_sort_leave(Circuit* circuit, var_t* new_ids, var_t* new_id, node_type* new_types, const dfs_frame* frame) {
+    const var_t node = frame->node;
+    const var_t new_node = (*new_id)++;
+    new_ids[node] = new_node;
+    
+    if (circuit->types[node] == NODE_SCOPE) {
         new_types[new_node] = NODE_SCOPE;
+        ScopeNode* scope_node = circuit->nodes[node];
         scope_node->shared.id = new_node;
         scope_node->scope->node = new_node;
         
         // Reset pointer to previous scope
-        circuit->previous_scope = last_scope;
+        circuit->previous_scope = frame->last_scope;
         circuit->current_depth--;
         for (size_t i = 0; i < scope_node->scope->num_next; i++) {
             const Scope* next = scope_node->scope->next[i];
@@ -685,20 +721,77 @@ void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_
         }
     } else {
         assert(circuit->types[node] == NODE_GATE);
-        new_ids[node] = marked;
-        Gate* gate = circuit->nodes[node];
-        gate->min_node = *new_id;
-        gate->reachable = true;
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            gate->inputs[i] = process_occurrence(circuit, gate->inputs[i], new_ids, new_id, new_types);
-        }
-        const var_t new_node = (*new_id)++;
-        new_ids[node] = new_node;
         new_types[new_node] = NODE_GATE;
+        Gate* gate = circuit->nodes[node];
         gate->shared.id = new_node;
     }
 }
 
+/**
+ * Returns the next unprocessed input of the node in frame, NULL if there is none.
+ */
+static lit_t* topological_sort_next_input(Circuit* circuit, const dfs_frame* frame) {
+    if (circuit->types[frame->node] == NODE_SCOPE) {
+        ScopeNode* scope_node = circuit->nodes[frame->node];
+        return frame->next_input == 0 ? &scope_node->sub : NULL;
+    }
+    assert(circuit->types[frame->node] == NODE_GATE);
+    Gate* gate = circuit->nodes[frame->node];
+    return frame->next_input < gate->num_inputs ? &gate->inputs[frame->next_input] : NULL;
+}
+
+/**
+ * Rearanges node id's such that id of parent node is larger than the nodes of
+ * all its children. Does Depth-first search over the circuit data structure.
+ * The search uses an explicit stack, thus, the depth of the circuit is not
+ * limited by the size of the call stack.
+ *
+ * Does also reassign scope id's during traversal.
+ */
+static void topological_sort_dfs(Circuit* circuit, var_t* new_ids, var_t* new_id, node_type* new_types, lit_t lit) {
+    size_t stack_size = 64;
+    size_t stack_count = 0;
+    dfs_frame* stack = malloc(stack_size * sizeof(dfs_frame));
+    
+    dfs_frame root = { .node = lit_to_var(lit), .next_input = 0, .last_scope = NULL };
+    if (topological_sort_enter(circuit, new_ids, new_id, new_types, &root)) {
+        stack[stack_count++] = root;
+    }
+    
+    while (stack_count > 0) {
+        dfs_frame* frame = &stack[stack_count - 1];
+        lit_t* input = topological_sort_next_input(circuit, frame);
+        
+        if (input == NULL) {
+            // all inputs processed
+            topological_sort_leave(circuit, new_ids, new_id, new_types, frame);
+            stack_count--;
+            if (stack_count > 0) {
+                dfs_frame* parent = &stack[stack_count - 1];
+                lit_t* parent_input = topological_sort_next_input(circuit, parent);
+                *parent_input = process_occurrence(circuit, *parent_input, new_ids);
+                parent->next_input++;
+            }
+            continue;
+        }
+        
+        assert(*input > 0 || circuit->types[lit_to_var(*input)] == NODE_VAR);
+        dfs_frame child = { .node = lit_to_var(*input), .next_input = 0, .last_scope = NULL };
+        if (topological_sort_enter(circuit, new_ids, new_id, new_types, &child)) {
+            if (stack_count == stack_size) {
+                stack_size *= 2;
+                stack = realloc(stack, stack_size * sizeof(dfs_frame));
+            }
+            stack[stack_count++] = child;
+        } else {
+            *input = process_occurrence(circuit, *input, new_ids);
+            frame->next_input++;
+        }
+    }
+    
+    free(stack);
+}
+
 static int compare_nodes(const void* lhs, const void* rhs) {
     node_shared** lhs_shared = (node_shared**)lhs;
     node_shared** rhs_shared = (node_shared**)rhs;
@@ -720,8 +813,9 @@ static int compare_nodes(const void* lhs, const void* rhs) {
  * - Once we hit a negated gate, we append the negation to the list of nodes
  * - Double negation is handeled by returning the original gate
  * - This function can produce orphaned gates
+ * Only gates starting from first_node are transformed, the others are already in NNF.
  */
-static void circuit_to_nnf(Circuit* circuit) {
+static void circuit_to_nnf(Circuit* circuit, var_t first_node) {
     
     // check of output is negated
     if (circuit->output < 0) {
@@ -738,7 +832,7 @@ static void circuit_to_nnf(Circuit* circuit) {
         }
     }
     
-    for (size_t i = 1; i <= circuit->max_num; i++) {
+    for (size_t i = first_node; i <= circuit->max_num; i++) {
         if (circuit->types[i] != NODE_GATE) {
             continue;
         }
@@ -862,7 +956,7 @@ static void remove_unnecessary_quantifier_scopes(Circuit* circuit) {
  */
 void circuit_reencode(Circuit* circuit) {
     api_expect(circuit_check_all_nodes_defined(circuit), "there were undefined gates\n");
-    circuit_to_nnf(circuit);
+    circuit_to_nnf(circuit, 1);
     remove_empty_scopes(circuit, circuit->top_level);
     //circuit_flatten_gates(circuit);
     remove_unnecessary_quantifier_scopes(circuit);
@@ -890,11 +984,32 @@ void circuit_reencode(Circuit* circuit) {
     // Start DFS at the output
     topological_sort_dfs(circuit, new_ids, &new_id, new_types, circuit->output);
     
+    if (circuit->extensible) {
+        // nodes that are not reachable from the output may be used by later
+        // extensions, they are placed after the output
+        for (var_t i = 1; i <= circuit->max_num; i++) {
+            if (new_ids[i] != 0 || (circuit->types[i] != NODE_VAR && circuit->types[i] != NODE_GATE)) {
+                continue;
+            }
+            topological_sort_dfs(circuit, new_ids, &new_id, new_types, (lit_t)i);
+        }
+    }
+    
     // adjust occurrence for output gate
     //node_shared* output_node = circuit->nodes[lit_to_var(circuit->output)];
     //output_node->num_occ++;
     
+    // links to negated gates are used again by circuit_extend
+    for (size_t i = 1; i <= circuit->max_num; i++) {
+        if (circuit->types[i] != NODE_GATE || new_ids[i] == 0) {
+            continue;
+        }
+        Gate* gate = circuit->nodes[i];
+        gate->negation = gate->negation != 0 ? new_ids[gate->negation] : 0;
+    }
+    
     // clean-up nodes that are not reachable
+    bool removed_scope_node_var = false;
     for (size_t i = circuit->max_num; i > 0; i--) {
         if (circuit->types[i] == NODE_GATE) {
             //Gate* gate = circuit->nodes[i];
@@ -906,9 +1021,18 @@ void circuit_reencode(Circuit* circuit) {
         if (new_ids[i] != 0) {
             continue;
         }
-        // FIXME: correct clean-up for node, currently it leaks memory
         if (circuit->types[i] == NODE_VAR) {
-            remove_var(circuit, i);
+            Var* var = circuit->nodes[i];
+            if (var->scope->node != 0 && vector_count(var->scope->vars) == 1) {
+                // The scope node was already renumbered by the DFS, so the
+                // scope cannot be removed here; this is done by reencoding again
+                vector_remove(var->scope->vars, var);
+                var->removed = true;
+                circuit->types[i] = 0;
+                removed_scope_node_var = true;
+            } else {
+                remove_var(circuit, i);
+            }
         } else if (circuit->types[i] == NODE_GATE) {
             remove_gate(circuit, i);
         } else if (circuit->types[i] == NODE_SCOPE) {
@@ -918,13 +1042,15 @@ void circuit_reencode(Circuit* circuit) {
         circuit->nodes[i] = NULL;
     }
     
-    var_t new_max = new_ids[circuit->output];
+    var_t new_max = new_id - 1;
     assert(new_max > 0 && new_max <= circuit->max_num);
+    assert(circuit->extensible || new_max == new_ids[lit_to_var(circuit->output)]);
     
     qsort(circuit->nodes + 1, circuit->max_num, sizeof(node*), compare_nodes);
     
     circuit->output = create_lit_from_value(new_ids[lit_to_var(circuit->output)], circuit->output);
     circuit->max_num = new_max;
+    circuit->t_lit_offset = new_max;
     
     free(circuit->types);
     circuit->types = new_types;
@@ -933,10 +1059,115 @@ void circuit_reencode(Circuit* circuit) {
     
     circuit->phase = ENCODED;
     
+    if (removed_scope_node_var) {
+        circuit_reencode(circuit);
+        return;
+    }
+    
     circuit_normalize_quantifier(circuit);
     
     assert(circuit_check(circuit));
     assert(is_nnf(circuit));
+
+}
+
+
+static lit_t import_extension_literal(const map* nodes, lit_t lit) {
+    const node_shared* node = map_get(nodes, (int)lit_to_var(lit));
+    api_expect(node != NULL, "node %d is not defined\n", lit_to_var(lit));
+    return create_lit(node->id, lit < 0);
+}
+
+void circuit_extend(Circuit* circuit, Circuit* delta) {
+    api_expect(circuit->extensible && circuit->phase == ENCODED, "circuit must be encoded and extensible\n");
+    api_expect(delta->output != -1, "extension must set the output\n");
+    const var_t first_node = (var_t)circuit->max_num + 1;
+    
+    // maps original ids to nodes, negated copies of gates have negative original ids
+    map* nodes = map_init_size(circuit->max_num + delta->max_num);
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        node_shared* node = circuit->nodes[i];
+        if (node != NULL && (lit_t)node->orig_id > 0) {
+            map_add(nodes, (int)node->orig_id, node);
+        }
+    }
+    
+    // Variables, delta was not reencoded, thus, its ids are the original ones
+    Scope* scope = circuit->top_level;
+    for (Scope* delta_scope = delta->top_level; delta_scope != NULL; delta_scope = circuit_next_scope_in_prefix(delta_scope)) {
+        api_expect(scope != NULL, "extension must not add quantifier blocks\n");
+        api_expect(scope->qtype == delta_scope->qtype, "quantifier blocks of the extension must match the circuit\n");
+        for (size_t i = 0; i < vector_count(delta_scope->vars); i++) {
+            const Var* delta_var = vector_get(delta_scope->vars, i);
+            const var_t orig_id = delta_var->shared.id;
+            api_expect(!map_contains(nodes, (int)orig_id), "node %d is already defined\n", orig_id);
+            Var* var = circuit_new_var(circuit, scope, (var_t)circuit->max_num + 1);
+            var->shared.orig_id = orig_id;
+            map_add(nodes, (int)orig_id, var);
+        }
+        scope = circuit_next_scope_in_prefix(scope);
+    }
+    
+    // Gates, inputs are added once all gates of delta are known
+    for (var_t i = 1; i <= delta->max_num; i++) {
+        api_expect(delta->types[i] != NODE_SCOPE, "quantified subformulas are not supported in extensions\n");
+        if (delta->types[i] != NODE_GATE) {
+            continue;
+        }
+        const Gate* delta_gate = delta->nodes[i];
+        api_expect(!map_contains(nodes, (int)i), "node %d is already defined\n", i);
+        Gate* gate = circuit_add_gate(circuit, (var_t)circuit->max_num + 1, delta_gate->type);
+        gate->shared.orig_id = i;
+        map_add(nodes, (int)i, gate);
+    }
+    for (var_t i = 1; i <= delta->max_num; i++) {
+        if (delta->types[i] != NODE_GATE) {
+            continue;
+        }
+        const Gate* delta_gate = delta->nodes[i];
+        Gate* gate = map_get(nodes, (int)i);
+        for (size_t j = 0; j < delta_gate->num_inputs; j++) {
+            circuit_add_to_gate(circuit, gate, import_extension_literal(nodes, delta_gate->inputs[j]));
+        }
+    }
+    circuit->output = import_extension_literal(nodes, delta->output);
+    api_expect(circuit->types[lit_to_var(circuit->output)] == NODE_GATE, "output must be a gate\n");
+    map_free(nodes);
+    
+    circuit_to_nnf(circuit, first_node);
+    
+    // Topological order of the new nodes, the old nodes keep their ids
+    var_t* new_ids = calloc(circuit->size + 1, sizeof(var_t));
+    node_type* new_types = calloc(circuit->size + 1, sizeof(node_type));
+    for (var_t i = 1; i < first_node; i++) {
+        new_ids[i] = i;
+    }
+    var_t new_id = first_node;
+    circuit->phase = BUILDING;  // occurrences of the new inputs are counted by process_occurrence
+    for (var_t i = first_node; i <= circuit->max_num; i++) {
+        if (new_ids[i] == 0) {
+            topological_sort_dfs(circuit, new_ids, &new_id, new_types, (lit_t)i);
+        }
+    }
+    circuit->phase = ENCODED;
+    assert(new_id == circuit->max_num + 1);
+    
+    qsort(circuit->nodes + first_node, circuit->max_num + 1 - first_node, sizeof(node*), compare_nodes);
+    memcpy(circuit->types + first_node, new_types + first_node, (circuit->max_num + 1 - first_node) * sizeof(node_type));
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (circuit->types[i] != NODE_GATE) {
+            continue;
+        }
+        Gate* gate = circuit->nodes[i];
+        gate->negation = new_ids[gate->negation];
+    }
+    circuit->output = create_lit_from_value(new_ids[lit_to_var(circuit->output)], circuit->output);
+    
+    free(new_ids);
+    free(new_types);
+    
+    assert(circuit_check_occurrences(circuit));
+    assert(is_nnf(circuit));
 }
 
 
@@ -1068,7 +1299,14 @@ static void remove_singleton_gate(Circuit* circuit, Gate* outer_gate, size_t pos
     node_shared* input_node = circuit->nodes[input_var];
     
     inner_gate->shared.num_occ--;
-    if (inner_gate->shared.num_occ == 0) {
+    if (input_node == NULL) {
+        // input was removed together with its scope, the outer gate drops
+        // it when it is propagated
+        if (inner_gate->shared.num_occ == 0) {
+            inner_gate->num_inputs = 0;
+            remove_gate(circuit, inner_gate->shared.id);
+        }
+    } else if (inner_gate->shared.num_occ == 0) {
         // removal does not change occurrences of other vars, except when node was not added
         inner_gate->num_inputs = 0;
         remove_gate(circuit, inner_gate->shared.id);
@@ -1079,8 +1317,6 @@ static void remove_singleton_gate(Circuit* circuit, Gate* outer_gate, size_t pos
         // we actually duplicated the input, hence, we have to increase occurrence
         input_node->num_occ++;
     }
-    
-    assert(circuit_check(circuit));
 }
 
 /**
@@ -1099,8 +1335,8 @@ static void flatten_gates(Circuit* circuit, Gate* outer_gate, size_t pos, Gate*
     for (size_t i = 0; i < inner_gate->num_inputs; i++) {
         const lit_t input = inner_gate->inputs[i];
         const bool added = circuit_add_to_gate(circuit, outer_gate, input);
-        if (!added) {
-            node_shared* input_node = circuit->nodes[lit_to_var(input)];
+        node_shared* input_node = circuit->nodes[lit_to_var(input)];
+        if (!added && input_node != NULL) {
             input_node->num_occ--;
         }
     }
@@ -1137,41 +1373,6 @@ Var* circuit_is_var(Circuit* circuit, lit_t lit) {
     return NULL;
 }
 
-/**
- * Normalizes the circuit data structure. Performs the following techniques:
- * - Flattening: and(and(a, b), c) => and(a, b, c) [Method checks that there is only one occurrence of and(a,b)]
- * - Singletons: and(a, or(b)) => and(a, b)
- */
-static size_t circuit_normalize(Circuit* circuit) {
-
-    size_t changes = 0;
-    
-    for (size_t var = 1; var <= circuit->max_num; var++) {
-        const node_type type = circuit->types[var];
-        
-        if (type != NODE_GATE) {
-            continue;
-        }
-        
-        Gate* gate = circuit->nodes[var];
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            lit_t input = gate->inputs[i];
-            Gate* inner_gate = circuit_is_gate(circuit, input);
-            if (inner_gate == NULL || inner_gate->num_inputs == 0) {
-                continue;
-            }
-            if (inner_gate->num_inputs == 1) {
-                remove_singleton_gate(circuit, gate, i, inner_gate);
-                changes++;
-            } else if (gate->type == inner_gate->type && inner_gate->shared.num_occ == 1) {
-                flatten_gates(circuit, gate, i, inner_gate);
-                changes++;
-            }
-        }
-    }
-    return changes;
-}
-
 static void update_polarity(Var* var, lit_t occurrence) {
     assert(occurrence != 0);
     
@@ -1190,77 +1391,6 @@ static void update_polarity(Var* var, lit_t occurrence) {
     }
 }
 
-static void circuit_compute_polarities(Circuit* circuit) {
-    
-    for (size_t i = 1; i <= circuit->max_num; i++) {
-        if (circuit->types[i] == NODE_GATE) {
-            Gate* gate = circuit->nodes[i];
-            for (size_t j = 0; j < gate->num_inputs; j++) {
-                lit_t gate_input = gate->inputs[j];
-                var_t gate_var = lit_to_var(gate_input);
-                if (circuit->types[gate_var] != NODE_VAR) {
-                    continue;
-                }
-                Var* var = circuit->nodes[gate_var];
-                update_polarity(var, gate_input);
-            }
-        } else if (circuit->types[i] == NODE_SCOPE) {
-            ScopeNode* node = circuit->nodes[i];
-            var_t sub_var = lit_to_var(node->sub);
-            if (circuit->types[sub_var] != NODE_VAR) {
-                continue;
-            }
-            Var* var = circuit->nodes[sub_var];
-            update_polarity(var, node->sub);
-        }
-    }
-    
-    for (size_t i = 0; i < vector_count(circuit->vars); i++) {
-        Var* var = vector_get(circuit->vars, i);
-        if (var->removed) {
-            continue;
-        }
-        polarity_type polarity = var->polarity;
-        
-        int value = 0;
-        if (polarity == POLARITY_NEG) {
-            value = -1;
-            logging_debug("variable %d appears only negatively\n", var->shared.orig_id);
-        } else if (polarity == POLARITY_POS) {
-            value = 1;
-            logging_debug("variable %d appears only positively\n", var->shared.orig_id);
-        }
-        
-        if (var->scope->qtype == QUANT_FORALL) {
-            value = -value;
-        }
-        
-        if (value != 0) {
-            circuit_set_value(circuit, var->shared.id, value);
-        } else {
-            // Reset if called again
-            var->polarity = POLARITY_UNDEFINED;
-        }
-    }
-}
-
-static void get_forced_variables(Circuit* circuit) {
-    Gate* root = circuit->nodes[circuit->output];
-    for (size_t i = 0; i < root->num_inputs; i++) {
-        const lit_t lit = root->inputs[i];
-        const var_t var = lit_to_var(lit);
-        const Var* var_node = circuit_is_var(circuit, lit);
-        if (var_node != NULL) {
-            //printf("Value of %d must be %d\n", var, lit);
-            if (var_node->scope->qtype == QUANT_FORALL) {
-                circuit_set_value(circuit, var, lit > 0 ? -1 : 1);
-            } else {
-                circuit_set_value(circuit, var, lit > 0 ? 1 : -1);
-            }
-        }
-    }
-}
-
 void remove_var(Circuit* circuit, var_t var_id) {
     //api_expect(circuit->phase == ENCODED || circuit->phase == PROPAGATION, "circuit must be encoded first\n");
     api_expect(var_id > 0, "variables must be greater than zero\n");
@@ -1366,92 +1496,439 @@ static void remove_gates_recursive(Circuit* circuit, var_t node_var) {
     free_gate(gate);
 }
 
-static size_t remove_orphans(Circuit* circuit) {
-    size_t removed = 0;
-    for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_type type = circuit->types[i];
-        if (type == NODE_GATE) {
+/**
+ * State of the incremental preprocessing.
+ *
+ * The parents (gates and scope nodes having node i as input) of node i are
+ * parents[parents_start[i]], ..., parents[parents_start[i + 1] - 1] followed by
+ * added_parents[i] for inputs that were added during preprocessing. The lists
+ * are only extended, entries whose parent was removed or no longer contains
+ * node i are skipped when used.
+ */
+typedef struct {
+    Circuit* circuit;
+    size_t* parents_start;
+    var_t* parents;
+    int_vector** added_parents;
+    int_queue worklist;  // nodes whose inputs, value, or occurrences changed
+    bool* queued;
+    size_t num_propagations;
+} preprocessing;
+
+static size_t preprocess_num_parents(const preprocessing* pre, var_t node) {
+    size_t num_parents = pre->parents_start[node + 1] - pre->parents_start[node];
+    if (pre->added_parents[node] != NULL) {
+        num_parents += int_vector_count(pre->added_parents[node]);
+    }
+    return num_parents;
+}
+
+static var_t preprocess_get_parent(const preprocessing* pre, var_t node, size_t i) {
+    const size_t num_initial = pre->parents_start[node + 1] - pre->parents_start[node];
+    if (i < num_initial) {
+        return pre->parents[pre->parents_start[node] + i];
+    }
+    return (var_t)int_vector_get(pre->added_parents[node], i - num_initial);
+}
+
+static void preprocess_add_parent(preprocessing* pre, var_t node, var_t parent) {
+    if (pre->added_parents[node] == NULL) {
+        pre->added_parents[node] = int_vector_init();
+    }
+    int_vector_add(pre->added_parents[node], (int)parent);
+}
+
+/**
+ * Builds the parent lists in two passes, counting and filling.
+ */
+static void preprocess_init_parents(preprocessing* pre) {
+    Circuit* circuit = pre->circuit;
+    pre->parents_start = calloc(circuit->max_num + 2, sizeof(size_t));
+    pre->added_parents = calloc(circuit->max_num + 1, sizeof(int_vector*));
+    
+    size_t* count = pre->parents_start + 1;  // count[i] is number of parents of node i
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (circuit->types[i] == NODE_GATE) {
             Gate* gate = circuit->nodes[i];
-            size_t k = 0;
             for (size_t j = 0; j < gate->num_inputs; j++) {
-                lit_t gate_input = gate->inputs[j];
-                var_t gate_var = lit_to_var(gate_input);
-                gate->inputs[k] = gate->inputs[j];
-                if (circuit->nodes[gate_var] != NULL) {
-                    k++;
-                } else {
-                    removed++;
-                }
+                count[lit_to_var(gate->inputs[j])]++;
             }
-            assert(k <= gate->num_inputs);
-            gate->num_inputs = k;
-        } else if (type == NODE_SCOPE) {
+        } else if (circuit->types[i] == NODE_SCOPE) {
             ScopeNode* scope_node = circuit->nodes[i];
-            var_t var = lit_to_var(scope_node->sub);
-            assert(circuit->nodes[var] != NULL);
+            count[lit_to_var(scope_node->sub)]++;
         }
     }
-    return removed;
-}
-
-static bool circuit_propagate(Circuit* circuit) {
-    unsigned num_propagations = 0;
-    circuit_evaluate(circuit);
-    // Remove gates and variables whose values were determined
+    // prefix sums, afterwards parents_start[i + 1] is the end of the parents of i
+    for (var_t i = 1; i <= circuit->max_num + 1; i++) {
+        pre->parents_start[i] += pre->parents_start[i - 1];
+    }
+    pre->parents = malloc(sizeof(var_t) * (pre->parents_start[circuit->max_num + 1] + 1));
+    
+    size_t* next = calloc(circuit->max_num + 1, sizeof(size_t));
     for (var_t i = 1; i <= circuit->max_num; i++) {
-        if (circuit->nodes[i] == NULL) {
-            continue;
-        }
-        node_shared* node = circuit->nodes[i];
-        if (node->value == 0) {
-            continue;
-        }
-        
-        if (i != lit_to_var(circuit->output)) {
-            num_propagations++;
-        }
-        
-        if (circuit->types[i] == NODE_VAR) {
-            remove_var(circuit, i);
+        if (circuit->types[i] == NODE_GATE) {
+            Gate* gate = circuit->nodes[i];
+            for (size_t j = 0; j < gate->num_inputs; j++) {
+                const var_t input = lit_to_var(gate->inputs[j]);
+                pre->parents[pre->parents_start[input] + next[input]++] = i;
+            }
         } else if (circuit->types[i] == NODE_SCOPE) {
-            remove_scope_node(circuit, i);
-        } else {
-            assert(circuit->types[i] == NODE_GATE);
-            remove_gate(circuit, i);
+            ScopeNode* scope_node = circuit->nodes[i];
+            const var_t sub = lit_to_var(scope_node->sub);
+            pre->parents[pre->parents_start[sub] + next[sub]++] = i;
         }
     }
-    
-    num_propagations += remove_orphans(circuit);
-    
-    logging_info("%d propagations\n", num_propagations);
-    return num_propagations > 0;
+    free(next);
 }
 
-
-/**
+static void preprocess_enqueue(preprocessing* pre, var_t node) {
+    if (pre->queued[node] || pre->circuit->nodes[node] == NULL) {
+        return;
+    }
+    pre->queued[node] = true;
+    int_queue_push(&pre->worklist, (int)node);
+}
+
+static void preprocess_enqueue_parents(preprocessing* pre, var_t node) {
+    const size_t num_parents = preprocess_num_parents(pre, node);
+    for (size_t i = 0; i < num_parents; i++) {
+        preprocess_enqueue(pre, preprocess_get_parent(pre, node, i));
+    }
+}
+
+/**
+ * Marks node and all its parents as dirty.
+ */
+static void preprocess_node_changed(preprocessing* pre, var_t node) {
+    preprocess_enqueue(pre, node);
+    preprocess_enqueue_parents(pre, node);
+}
+
+/**
+ * Called when an occurrence of node was removed. The node may have become
+ * unreachable or of single polarity, a gate with a single remaining occurrence
+ * may be flattened into its parent.
+ */
+static void preprocess_occurrence_removed(preprocessing* pre, var_t node) {
+    const node_shared* shared = pre->circuit->nodes[node];
+    if (shared == NULL) {
+        return;
+    }
+    if (pre->circuit->types[node] == NODE_VAR || shared->num_occ == 0) {
+        preprocess_enqueue(pre, node);
+    } else if (pre->circuit->types[node] == NODE_GATE && shared->num_occ == 1) {
+        preprocess_enqueue_parents(pre, node);
+    }
+}
+
+static void preprocess_set_value(preprocessing* pre, var_t node, int value) {
+    assert(value != 0);
+    circuit_set_value(pre->circuit, node, value);
+    if (node != lit_to_var(pre->circuit->output)) {
+        pre->num_propagations++;
+    }
+    preprocess_enqueue_parents(pre, node);
+}
+
+/**
+ * Removes a gate and marks its former inputs as dirty.
+ */
+static void preprocess_remove_gate(preprocessing* pre, Gate* gate) {
+    Circuit* circuit = pre->circuit;
+    const size_t num_inputs = gate->num_inputs;
+    var_t* inputs = malloc(sizeof(var_t) * (num_inputs + 1));
+    for (size_t i = 0; i < num_inputs; i++) {
+        inputs[i] = lit_to_var(gate->inputs[i]);
+    }
+    remove_gate(circuit, gate->shared.id);
+    for (size_t i = 0; i < num_inputs; i++) {
+        preprocess_occurrence_removed(pre, inputs[i]);
+    }
+    free(inputs);
+}
+
+static void preprocess_remove_var(preprocessing* pre, Var* var) {
+    Circuit* circuit = pre->circuit;
+    const var_t scope_node = var->scope->node;
+    remove_var(circuit, var->shared.id);
+    if (scope_node != 0 && circuit->types[scope_node] == NODE_GATE) {
+        // scope became empty and its scope node was replaced by a singleton gate
+        preprocess_node_changed(pre, scope_node);
+    }
+}
+
+/**
+ * Single polarity variables get the value that is best for its quantifier.
+ * Variables whose value is known are removed once they have no occurrences.
+ */
+static void preprocess_var(preprocessing* pre, Var* var) {
+    Circuit* circuit = pre->circuit;
+    const var_t id = var->shared.id;
+    
+    if (var->shared.value != 0) {
+        if (var->shared.num_occ == 0) {
+            preprocess_remove_var(pre, var);
+        }
+        return;
+    }
+    if (var->frozen) {
+        return;
+    }
+    
+    const size_t num_parents = preprocess_num_parents(pre, id);
+    var->polarity = POLARITY_UNDEFINED;
+    for (size_t i = 0; i < num_parents && var->polarity != POLARITY_NONE; i++) {
+        const var_t parent = preprocess_get_parent(pre, id, i);
+        if (circuit->nodes[parent] == NULL) {
+            continue;
+        }
+        if (circuit->types[parent] == NODE_GATE) {
+            Gate* gate = circuit->nodes[parent];
+            for (size_t j = 0; j < gate->num_inputs; j++) {
+                if (lit_to_var(gate->inputs[j]) == id) {
+                    update_polarity(var, gate->inputs[j]);
+                }
+            }
+        } else if (circuit->types[parent] == NODE_SCOPE) {
+            ScopeNode* scope_node = circuit->nodes[parent];
+            if (lit_to_var(scope_node->sub) == id) {
+                update_polarity(var, scope_node->sub);
+            }
+        }
+    }
+    
+    int value = 0;
+    if (var->polarity == POLARITY_NEG) {
+        value = -1;
+        logging_debug("variable %d appears only negatively\n", var->shared.orig_id);
+    } else if (var->polarity == POLARITY_POS) {
+        value = 1;
+        logging_debug("variable %d appears only positively\n", var->shared.orig_id);
+    }
+    var->polarity = POLARITY_UNDEFINED;
+    
+    if (var->scope->qtype == QUANT_FORALL) {
+        value = -value;
+    }
+    if (value != 0) {
+        preprocess_set_value(pre, id, value);
+    }
+}
+
+/**
+ * Applies the following techniques to a single gate:
+ * - Propagation: inputs with neutral value are removed, a dominating input
+ *   (or a conflict) determines the value of the gate
+ * - Forced variables: variables that are inputs of the output gate
+ * - Singletons: and(a, or(b)) => and(a, b)
+ * - Flattening: and(and(a, b), c) => and(a, b, c) [only if and(a,b) has a single occurrence]
+ */
+static void preprocess_gate(preprocessing* pre, Gate* gate) {
+    Circuit* circuit = pre->circuit;
+    const var_t id = gate->shared.id;
+    const bool is_output = id == lit_to_var(circuit->output);
+    
+    if (!is_output && gate->shared.num_occ == 0) {
+        preprocess_remove_gate(pre, gate);
+        return;
+    }
+    if (gate->shared.value != 0) {
+        // removed once the parents do not reference it anymore
+        return;
+    }
+    
+    // Propagation
+    const int neutral = gate->type == GATE_AND ? 1 : -1;
+    int value = 0;
+    size_t k = 0;
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        const lit_t lit = gate->inputs[i];
+        const var_t var = lit_to_var(lit);
+        node_shared* node = circuit->nodes[var];
+        if (node == NULL) {
+            // input was removed together with its scope
+            pre->num_propagations++;
+            continue;
+        }
+        const int input_value = lit < 0 ? -node->value : node->value;
+        if (input_value == neutral) {
+            node->num_occ--;
+            pre->num_propagations++;
+            preprocess_occurrence_removed(pre, var);
+            continue;
+        }
+        if (input_value == -neutral) {
+            value = -neutral;
+        }
+        gate->inputs[k++] = lit;
+    }
+    const bool inputs_removed = k < gate->num_inputs;
+    gate->num_inputs = k;
+    
+    if (value == 0 && gate->conflict && gate->num_inputs > 0) {
+        value = -neutral;
+    } else if (value == 0 && gate->num_inputs == 0) {
+        value = neutral;
+    }
+    if (value != 0) {
+        preprocess_set_value(pre, id, value);
+        if (is_output) {
+            // the output gate is kept as constant gate
+            preprocess_remove_gate(pre, gate);
+        }
+        return;
+    }
+    if (inputs_removed && gate->num_inputs == 1) {
+        // became a singleton
+        preprocess_enqueue_parents(pre, id);
+    }
+    
+    // Forced variables
+    if (is_output) {
+        for (size_t i = 0; i < gate->num_inputs; i++) {
+            const lit_t lit = gate->inputs[i];
+            const Var* var = circuit_is_var(circuit, lit);
+            if (var == NULL || var->shared.value != 0 || var->frozen) {
+                continue;
+            }
+            if (var->scope->qtype == QUANT_FORALL) {
+                preprocess_set_value(pre, var->shared.id, lit > 0 ? -1 : 1);
+            } else {
+                preprocess_set_value(pre, var->shared.id, lit > 0 ? 1 : -1);
+            }
+        }
+    }
+    
+    // Normalization
+    bool changed = false;
+    size_t i = 0;
+    while (i < gate->num_inputs) {
+        Gate* inner_gate = circuit_is_gate(circuit, gate->inputs[i]);
+        if (inner_gate == NULL || inner_gate->num_inputs == 0 || inner_gate->shared.value != 0) {
+            i++;
+            continue;
+        }
+        const var_t inner_id = inner_gate->shared.id;
+        if (inner_gate->num_inputs == 1) {
+            const var_t input = lit_to_var(inner_gate->inputs[0]);
+            remove_singleton_gate(circuit, gate, i, inner_gate);
+            preprocess_add_parent(pre, input, id);
+            preprocess_occurrence_removed(pre, input);
+            preprocess_occurrence_removed(pre, inner_id);
+            changed = true;
+        } else if (gate->type == inner_gate->type && inner_gate->shared.num_occ == 1) {
+            const size_t num_inputs = inner_gate->num_inputs;
+            var_t* inputs = malloc(sizeof(var_t) * num_inputs);
+            for (size_t j = 0; j < num_inputs; j++) {
+                inputs[j] = lit_to_var(inner_gate->inputs[j]);
+                preprocess_add_parent(pre, inputs[j], id);
+            }
+            flatten_gates(circuit, gate, i, inner_gate);
+            for (size_t j = 0; j < num_inputs; j++) {
+                preprocess_occurrence_removed(pre, inputs[j]);
+            }
+            free(inputs);
+            changed = true;
+        } else {
+            i++;
+        }
+    }
+    if (changed) {
+        // inputs changed, propagate again (and check for conflicts)
+        preprocess_enqueue(pre, id);
+    }
+}
+
+static void preprocess_scope_node(preprocessing* pre, ScopeNode* scope_node) {
+    Circuit* circuit = pre->circuit;
+    const var_t id = scope_node->shared.id;
+    const var_t sub = lit_to_var(scope_node->sub);
+    
+    if (scope_node->shared.num_occ == 0 && id != lit_to_var(circuit->output)) {
+        // The node is not reachable anymore. The value of an unreachable node
+        // does not matter, assigning one removes the node together with its scope.
+        if (scope_node->shared.value == 0) {
+            scope_node->shared.value = 1;
+        }
+        remove_scope_node(circuit, id);
+        preprocess_occurrence_removed(pre, sub);
+        return;
+    }
+    
+    if (scope_node->shared.value == 0) {
+        const node_shared* sub_node = circuit->nodes[sub];
+        assert(sub_node != NULL);
+        if (sub_node->value != 0) {
+            preprocess_set_value(pre, id, scope_node->sub < 0 ? -sub_node->value : sub_node->value);
+        }
+    }
+}
+
+/**
  * Implements the following preprocessing techniques:
  * - Propagation of fixed variables (unit clauses)
  * - Single polarity variables
- * @see circuit_normalize
+ * - Flattening and removal of singleton gates
+ *
+ * Instead of repeating every technique on the whole circuit until a fixed
+ * point is reached, nodes are processed from a worklist. A node is added to
+ * the worklist when its value, inputs, or occurrences change, thus, a
+ * simplification only re-examines the affected parts of the circuit. The
+ * circuit is reencoded once in the end.
+ * @see preprocess_gate
  */
 void circuit_preprocess(Circuit* circuit) {
     api_expect(circuit->phase == ENCODED, "circuit must be encoded\n");
     circuit->phase = PROPAGATION;
     
-    bool changed;
-    do {
-        changed = false;
-        changed |= circuit_normalize(circuit) > 0;
-        assert(circuit_check(circuit));
-        detect_empty_scopes_recursively(circuit, circuit->top_level);
-        circuit_compute_polarities(circuit);
-        get_forced_variables(circuit);
-        
-        changed |= circuit_propagate(circuit);
-        assert(circuit_check(circuit));
-        
-        circuit_reencode(circuit);
-    } while (changed);
+    preprocessing pre;
+    pre.circuit = circuit;
+    pre.queued = calloc(circuit->max_num + 1, sizeof(bool));
+    pre.num_propagations = 0;
+    int_queue_init(&pre.worklist);
+    preprocess_init_parents(&pre);
+    
+    // nodes are topologically ordered, thus, the inputs of a node are
+    // processed before the node itself
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        preprocess_enqueue(&pre, i);
+    }
+    
+    while (!int_queue_is_empty(&pre.worklist)) {
+        const var_t node = (var_t)int_queue_pop(&pre.worklist);
+        pre.queued[node] = false;
+        if (circuit->nodes[node] == NULL) {
+            continue;
+        }
+        switch (circuit->types[node]) {
+            case NODE_VAR:
+                preprocess_var(&pre, circuit->nodes[node]);
+                break;
+            case NODE_GATE:
+                preprocess_gate(&pre, circuit->nodes[node]);
+                break;
+            case NODE_SCOPE:
+                preprocess_scope_node(&pre, circuit->nodes[node]);
+                break;
+            default:
+                abort();
+        }
+    }
+    logging_info("%zu propagations\n", pre.num_propagations);
+    
+    for (size_t i = 0; i <= circuit->max_num; i++) {
+        if (pre.added_parents[i] != NULL) {
+            int_vector_free(pre.added_parents[i]);
+        }
+    }
+    free(pre.added_parents);
+    free(pre.parents_start);
+    free(pre.parents);
+    free(pre.queued);
+    int_queue_free(&pre.worklist);
+    
+    detect_empty_scopes_recursively(circuit, circuit->top_level);
+    circuit_reencode(circuit);
 }
 
 
@@ -1547,8 +2024,9 @@ static lit_t replace_variables_in_subtree(Circuit* circuit, map* variable_mappin
     var_t subtree_var = lit_to_var(subtree);
     node_type type = circuit->types[subtree_var];
     if (type == NODE_VAR) {
-        assert(!map_contains(variable_mapping, subtree_var));
-        return subtree;
+        // only happens if the subtree is a variable itself
+        node_shared* copy = map_get(variable_mapping, subtree_var);
+        return copy != NULL ? create_lit_from_value(copy->id, subtree) : subtree;
     } else if (type == NODE_SCOPE) {
         ScopeNode* scope_node = circuit->nodes[subtree_var];
         assert(shared == false);
@@ -1556,18 +2034,11 @@ static lit_t replace_variables_in_subtree(Circuit* circuit, map* variable_mappin
         assert(new_sub == scope_node->sub);  // TODO: check if this is actually true
         scope_node->sub = new_sub;
         
-        //node_shared* sub_node = circuit->nodes[lit_to_var(scope_node->sub)];
-        //bit_vector_free(scope_node->shared.influences);
-        //scope_node->shared.influences = bit_vector_init(0, circuit->max_num);
-        //bit_vector_update_or(scope_node->shared.influences, sub_node->influences);
-        
         return subtree;
     } else {
         assert(type == NODE_GATE);
         Gate* gate = circuit->nodes[subtree_var];
         shared = shared || gate->shared.num_occ > 1;
-        //bit_vector_free(gate->shared.influences);
-        //gate->shared.influences = bit_vector_init(0, circuit->max_num);
         for (size_t i = 0; i < gate->num_inputs; i++) {
             const lit_t gate_input = gate->inputs[i];
             const var_t gate_input_var = lit_to_var(gate_input);
@@ -1594,8 +2065,6 @@ static lit_t replace_variables_in_subtree(Circuit* circuit, map* variable_mappin
                     assert(gate->owner == 0);
                     Gate* copy = copy_gate(circuit, gate);
                     map_add(variable_mapping, gate->shared.id, &copy->shared);
-                    //copy->shared.influences = bit_vector_init(0, circuit->max_num);
-                    //bit_vector_update_or(copy->shared.influences, gate->shared.influences);
                     copy->owner = scope_node_id;
                     for (size_t j = 0; j < copy->num_inputs; j++) {
                         // add +1 to occurrences since gate is copied
@@ -1618,343 +2087,398 @@ static lit_t replace_variables_in_subtree(Circuit* circuit, map* variable_mappin
             }
             
             gate->inputs[i] = new_input;
-            //node_shared* sub_node = circuit->nodes[lit_to_var(gate->inputs[i])];
-            //bit_vector_update_or(gate->shared.influences, sub_node->influences);
         }
         return create_lit(gate->shared.id, false);
     }
 }
 
-static void circuit_compute_variable_influence_dfs(Circuit* circuit, lit_t node_id) {
-    const var_t node_var = lit_to_var(node_id);
-    const node_type type = circuit->types[node_var];
-    
-    node_shared* node = circuit->nodes[node_var];
-    assert(node != NULL);
-    
-    if (node->dfs_processed) {
-        return;
+static var_t union_find_root(var_t* parent, var_t node) {
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];  // path halving
+        node = parent[node];
     }
-    
-    if (type == NODE_VAR) {
-        return;
-    } else if (type == NODE_GATE) {
-        Gate* gate = circuit->nodes[node_var];
-        for (size_t j = 0; j < gate->num_inputs; j++) {
-            const lit_t gate_input = gate->inputs[j];
-            circuit_compute_variable_influence_dfs(circuit, gate_input);
-            const var_t var = lit_to_var(gate_input);
-            node_shared* occ_node = circuit->nodes[var];
-            assert(occ_node->influences != NULL);
-            bit_vector_update_or(node->influences, occ_node->influences);
-        }
-        gate->shared.dfs_processed = true;
-    } else {
-        assert(type == NODE_SCOPE);
-        ScopeNode* scope_node = circuit->nodes[node_var];
-        circuit_compute_variable_influence_dfs(circuit, scope_node->sub);
-        const var_t var = lit_to_var(scope_node->sub);
-        node_shared* occ_node = circuit->nodes[var];
-        assert(occ_node->influences != NULL);
-        bit_vector_update_or(node->influences, occ_node->influences);
-        scope_node->shared.dfs_processed = true;
+    return node;
+}
+
+static void union_find_merge(var_t* parent, var_t lhs, var_t rhs) {
+    lhs = union_find_root(parent, lhs);
+    rhs = union_find_root(parent, rhs);
+    if (lhs < rhs) {
+        parent[rhs] = lhs;
+    } else if (rhs < lhs) {
+        parent[lhs] = rhs;
     }
 }
 
-static void circuit_compute_variable_influence(Circuit* circuit) {
-    const size_t max_var = circuit->num_vars;
-    
-    // Compute which variable influences which gate
-    for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_shared* node = circuit->nodes[i];
-        if (node == NULL) {
-            continue;
-        }
-        //assert(node->influences == NULL);
-        bit_vector_free(node->influences);
-        node->influences = bit_vector_init(0, max_var);
-        node->dfs_processed = false;
-        
-        const node_type type = circuit->types[i];
-        
-        if (type == NODE_VAR) {
-            Var* var = circuit->nodes[i];
-            assert(var->var_id < max_var);
-            bit_vector_add(node->influences, var->var_id);
-        } else if (type == NODE_GATE) {
-            Gate* gate = circuit->nodes[i];
-            gate->owner = 0;
-        }
+/**
+ * Scratch data of the miniscoping of a single scope, indexed by node id.
+ *
+ * A node is relevant if its subtree contains a variable of the scope or of an
+ * inner scope in the quantifier prefix. Relevant nodes are merged with their
+ * relevant inputs in a union-find structure, such that two inputs of the
+ * root gate end up in the same set iff they are connected through such
+ * variables.
+ */
+typedef struct {
+    Circuit* circuit;
+    Scope* scope;
+    size_t size;
+    bool* relevant;
+    var_t* visited;   // stamp of last traversal that visited the node
+    var_t* parent;    // union-find
+    lit_t* stack;     // traversal stack, see miniscoping_merge_subtree
+    size_t stack_count;
+    size_t stack_size;
+} miniscoping;
+
+static void miniscoping_init(miniscoping* ms, Circuit* circuit, Scope* scope) {
+    ms->circuit = circuit;
+    ms->scope = scope;
+    ms->size = circuit->max_num + 1;
+    ms->relevant = calloc(ms->size, sizeof(bool));
+    ms->visited = calloc(ms->size, sizeof(var_t));
+    ms->parent = malloc(ms->size * sizeof(var_t));
+    for (var_t i = 0; i < ms->size; i++) {
+        ms->parent[i] = i;
     }
-    
-    circuit_compute_variable_influence_dfs(circuit, circuit->output);
+    ms->stack_count = 0;
+    ms->stack_size = 16;
+    ms->stack = malloc(ms->stack_size * sizeof(lit_t));
 }
 
-static void apply_miniscoping(Circuit* circuit, Scope* scope, var_t node, var_t* partitions) {
-    if (circuit->types[node] != NODE_GATE) {
-        return;
+static void miniscoping_free(miniscoping* ms) {
+    free(ms->relevant);
+    free(ms->visited);
+    free(ms->parent);
+    free(ms->stack);
+}
+
+static void miniscoping_push(miniscoping* ms, lit_t entry) {
+    if (ms->stack_count == ms->stack_size) {
+        ms->stack_size *= 2;
+        ms->stack = realloc(ms->stack, ms->stack_size * sizeof(lit_t));
     }
-    
-    circuit_compute_variable_influence(circuit);
-    
-    Gate* gate = circuit->nodes[node];
-    
-    if (gate->shared.num_occ > 1) {
-        // Do not split if gate is shared
+    ms->stack[ms->stack_count++] = entry;
+}
+
+static bool miniscoping_is_relevant_var(const miniscoping* ms, const Var* var) {
+    return var->scope->scope_id >= ms->scope->scope_id;
+}
+
+/**
+ * Computes relevance and merges the relevant nodes in the subtree of node by
+ * an iterative post-order traversal. Every node is visited once.
+ */
+static void miniscoping_merge_subtree(miniscoping* ms, var_t node) {
+    Circuit* circuit = ms->circuit;
+    const var_t stamp = 1;
+    if (ms->visited[node] == stamp) {
         return;
     }
     
-    if ((gate->type == GATE_AND && scope->qtype == QUANT_FORALL) || (gate->type == GATE_OR && scope->qtype == QUANT_EXISTS)) {
-        // create a scope node for every gate input
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            lit_t gate_input = gate->inputs[i];
-            ScopeNode* scope_node = circuit_new_scope_node(circuit, scope->qtype, circuit->max_num + 1);
-            map* replacement = map_init();
-            node_shared* gate_node = circuit->nodes[lit_to_var(gate_input)];
-            for (size_t k = 0; k < vector_count(scope->vars); k++) {
-                Var* var = vector_get(scope->vars, k);
-                if (bit_vector_contains(gate_node->influences, var->var_id)) {
-                    // copy variable and add it to newly created scope
-                    Var* copy = copy_variable(circuit, var, scope_node->scope);
-                    //copy->shared.influences = bit_vector_init(0, circuit->num_vars);
-                    //bit_vector_add(copy->shared.influences, copy->var_id);
-                    map_add(replacement, var->shared.id, &copy->shared);
+    // the entry of a node is negated when it is entered, when the negated
+    // entry is on top of the stack again, all inputs are processed
+    ms->stack_count = 0;
+    miniscoping_push(ms, (lit_t)node);
+    while (ms->stack_count > 0) {
+        const lit_t top = ms->stack[ms->stack_count - 1];
+        ms->stack[ms->stack_count - 1] = -top;
+        
+        if (top < 0) {
+            const var_t current = lit_to_var(top);
+            ms->stack_count--;
+            if (circuit->types[current] == NODE_GATE) {
+                Gate* gate = circuit->nodes[current];
+                for (size_t i = 0; i < gate->num_inputs; i++) {
+                    const var_t input = lit_to_var(gate->inputs[i]);
+                    if (ms->relevant[input]) {
+                        ms->relevant[current] = true;
+                        union_find_merge(ms->parent, current, input);
+                    }
+                }
+            } else if (circuit->types[current] == NODE_SCOPE) {
+                ScopeNode* scope_node = circuit->nodes[current];
+                const var_t sub = lit_to_var(scope_node->sub);
+                if (ms->relevant[sub]) {
+                    ms->relevant[current] = true;
+                    union_find_merge(ms->parent, current, sub);
                 }
             }
-            if (vector_count(scope_node->scope->vars) == 0) {
-                free_scope_node(circuit, scope_node);
-                continue;
-            }
-            
-            // connect scope_node to circuit
-            gate->inputs[i] = scope_node->shared.id;
-            scope_node->sub = replace_variables_in_subtree(circuit, replacement, scope_node->shared.id, false, gate_input);
-            scope_node->shared.num_occ = 1;
-            if (scope_node->sub != gate_input) {
-                node_shared* sub_node = circuit->nodes[lit_to_var(scope_node->sub)];
-                sub_node->num_occ++;
-                node_shared* old_sub_node = circuit->nodes[lit_to_var(gate_input)];
-                old_sub_node->num_occ--;
-            }
-            //scope_node->shared.influences = bit_vector_init(0, circuit->max_num);
-            //node_shared* sub_node = circuit->nodes[lit_to_var(scope_node->sub)];
-            //bit_vector_update_or(scope_node->shared.influences, sub_node->influences);
-            
-            map_free(replacement);
+            continue;
         }
         
-        assert(scope->num_next == 0);
-        
-        size_t num_vars = vector_count(scope->vars);
-        while (num_vars > 0) {
-            Var* var = vector_get(scope->vars, 0);
-            remove_var(circuit, var->shared.id);
-            num_vars--;
+        const var_t current = (var_t)top;
+        if (ms->visited[current] == stamp) {
+            ms->stack_count--;
+            continue;
         }
-        // remove no longer reachable nodes
-        for (size_t i = 1; i <= circuit->max_num; i++) {
-            node_shared* other_node = circuit->nodes[i];
-            if (other_node == NULL) {
-                continue;
+        ms->visited[current] = stamp;
+        
+        if (circuit->types[current] == NODE_VAR) {
+            ms->relevant[current] = miniscoping_is_relevant_var(ms, circuit->nodes[current]);
+            ms->stack_count--;
+        } else if (circuit->types[current] == NODE_GATE) {
+            Gate* gate = circuit->nodes[current];
+            gate->owner = 0;
+            for (size_t i = 0; i < gate->num_inputs; i++) {
+                const var_t input = lit_to_var(gate->inputs[i]);
+                if (ms->visited[input] != stamp) {
+                    miniscoping_push(ms, (lit_t)input);
+                }
             }
-            if (other_node->num_occ == 0 && other_node->id != lit_to_var(circuit->output)) {
-                remove_gates_recursive(circuit, other_node->id);
+        } else {
+            assert(circuit->types[current] == NODE_SCOPE);
+            ScopeNode* scope_node = circuit->nodes[current];
+            const var_t sub = lit_to_var(scope_node->sub);
+            if (ms->visited[sub] != stamp) {
+                miniscoping_push(ms, (lit_t)sub);
             }
         }
-    } else {
-        // check if there are influences
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            const lit_t gate_input = gate->inputs[i];
-            const var_t gate_var = lit_to_var(gate_input);
-            node_shared* occ_node = circuit->nodes[gate_var];
-            bool has_connection = false;
-            var_t connection = 0;
-            
-            for (size_t var_id = bit_vector_init_iteration(occ_node->influences); bit_vector_iterate(occ_node->influences); var_id = bit_vector_next(occ_node->influences)) {
-                Var* var = vector_get(circuit->vars, var_id);
-                
-                if (var->scope->scope_id < scope->scope_id) {
-                    continue;
-                }
-                
-                // Check whether this variable connects some variable sets
-                while (partitions[partitions[var_id]] != partitions[var_id]) { // compactify
-                    partitions[var_id] = partitions[partitions[var_id]];
-                }
-                if (!has_connection) {
-                    has_connection = true;
-                    connection = partitions[var_id];
-                    continue;
-                }
-                assert(has_connection);
-                if (connection < partitions[var_id]) {
-                    partitions[partitions[var_id]] = connection;
-                    partitions[var_id] = connection;
-                }
-                if (connection > partitions[var_id]) {
-                    partitions[connection] = partitions[var_id];
-                    connection = partitions[var_id];
-                }
-            }
+    }
+}
+
+/**
+ * Collects the variables of the scope in the subtree of node, only descending
+ * into relevant nodes. The stamp has to be unique for every call.
+ */
+static void miniscoping_collect_variables(miniscoping* ms, var_t node, var_t stamp, vector* result) {
+    Circuit* circuit = ms->circuit;
+    assert(stamp > 1);
+    
+    ms->stack_count = 0;
+    miniscoping_push(ms, (lit_t)node);
+    while (ms->stack_count > 0) {
+        const var_t current = (var_t)ms->stack[--ms->stack_count];
+        if (ms->visited[current] == stamp || !ms->relevant[current]) {
+            continue;
         }
+        ms->visited[current] = stamp;
         
-        /*for (size_t i = 0; i < circuit->num_vars; i++) {
-            printf("%zu %d\n", i, partitions[i]);
-        }*/
-    
-        // This loop does two things at the same time. (that are joined into a single pass over the variables)
-        // 1. It flattens the clausegraph to ensure that all variables of the same variable group have the same number
-        // 2. It maps all variables to their group number (continuously numbered from 0 to maximal group number)
-        // The trick is that the number of groups is smaller or equal to the number i of variables processed so far.
-        // This allows us to use the entries in cg for indices <i as group numbers instead of variable numbers.
-        size_t num_groups = 0;
-        map* groups = map_init();
-        int_vector* pivots = int_vector_init();
-        for (size_t i = 0; i < vector_count(circuit->vars); i++) {
-            Var* var = vector_get(circuit->vars, i);
-            const var_t var_id = var->var_id;
-            assert(var != NULL);
-            assert(var_id < circuit->num_vars);
-            if (var->removed) {
-                continue;
-            }
-            if (var->scope->scope_id < scope->scope_id) {
-                continue;
-            }
-            if (var->scope != scope) {
-                continue;
+        if (circuit->types[current] == NODE_VAR) {
+            Var* var = circuit->nodes[current];
+            if (var->scope == ms->scope) {
+                vector_add(result, var);
             }
-            
-            //logging_debug("Compactifying clause graph for var %d\n", var->shared.id);
-            do { // compactify the entry
-                partitions[var_id] = partitions[partitions[var_id]];
-            } while (partitions[var_id] >= var_id && partitions[var_id] != partitions[partitions[var_id]]);
-            
-            if (partitions[var_id] == var_id) {
-                num_groups++;
-                ScopeNode* scope_node = circuit_new_scope_node(circuit, scope->qtype, circuit->max_num + 1);
-                map_add(groups, var_id, scope_node);
-                move_variable(var, scope, scope_node->scope);
-                link_scope(scope, scope_node->scope);
-                int_vector_add(pivots, var_id);
-            } else {
-                assert(partitions[var_id] < var_id);
-                assert(num_groups > 0);
-                
-                ScopeNode* scope_node = map_get(groups, partitions[var_id]);
-                move_variable(var, scope, scope_node->scope);
-                link_scope(scope, scope_node->scope);
+        } else if (circuit->types[current] == NODE_GATE) {
+            Gate* gate = circuit->nodes[current];
+            for (size_t i = 0; i < gate->num_inputs; i++) {
+                miniscoping_push(ms, (lit_t)lit_to_var(gate->inputs[i]));
             }
-            logging_debug("Variable %d is in variable group %d\n", var_id, partitions[var_id]);
+        } else {
+            assert(circuit->types[current] == NODE_SCOPE);
+            ScopeNode* scope_node = circuit->nodes[current];
+            miniscoping_push(ms, (lit_t)lit_to_var(scope_node->sub));
+        }
+    }
+}
+
+/**
+ * Universal quantifiers distribute over conjunctions and existential
+ * quantifiers over disjunctions: a new scope node with copies of the
+ * variables of the scope is created for every input of the gate.
+ */
+/**
+ * The abstraction expects the sub-node of a scope node to be a gate or a scope
+ * node, thus, a variable is wrapped into a singleton gate.
+ */
+static lit_t miniscoping_wrap_variable(Circuit* circuit, gate_type type, lit_t sub) {
+    if (circuit->types[lit_to_var(sub)] != NODE_VAR) {
+        return sub;
+    }
+    Gate* singleton = circuit_add_gate(circuit, circuit->max_num + 1, type);
+    singleton->shared.num_occ = 1;
+    circuit_add_to_gate(circuit, singleton, sub);
+    return create_lit(singleton->shared.id, false);
+}
+
+static void miniscoping_distribute(miniscoping* ms, Gate* gate) {
+    Circuit* circuit = ms->circuit;
+    Scope* scope = ms->scope;
+    
+    vector* influencing = vector_init();
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        const lit_t gate_input = gate->inputs[i];
+        vector_reset(influencing);
+        miniscoping_collect_variables(ms, lit_to_var(gate_input), (var_t)i + 2, influencing);
+        if (vector_count(influencing) == 0) {
+            continue;
         }
         
-        logging_info("detected %zu groups\n", num_groups);
-        
-        //int_vector_print(pivots);
-        
-        // make a copy of original gate inputs since the gate is modified
-        int_vector* original_gate_inputs = int_vector_init();
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            lit_t gate_input = gate->inputs[i];
-            int_vector_add(original_gate_inputs, gate_input);
+        ScopeNode* scope_node = circuit_new_scope_node(circuit, scope->qtype, circuit->max_num + 1);
+        map* replacement = map_init_size(vector_count(influencing));
+        for (size_t k = 0; k < vector_count(influencing); k++) {
+            // copy variable and add it to newly created scope
+            Var* var = vector_get(influencing, k);
+            Var* copy = copy_variable(circuit, var, scope_node->scope);
+            map_add(replacement, var->shared.id, &copy->shared);
         }
         
-        // connect newly created scope_nodes to circuit
-        for (size_t i = 0; i < int_vector_count(pivots); i++) {
-            var_t pivot = int_vector_get(pivots, i);
-            ScopeNode* scope_node = map_get(groups, pivot);
-            int_vector* relevant_gate_inputs = int_vector_init();
-            for (size_t j = 0; j < int_vector_count(original_gate_inputs); j++) {
-                lit_t gate_input = int_vector_get(original_gate_inputs, j);
-                node_shared* gate_node = circuit->nodes[lit_to_var(gate_input)];
-                for (size_t k = 0; k < vector_count(scope_node->scope->vars); k++) {
-                    Var* var = vector_get(scope_node->scope->vars, k);
-                    if (bit_vector_contains(gate_node->influences, var->var_id)) {
-                        int_vector_add(relevant_gate_inputs, gate_input);
-                        break;
-                    }
-                }
-            }
-            
-            //int_vector_print(relevant_gate_inputs);
-            
-            assert(int_vector_count(relevant_gate_inputs) > 0);
-            if (int_vector_count(relevant_gate_inputs) > 1) {
-                // have to create a new gate containing with the gate_inputs
-                Gate* new_gate = circuit_add_gate(circuit, circuit->max_num + 1, gate->type);
-                new_gate->shared.num_occ = 1;
-                new_gate->shared.influences = bit_vector_init(0, circuit->max_num);
-                for (size_t j = 0; j < int_vector_count(relevant_gate_inputs); j++) {
-                    lit_t gate_input = int_vector_get(relevant_gate_inputs, j);
-                    remove_input_from_gate(gate, gate_input);
-                    circuit_add_to_gate(circuit, new_gate, gate_input);
-                    
-                    node_shared* gate_node = circuit->nodes[lit_to_var(gate_input)];
-                    bit_vector_update_or(new_gate->shared.influences, gate_node->influences);
-                }
-                scope_node->sub = create_lit(new_gate->shared.id, false);
-                circuit_add_to_gate(circuit, gate, create_lit(scope_node->shared.id, false));
-            } else {
-                // we do not have to create a new gate
-                assert(int_vector_count(relevant_gate_inputs) == 1);
-                lit_t gate_input = int_vector_get(relevant_gate_inputs, 0);
-                remove_input_from_gate(gate, gate_input);
-                scope_node->sub = gate_input;
-                circuit_add_to_gate(circuit, gate, create_lit(scope_node->shared.id, false));
-            }
-            
-            // fix assumptions
-            assert(scope_node->shared.num_occ == 0);
-            scope_node->shared.num_occ = 1;
-            scope_node->shared.influences = bit_vector_init(0, circuit->max_num);
+        // connect scope_node to circuit
+        gate->inputs[i] = scope_node->shared.id;
+        scope_node->sub = replace_variables_in_subtree(circuit, replacement, scope_node->shared.id, false, gate_input);
+        scope_node->shared.num_occ = 1;
+        if (scope_node->sub != gate_input) {
             node_shared* sub_node = circuit->nodes[lit_to_var(scope_node->sub)];
-            bit_vector_update_or(scope_node->shared.influences, sub_node->influences);
-            
-            int_vector_free(relevant_gate_inputs);
+            sub_node->num_occ++;
+            node_shared* old_sub_node = circuit->nodes[lit_to_var(gate_input)];
+            old_sub_node->num_occ--;
         }
+        scope_node->sub = miniscoping_wrap_variable(circuit, gate->type, scope_node->sub);
         
-        // Remove all next pointer from scope *before* freeing
-        // The next pointer are created for the new scope nodes during reencoding
-        while (scope->num_next > 0) {
-            Scope* next = scope->next[0];
-            unlink_scope(scope, next);
+        map_free(replacement);
+    }
+    vector_free(influencing);
+    
+    assert(scope->num_next == 0);
+    
+    size_t num_vars = vector_count(scope->vars);
+    while (num_vars > 0) {
+        Var* var = vector_get(scope->vars, 0);
+        remove_var(circuit, var->shared.id);
+        num_vars--;
+    }
+    // remove no longer reachable nodes
+    for (size_t i = 1; i <= circuit->max_num; i++) {
+        node_shared* other_node = circuit->nodes[i];
+        if (other_node == NULL) {
+            continue;
         }
-        
-        if (scope != circuit->top_level) {
-            remove_scope(circuit, scope);
+        if (other_node->num_occ == 0 && other_node->id != lit_to_var(circuit->output)) {
+            remove_gates_recursive(circuit, other_node->id);
         }
+    }
+}
+
+/**
+ * Splits the variables of the scope into groups that are connected through
+ * the inputs of the gate. Every group gets its own scope node whose subtree
+ * consists of the gate inputs that depend on the group.
+ */
+static void miniscoping_partition(miniscoping* ms, Gate* gate) {
+    Circuit* circuit = ms->circuit;
+    Scope* scope = ms->scope;
+    
+    // groups are identified by the representative of their variables,
+    // group[representative] is 1 + the index of the group
+    size_t* group = calloc(ms->size, sizeof(size_t));
+    vector* group_nodes = vector_init();
+    for (size_t i = 0; i < vector_count(scope->vars); i++) {
+        Var* var = vector_get(scope->vars, i);
+        const var_t representative = union_find_root(ms->parent, var->shared.id);
+        if (group[representative] == 0) {
+            ScopeNode* scope_node = circuit_new_scope_node(circuit, scope->qtype, circuit->max_num + 1);
+            vector_add(group_nodes, scope_node);
+            group[representative] = vector_count(group_nodes);
+        }
+        ScopeNode* scope_node = vector_get(group_nodes, group[representative] - 1);
+        vector_add(scope_node->scope->vars, var);
+        var->scope = scope_node->scope;
+    }
+    vector_reset(scope->vars);
+    
+    logging_info("detected %zu groups\n", vector_count(group_nodes));
+    
+    // distribute gate inputs to groups, inputs that do not depend on any
+    // group remain in the gate
+    int_vector** group_inputs = calloc(vector_count(group_nodes), sizeof(int_vector*));
+    size_t num_remaining = 0;
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        const lit_t gate_input = gate->inputs[i];
+        const var_t input_var = lit_to_var(gate_input);
+        const size_t input_group = ms->relevant[input_var] ? group[union_find_root(ms->parent, input_var)] : 0;
+        if (input_group == 0) {
+            gate->inputs[num_remaining++] = gate_input;
+            continue;
+        }
+        if (group_inputs[input_group - 1] == NULL) {
+            group_inputs[input_group - 1] = int_vector_init();
+        }
+        int_vector_add(group_inputs[input_group - 1], gate_input);
+    }
+    gate->num_inputs = num_remaining;
+    
+    // connect newly created scope_nodes to circuit
+    for (size_t i = 0; i < vector_count(group_nodes); i++) {
+        ScopeNode* scope_node = vector_get(group_nodes, i);
+        int_vector* inputs = group_inputs[i];
+        assert(inputs != NULL && int_vector_count(inputs) > 0);
+        if (int_vector_count(inputs) > 1) {
+            // have to create a new gate containing with the gate_inputs
+            Gate* new_gate = circuit_add_gate(circuit, circuit->max_num + 1, gate->type);
+            new_gate->shared.num_occ = 1;
+            for (size_t j = 0; j < int_vector_count(inputs); j++) {
+                circuit_add_to_gate(circuit, new_gate, int_vector_get(inputs, j));
+            }
+            scope_node->sub = create_lit(new_gate->shared.id, false);
+        } else {
+            // we do not have to create a new gate
+            scope_node->sub = miniscoping_wrap_variable(circuit, gate->type, int_vector_get(inputs, 0));
+        }
+        circuit_add_to_gate(circuit, gate, create_lit(scope_node->shared.id, false));
         
-        int_vector_free(original_gate_inputs);
-        
-        //circuit_print_qcir(circuit);
+        // fix assumptions
+        assert(scope_node->shared.num_occ == 0);
+        scope_node->shared.num_occ = 1;
         
-        //debug printouts
-        /*logging_info("Detected %zu independent variable groups.\n", num_groups);
-         if (LOGGING_DEBUG) {
-         for (size_t i = 0; i < vector_count(scope->groups); i++) {
-         logging_debug("group %zu: ", i);
-         int_vector* group = vector_get(scope->groups, i);
-         assert(int_vector_is_sorted(group));
-         for (size_t j = 0; j < int_vector_count(group); j++) {
-         int var_id = int_vector_get(group, j);
-         logging_debug("%d ", var_id);
-         }
-         logging_debug("\n");
-         }
-         }*/
-    }
-}
-
-static void unprenex_by_miniscoping_recursive(Circuit*, Scope*, var_t*);
-static void unprenex_by_miniscoping_recursive(Circuit* circuit, Scope* scope, var_t* partitions) {
+        int_vector_free(inputs);
+    }
+    free(group_inputs);
+    vector_free(group_nodes);
+    free(group);
+    
+    // Remove all next pointer from scope *before* freeing
+    // The next pointer are created for the new scope nodes during reencoding
+    while (scope->num_next > 0) {
+        Scope* next = scope->next[0];
+        unlink_scope(scope, next);
+    }
+    
+    if (scope != circuit->top_level) {
+        remove_scope(circuit, scope);
+    }
+}
+
+static void apply_miniscoping(Circuit* circuit, Scope* scope, var_t node) {
+    if (circuit->types[node] != NODE_GATE) {
+        return;
+    }
+    
+    Gate* gate = circuit->nodes[node];
+    
+    if (gate->shared.num_occ > 1) {
+        // Do not split if gate is shared
+        return;
+    }
+    
+    miniscoping ms;
+    miniscoping_init(&ms, circuit, scope);
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        miniscoping_merge_subtree(&ms, lit_to_var(gate->inputs[i]));
+    }
+    
+    if ((gate->type == GATE_AND && scope->qtype == QUANT_FORALL) || (gate->type == GATE_OR && scope->qtype == QUANT_EXISTS)) {
+        miniscoping_distribute(&ms, gate);
+    } else {
+        miniscoping_partition(&ms, gate);
+    }
+    
+    miniscoping_free(&ms);
+}
+
+static void unprenex_by_miniscoping_recursive(Circuit*, Scope*);
+static void unprenex_by_miniscoping_recursive(Circuit* circuit, Scope* scope) {
+    // the recursive calls may split scopes, adding them to the end of
+    // scope->next, and remove the processed scope from scope->next, thus,
+    // we iterate over a copy of the original next scopes
     const size_t num_next = scope->num_next;
-    // store original number of next scopes since in the recursive call,
-    // scopes may be splitted and added to the end of scope->next, and we
-    // do not need to recurse into these nodes
-    // Note: In order for this to work, scopes must not be deleted
+    Scope** next = malloc(num_next * sizeof(Scope*));
     for (size_t i = 0; i < num_next; i++) {
-        unprenex_by_miniscoping_recursive(circuit, scope->next[i], partitions);
+        next[i] = scope->next[i];
     }
+    for (size_t i = 0; i < num_next; i++) {
+        unprenex_by_miniscoping_recursive(circuit, next[i]);
+    }
+    free(next);
     
     if (scope == circuit->top_level && vector_count(scope->vars) == 0) {
         return;
@@ -1963,9 +2487,9 @@ static void unprenex_by_miniscoping_recursive(Circuit* circuit, Scope* scope, va
     
     if (scope->node) {
         ScopeNode* node = circuit->nodes[scope->node];
-        apply_miniscoping(circuit, scope, lit_to_var(node->sub), partitions);
+        apply_miniscoping(circuit, scope, lit_to_var(node->sub));
     } else {
-        apply_miniscoping(circuit, scope, lit_to_var(circuit->output), partitions);
+        apply_miniscoping(circuit, scope, lit_to_var(circuit->output));
     }
 }
 
@@ -1974,186 +2498,677 @@ static void unprenex_by_miniscoping_recursive(Circuit* circuit, Scope* scope, va
  * Converts the circuit into non-prenex form by applying mini-scoping rules.
  *
  * Implementation: Descend to leaf scopes, apply mini-scoping rules to them,
- * i.e., they may be split, then traverse the quantifier tree upwards.
+ * i.e., they may be split, then traverse the quantifier tree upwards. The
+ * variables of a scope are partitioned by a union-find pass over the subtree
+ * of the gate below the scope.
+ *
+ * Circuits that are already in non-prenex form are left unchanged.
  */
 void circuit_unprenex_by_miniscoping(Circuit* circuit) {
-    var_t* partitions = malloc(circuit->num_vars * sizeof(var_t));
-    for (size_t i = 0; i < circuit->num_vars; i++) {
-        partitions[i] = i;
-    }
-    //circuit_compute_variable_influence(circuit);
-    unprenex_by_miniscoping_recursive(circuit, circuit->top_level, partitions);
-    free(partitions);
-    //circuit_print_qcir(circuit);
-    //circuit_check_occurrences(circuit);
+    if (!circuit_is_prenex(circuit)) {
+        return;
+    }
+    unprenex_by_miniscoping_recursive(circuit, circuit->top_level);
     circuit_reencode(circuit);
 }
 
-void circuit_compute_scope_influence(Circuit* circuit) {
+
+// Universal expansion
+
+#define EXPANSION_TRUE  INT32_MAX
+#define EXPANSION_FALSE (-INT32_MAX)
+#define EXPANSION_MAX_VARS 16
+#define EXPANSION_MAX_GROWTH 2  // expansion may add at most twice the circuit size in new nodes
+
+/**
+ * State of the expansion of the innermost universal quantifier block.
+ *
+ * Nodes that depend on the universal block or on the existential block
+ * following it are copied once for every assignment of the universal block,
+ * all other nodes are shared between the copies. image[i] is the literal
+ * representing node i in the current copy, or one of the constants
+ * EXPANSION_TRUE/EXPANSION_FALSE.
+ */
+typedef struct {
+    Circuit* circuit;
+    Scope* universal;
+    Scope* existential;  // innermost existential block, may be NULL
+    size_t num_existentials;  // copies are appended to existential->vars
+    var_t max_num;       // maximal node before expansion
+    bool* depends;
+    lit_t* image;
+    lit_t* inputs;       // buffer for the inputs of the gate copy
+    var_t* table;        // structural hashing of the new gates, open addressing
+    size_t table_size;
+    size_t table_count;
+    size_t num_new_nodes;
+    size_t budget;
+} expansion;
+
+static lit_t expansion_get_image(const expansion* exp, lit_t lit) {
+    const var_t var = lit_to_var(lit);
+    if (var > exp->max_num || !exp->depends[var]) {
+        return lit;
+    }
+    const lit_t image = exp->image[var];
+    assert(image != 0);
+    return lit < 0 ? -image : image;
+}
+
+static int compare_lits_by_var(const void* lhs, const void* rhs) {
+    const lit_t a = *(const lit_t*)lhs;
+    const lit_t b = *(const lit_t*)rhs;
+    const var_t var_a = lit_to_var(a);
+    const var_t var_b = lit_to_var(b);
+    if (var_a != var_b) {
+        return var_a < var_b ? -1 : 1;
+    }
+    return (a > b) - (a < b);
+}
+
+static size_t expansion_hash(gate_type type, const lit_t* inputs, size_t num_inputs) {
+    uint32_t hash = 2166136261u ^ (uint32_t)type;
+    for (size_t i = 0; i < num_inputs; i++) {
+        hash = (hash ^ (uint32_t)inputs[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool gate_has_inputs(const Gate* gate, gate_type type, const lit_t* inputs, size_t num_inputs) {
+    return gate->type == type
+        && gate->num_inputs == num_inputs
+        && memcmp(gate->inputs, inputs, num_inputs * sizeof(lit_t)) == 0;
+}
+
+/**
+ * Returns the slot of the new gate with the given inputs, or the empty slot
+ * where it would be inserted.
+ */
+static size_t expansion_find_slot(const expansion* exp, gate_type type, const lit_t* inputs, size_t num_inputs) {
+    const size_t mask = exp->table_size - 1;
+    size_t slot = expansion_hash(type, inputs, num_inputs) & mask;
+    while (exp->table[slot] != 0 && !gate_has_inputs(exp->circuit->nodes[exp->table[slot]], type, inputs, num_inputs)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void expansion_insert(expansion* exp, Gate* gate) {
+    if (4 * (exp->table_count + 1) > 3 * exp->table_size) {
+        var_t* old_table = exp->table;
+        const size_t old_size = exp->table_size;
+        exp->table_size *= 2;
+        exp->table = calloc(exp->table_size, sizeof(var_t));
+        for (size_t i = 0; i < old_size; i++) {
+            if (old_table[i] != 0) {
+                Gate* other = exp->circuit->nodes[old_table[i]];
+                exp->table[expansion_find_slot(exp, other->type, other->inputs, other->num_inputs)] = old_table[i];
+            }
+        }
+        free(old_table);
+    }
+    const size_t slot = expansion_find_slot(exp, gate->type, gate->inputs, gate->num_inputs);
+    assert(exp->table[slot] == 0);
+    exp->table[slot] = gate->shared.id;
+    exp->table_count++;
+}
+
+/**
+ * Returns the image of gate in the current copy, 0 if the budget is exceeded.
+ *
+ * Constant inputs are propagated, the remaining inputs are sorted such that
+ * structurally equal gates are only created once.
+ */
+static lit_t expansion_copy_gate(expansion* exp, Gate* gate) {
+    Circuit* circuit = exp->circuit;
+    const lit_t absorbing = gate->type == GATE_AND ? EXPANSION_FALSE : EXPANSION_TRUE;
+    
+    size_t num_inputs = 0;
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        const lit_t input = expansion_get_image(exp, gate->inputs[i]);
+        if (input == absorbing) {
+            return absorbing;
+        } else if (input == -absorbing) {
+            continue;
+        }
+        exp->inputs[num_inputs++] = input;
+    }
+    
+    qsort(exp->inputs, num_inputs, sizeof(lit_t), compare_lits_by_var);
+    size_t num_unique = 0;
+    for (size_t i = 0; i < num_inputs; i++) {
+        const lit_t input = exp->inputs[i];
+        if (num_unique > 0 && exp->inputs[num_unique - 1] == input) {
+            continue;
+        }
+        if (num_unique > 0 && exp->inputs[num_unique - 1] == -input) {
+            // contains lit and -lit
+            return absorbing;
+        }
+        exp->inputs[num_unique++] = input;
+    }
+    
+    if (num_unique == 0) {
+        return -absorbing;
+    } else if (num_unique == 1) {
+        return exp->inputs[0];
+    }
+    
+    const size_t slot = expansion_find_slot(exp, gate->type, exp->inputs, num_unique);
+    if (exp->table[slot] != 0) {
+        return create_lit(exp->table[slot], false);
+    }
+    
+    if (exp->num_new_nodes >= exp->budget) {
+        return 0;
+    }
+    exp->num_new_nodes++;
+    
+    Gate* copy = circuit_add_gate(circuit, circuit->max_num + 1, gate->type);
+    copy->shared.orig_id = gate->shared.orig_id;
+    for (size_t i = 0; i < num_unique; i++) {
+        circuit_add_to_gate(circuit, copy, exp->inputs[i]);
+        node_shared* input = circuit->nodes[lit_to_var(exp->inputs[i])];
+        input->num_occ++;
+    }
+    expansion_insert(exp, copy);
+    return create_lit(copy->shared.id, false);
+}
+
+/**
+ * Computes the images of all dependent nodes for the given assignment of the
+ * universal block, returns false if the budget is exceeded.
+ */
+static bool expansion_copy(expansion* exp, size_t assignment) {
+    Circuit* circuit = exp->circuit;
+    
+    for (size_t i = 0; i < vector_count(exp->universal->vars); i++) {
+        Var* var = vector_get(exp->universal->vars, i);
+        exp->image[var->shared.id] = (assignment >> i) & 1 ? EXPANSION_TRUE : EXPANSION_FALSE;
+    }
+    if (exp->num_new_nodes + exp->num_existentials > exp->budget) {
+        return false;
+    }
+    exp->num_new_nodes += exp->num_existentials;
+    for (size_t i = 0; i < exp->num_existentials; i++) {
+        Var* var = vector_get(exp->existential->vars, i);
+        Var* copy = copy_variable(circuit, var, exp->existential);
+        exp->image[var->shared.id] = create_lit(copy->shared.id, false);
+    }
+    
+    // nodes are topologically ordered, thus, the images of the inputs of a
+    // gate are computed before the gate itself
+    for (var_t i = 1; i <= exp->max_num; i++) {
+        if (!exp->depends[i] || circuit->types[i] != NODE_GATE) {
+            continue;
+        }
+        const lit_t image = expansion_copy_gate(exp, circuit->nodes[i]);
+        if (image == 0) {
+            return false;
+        }
+        exp->image[i] = image;
+    }
+    return true;
+}
+
+/**
+ * Removes all nodes that are not reachable from the output, such that
+ * circuit_reencode does not have to change the quantifier prefix.
+ */
+static void expansion_remove_unreachable(Circuit* circuit) {
+    bool* reachable = calloc(circuit->max_num + 1, sizeof(bool));
+    reachable[lit_to_var(circuit->output)] = true;
+    
+    // new nodes have larger ids than their inputs, hence, the ids are still
+    // topologically ordered and parents are removed before their inputs
+    for (var_t i = (var_t)circuit->max_num; i > 0; i--) {
+        if (circuit->types[i] == 0) {
+            continue;
+        }
+        if (!reachable[i]) {
+            if (circuit->types[i] == NODE_VAR) {
+                remove_var(circuit, i);
+            } else {
+                assert(circuit->types[i] == NODE_GATE);
+                remove_gate(circuit, i);
+            }
+            continue;
+        }
+        if (circuit->types[i] == NODE_GATE) {
+            Gate* gate = circuit->nodes[i];
+            for (size_t j = 0; j < gate->num_inputs; j++) {
+                reachable[lit_to_var(gate->inputs[j])] = true;
+            }
+        }
+    }
+    free(reachable);
+}
+
+/**
+ * Eliminates the innermost universal quantifier block by expansion if it
+ * contains at most max_vars variables, i.e., ∀U ∃E. φ is replaced by the
+ * conjunction of φ[U ↦ a, E ↦ E_a] over all assignments a of U where E_a are
+ * fresh copies of E. The copies E_a are quantified in the existential block
+ * that precedes U.
+ *
+ * Returns true if the circuit was expanded. The expansion is abandoned if the
+ * copies would grow the circuit by more than a constant factor. Requires a
+ * prenex circuit and reencodes it afterwards.
+ */
+bool circuit_expand_universal(Circuit* circuit, size_t max_vars) {
     api_expect(circuit->phase == ENCODED, "circuit must be encoded\n");
-    const size_t max_depth = circuit->max_depth;
+    if (!circuit_is_prenex(circuit)) {
+        return false;
+    }
     
-    // Compute which scope influences which gate
-    for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_shared* node = circuit->nodes[i];
-        assert(node != NULL);
-        bit_vector_free(node->influences);
-        node->influences = bit_vector_init(0, max_depth);
-        
-        const node_type type = circuit->types[i];
-        
-        if (type == NODE_VAR) {
+    Scope* universal = NULL;
+    for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
+        if (scope->qtype == QUANT_FORALL) {
+            universal = scope;
+        }
+    }
+    if (universal == NULL) {
+        return false;
+    }
+    const size_t num_universals = vector_count(universal->vars);
+    if (num_universals == 0 || num_universals > max_vars || num_universals > EXPANSION_MAX_VARS) {
+        return false;
+    }
+    
+    expansion exp;
+    exp.circuit = circuit;
+    exp.universal = universal;
+    exp.existential = circuit_next_scope_in_prefix(universal);
+    exp.num_existentials = exp.existential != NULL ? vector_count(exp.existential->vars) : 0;
+    exp.max_num = (var_t)circuit->max_num;
+    exp.depends = calloc(circuit->max_num + 1, sizeof(bool));
+    exp.image = calloc(circuit->max_num + 1, sizeof(lit_t));
+    exp.table_size = 16;
+    exp.table_count = 0;
+    exp.table = calloc(exp.table_size, sizeof(var_t));
+    exp.num_new_nodes = 0;
+    exp.budget = EXPANSION_MAX_GROWTH * circuit->max_num;
+    
+    size_t max_inputs = 0;
+    for (var_t i = 1; i <= exp.max_num; i++) {
+        if (circuit->types[i] == NODE_VAR) {
             Var* var = circuit->nodes[i];
-            assert(var->scope->depth < max_depth);
-            bit_vector_add(node->influences, var->scope->depth);
-        } else if (type == NODE_GATE) {
+            exp.depends[i] = var->scope == universal || var->scope == exp.existential;
+        } else if (circuit->types[i] == NODE_GATE) {
             Gate* gate = circuit->nodes[i];
             for (size_t j = 0; j < gate->num_inputs; j++) {
-                const var_t var = lit_to_var(gate->inputs[j]);
-                node_shared* occ_node = circuit->nodes[var];
-                assert(occ_node->influences != NULL);
-                bit_vector_update_or(node->influences, occ_node->influences);
-                
-                if (circuit->types[var] == NODE_SCOPE) {
-                    // Do not propagate scope over scope_node
-                    //ScopeNode* scope_node = circuit->nodes[var];
-                    //bit_vector_remove(node->influences, scope_node->scope->depth);
-                }
+                exp.depends[i] |= exp.depends[lit_to_var(gate->inputs[j])];
             }
-        } else {
-            assert(type == NODE_SCOPE);
-            ScopeNode* scope_node = circuit->nodes[i];
-            const var_t var = lit_to_var(scope_node->sub);
-            node_shared* occ_node = circuit->nodes[var];
-            assert(occ_node->influences != NULL);
-            bit_vector_update_or(node->influences, occ_node->influences);
-            
-            if (circuit->types[var] == NODE_SCOPE) {
-                // Do not propagate scope over scope_node
-                //ScopeNode* other_scope_node = circuit->nodes[var];
-                //bit_vector_remove(node->influences, other_scope_node->scope->depth);
-            }
-            // Special case: scope node is directly below top level scope
-            assert(scope_node->scope->prev != NULL);
-            if (scope_node->scope->prev == circuit->top_level) {
-                bit_vector_add(node->influences, circuit->top_level->depth);
+            if (gate->num_inputs > max_inputs) {
+                max_inputs = gate->num_inputs;
             }
         }
+    }
+    exp.inputs = malloc((max_inputs + 1) * sizeof(lit_t));
+    
+    const size_t num_assignments = (size_t)1 << num_universals;
+    lit_t* roots = malloc(num_assignments * sizeof(lit_t));
+    bool expanded = true;
+    for (size_t assignment = 0; assignment < num_assignments; assignment++) {
+        if (!expansion_copy(&exp, assignment)) {
+            expanded = false;
+            break;
+        }
+        roots[assignment] = expansion_get_image(&exp, circuit->output);
+        if (roots[assignment] == EXPANSION_FALSE) {
+            // the formula is false, no need to compute remaining copies
+            break;
+        }
+    }
+    
+    if (expanded) {
+        logging_info("Expand universal block of size %zu, %zu new nodes\n", num_universals, exp.num_new_nodes);
         
-        if (bit_vector_min(node->influences) == BIT_VECTOR_NO_ENTRY) {
-            bit_vector_add(node->influences, circuit->top_level->depth);
+        // conjunction of the copies, an empty OR gate represents false
+        bool is_false = false;
+        Gate* output = circuit_add_gate(circuit, circuit->max_num + 1, GATE_AND);
+        for (size_t assignment = 0; assignment < num_assignments && !is_false; assignment++) {
+            const lit_t root = roots[assignment];
+            if (root == EXPANSION_FALSE) {
+                is_false = true;
+            } else if (root != EXPANSION_TRUE && circuit_add_to_gate(circuit, output, root)) {
+                node_shared* root_node = circuit->nodes[lit_to_var(root)];
+                root_node->num_occ++;
+            }
         }
+        if (is_false) {
+            for (size_t i = 0; i < output->num_inputs; i++) {
+                node_shared* root_node = circuit->nodes[lit_to_var(output->inputs[i])];
+                root_node->num_occ--;
+            }
+            output->num_inputs = 0;
+            output->type = GATE_OR;
+        }
+        circuit->output = create_lit(output->shared.id, false);
+    } else {
+        logging_info("Expansion of universal block of size %zu exceeds budget\n", num_universals);
     }
+    
+    free(roots);
+    free(exp.inputs);
+    free(exp.table);
+    free(exp.image);
+    free(exp.depends);
+    
+    expansion_remove_unreachable(circuit);
+    detect_empty_scopes_recursively(circuit, circuit->top_level);
+    circuit_reencode(circuit);
+    return expanded;
 }
 
-static void compute_relevant_scopes_recursively(Circuit* circuit, bit_vector* relevant, lit_t node_lit) {
-    const var_t node_var = lit_to_var(node_lit);
-    const node_type type = circuit->types[node_var];
-    const node_shared* node = circuit->nodes[node_var];
-    
-    if (bit_vector_equal(node->relevant_for, relevant)) {
-        // only propagate new information
-        return;
+// Dependency analysis
+
+/**
+ * Computes for every existential variable 1 + the position of the innermost
+ * universal scope in prefix it depends on with respect to the standard
+ * dependency scheme, and 0 if it does not depend on any universal variable.
+ *
+ * The output is viewed as a conjunction of conjuncts, i.e., the inputs of the
+ * AND gates reachable from the output through AND gates only, and conjuncts
+ * take the role of clauses: an existential variable e depends on a universal
+ * scope U before e if e and a variable of U are connected through conjuncts
+ * sharing existential variables after U. Within a conjunct, only gates whose
+ * subtree contains such a variable or a variable of U are merged.
+ */
+static void compute_standard_dependencies(Circuit* circuit, Scope** prefix, size_t prefix_length, var_t* innermost_dependency) {
+    const var_t max_num = (var_t)circuit->max_num;
+    bool* conjunction = calloc(max_num + 1, sizeof(bool));
+    bool* in_conjunct = calloc(max_num + 1, sizeof(bool));
+    bool* relevant = malloc((max_num + 1) * sizeof(bool));
+    bool* connected = malloc((max_num + 1) * sizeof(bool));
+    var_t* parent = malloc((max_num + 1) * sizeof(var_t));
+    
+    const var_t output = lit_to_var(circuit->output);
+    if (circuit->types[output] == NODE_GATE && circuit->output > 0 && ((Gate*)circuit->nodes[output])->type == GATE_AND) {
+        conjunction[output] = true;
+    } else {
+        in_conjunct[output] = true;
+    }
+    for (var_t i = max_num; i > 0; i--) {
+        if (circuit->types[i] != NODE_GATE) {
+            continue;
+        }
+        Gate* gate = circuit->nodes[i];
+        for (size_t j = 0; j < gate->num_inputs; j++) {
+            const lit_t input = gate->inputs[j];
+            const var_t input_var = lit_to_var(input);
+            if (in_conjunct[i]) {
+                in_conjunct[input_var] = true;
+            }
+            if (!conjunction[i]) {
+                continue;
+            }
+            if (circuit->types[input_var] == NODE_GATE && input > 0 && ((Gate*)circuit->nodes[input_var])->type == GATE_AND) {
+                conjunction[input_var] = true;
+            } else {
+                in_conjunct[input_var] = true;
+            }
+        }
     }
     
-    bit_vector_update_or(node->relevant_for, relevant);
-    
-    if (type == NODE_SCOPE) {
-        ScopeNode* scope_node = (ScopeNode*)node;
-        bit_vector_add(relevant, scope_node->scope->scope_id);
-        bit_vector_add(node->relevant_for, scope_node->scope->scope_id);
-        compute_relevant_scopes_recursively(circuit, relevant, scope_node->sub);
-        bit_vector_remove(relevant, scope_node->scope->scope_id);
-    } else if (type == NODE_GATE) {
-        Gate* gate = (Gate*)node;
-        for (size_t i = 0; i < gate->num_inputs; i++) {
-            compute_relevant_scopes_recursively(circuit, relevant, gate->inputs[i]);
+    for (size_t k = 0; k < prefix_length; k++) {
+        const Scope* universal = prefix[k];
+        if (universal->qtype != QUANT_FORALL) {
+            continue;
+        }
+        
+        for (var_t i = 1; i <= max_num; i++) {
+            parent[i] = i;
+            connected[i] = false;
+            if (circuit->types[i] == NODE_VAR) {
+                const Var* var = circuit->nodes[i];
+                relevant[i] = var->scope == universal || (var->scope->depth > universal->depth && var->scope->qtype == QUANT_EXISTS);
+            } else if (circuit->types[i] == NODE_GATE) {
+                const Gate* gate = circuit->nodes[i];
+                relevant[i] = false;
+                for (size_t j = 0; j < gate->num_inputs; j++) {
+                    const var_t input_var = lit_to_var(gate->inputs[j]);
+                    relevant[i] |= relevant[input_var];
+                    if (in_conjunct[i] && relevant[input_var]) {
+                        union_find_merge(parent, i, input_var);
+                    }
+                }
+            } else {
+                relevant[i] = false;
+            }
+        }
+        
+        for (size_t i = 0; i < vector_count(universal->vars); i++) {
+            const Var* var = vector_get(universal->vars, i);
+            connected[union_find_root(parent, var->shared.id)] = true;
+        }
+        for (size_t inner = k + 1; inner < prefix_length; inner++) {
+            const Scope* existential = prefix[inner];
+            if (existential->qtype != QUANT_EXISTS) {
+                continue;
+            }
+            for (size_t i = 0; i < vector_count(existential->vars); i++) {
+                const Var* var = vector_get(existential->vars, i);
+                if (connected[union_find_root(parent, var->shared.id)]) {
+                    innermost_dependency[var->shared.id] = (var_t)k + 1;
+                }
+            }
         }
     }
+    
+    free(parent);
+    free(connected);
+    free(relevant);
+    free(in_conjunct);
+    free(conjunction);
 }
 
-void circuit_compute_relevant_scopes(Circuit* circuit) {
-    bit_vector* relevant = bit_vector_init(0, circuit->max_scope_id);
+/**
+ * Moves every existential variable of a prenex circuit to the outermost
+ * existential scope that is compatible with the standard dependency scheme,
+ * i.e., the first existential scope behind the innermost universal scope it
+ * depends on. Scopes that become empty are removed and the circuit is
+ * reencoded afterwards.
+ *
+ * @see compute_standard_dependencies
+ */
+void circuit_relax_quantifier_prefix(Circuit* circuit) {
+    api_expect(circuit->phase == ENCODED, "circuit must be encoded\n");
+    if (!circuit_is_prenex(circuit)) {
+        return;
+    }
+    
+    size_t prefix_length = 0;
     for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
-        bit_vector_add(relevant, scope->scope_id);
+        prefix_length++;
+    }
+    Scope** prefix = malloc(prefix_length * sizeof(Scope*));
+    prefix_length = 0;
+    for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
+        prefix[prefix_length++] = scope;
     }
     
-    for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_shared* node = circuit->nodes[i];
-        bit_vector_free(node->relevant_for);
-        node->relevant_for = bit_vector_init(0, circuit->max_scope_id);
+    var_t* innermost_dependency = calloc(circuit->max_num + 1, sizeof(var_t));
+    compute_standard_dependencies(circuit, prefix, prefix_length, innermost_dependency);
+    
+    // target[k] is the first existential scope after position k - 1 in prefix
+    Scope** target = malloc(prefix_length * sizeof(Scope*));
+    target[0] = circuit->top_level;
+    for (size_t k = 1; k < prefix_length; k++) {
+        size_t first = k;
+        while (first < prefix_length && prefix[first]->qtype != QUANT_EXISTS) {
+            first++;
+        }
+        target[k] = first < prefix_length ? prefix[first] : NULL;
     }
     
-    compute_relevant_scopes_recursively(circuit, relevant, circuit->output);
-    bit_vector_free(relevant);
+    size_t num_moved = 0;
+    vector* moved = vector_init();
+    for (size_t k = 1; k < prefix_length; k++) {
+        Scope* existential = prefix[k];
+        if (existential->qtype != QUANT_EXISTS) {
+            continue;
+        }
+        vector_reset(moved);
+        for (size_t i = 0; i < vector_count(existential->vars); i++) {
+            Var* var = vector_get(existential->vars, i);
+            if (target[innermost_dependency[var->shared.id]] != existential) {
+                vector_add(moved, var);
+            }
+        }
+        for (size_t i = 0; i < vector_count(moved); i++) {
+            Var* var = vector_get(moved, i);
+            move_variable(var, existential, target[innermost_dependency[var->shared.id]]);
+        }
+        num_moved += vector_count(moved);
+    }
+    logging_info("Moved %zu existential variables to outer scopes\n", num_moved);
+    vector_free(moved);
+    free(target);
+    free(innermost_dependency);
+    free(prefix);
     
-    /*for (size_t i = 1; i <= circuit->max_num; i++) {
-        node_shared* node = circuit->nodes[i];
-        assert(node != NULL);
-        
+    detect_empty_scopes_recursively(circuit, circuit->top_level);
+    circuit_reencode(circuit);
+}
+
+void circuit_compute_scope_influence(Circuit* circuit) {
+    api_expect(circuit->phase == ENCODED, "circuit must be encoded\n");
+    const size_t max_depth = circuit->max_depth;
+    
+    scope_set_free(circuit->scope_influence);
+    scope_set* influence = circuit->scope_influence = scope_set_init(circuit->max_num + 1, max_depth);
+    for (size_t i = 1; i <= circuit->max_num; i++) {
+        assert(circuit->nodes[i] != NULL);
         const node_type type = circuit->types[i];
         
         if (type == NODE_VAR) {
-            continue;
+            Var* var = circuit->nodes[i];
+            assert(var->scope->depth < max_depth);
+            scope_set_insert(influence, i, var->scope->depth);
         } else if (type == NODE_GATE) {
             Gate* gate = circuit->nodes[i];
             for (size_t j = 0; j < gate->num_inputs; j++) {
                 const var_t var = lit_to_var(gate->inputs[j]);
-                if (circuit->types[var] == NODE_VAR) {
-                    continue;
-                }
-                node_shared* occ_node = circuit->nodes[var];
-                assert(occ_node->relevant_for != NULL);
-                bit_vector_update_or(node->relevant_for, occ_node->relevant_for);
+                assert(var < i);
+                scope_set_union(influence, i, var);
             }
         } else {
             assert(type == NODE_SCOPE);
             ScopeNode* scope_node = circuit->nodes[i];
             const var_t var = lit_to_var(scope_node->sub);
-            node_shared* occ_node = circuit->nodes[var];
-            assert(occ_node->relevant_for != NULL);
-            bit_vector_update_or(node->relevant_for, occ_node->relevant_for);
+            assert(var < i);
+            scope_set_union(influence, i, var);
             
             // Special case: scope node is directly below top level scope
             assert(scope_node->scope->prev != NULL);
             if (scope_node->scope->prev == circuit->top_level) {
-                bit_vector_add(node->relevant_for, circuit->top_level->scope_id);
+                scope_set_insert(influence, i, circuit->top_level->depth);
             }
         }
         
-        if (bit_vector_min(node->relevant_for) == BIT_VECTOR_NO_ENTRY) {
-            bit_vector_add(node->relevant_for, circuit->top_level->scope_id);
+        if (scope_set_is_empty(influence, i)) {
+            scope_set_insert(influence, i, circuit->top_level->depth);
         }
-    }*/
+    }
 }
 
-bool circuit_is_2qbf(Circuit* circuit) {
-    Scope* top_level = circuit->top_level;
-    if (vector_count(top_level->vars) != 0) {
-        return false;
-    }
+void circuit_compute_relevant_scopes(Circuit* circuit) {
+    api_expect(circuit->phase == ENCODED, "circuit must be encoded\n");
+    scope_set_free(circuit->relevant_scopes);
+    scope_set* relevant = circuit->relevant_scopes = scope_set_init(circuit->max_num + 1, circuit->max_scope_id + 1);
     
-    if (circuit->top_level->num_next == 0) {
-        return false;
+    const var_t output = lit_to_var(circuit->output);
+    for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
+        scope_set_insert(relevant, output, scope->scope_id);
     }
     
-    assert(false);
-    
-    return false;
-    /*Scope* universal = top_level->next;
-    if (universal == NULL) {
-        return false;
+    // A node is relevant for the union of the scopes of its parents (including
+    // the scope of a parent scope node). Parents have larger ids than their
+    // inputs, thus, one pass in reverse order propagates the sets to the leaves.
+    for (size_t i = circuit->max_num; i >= 1; i--) {
+        if (scope_set_is_empty(relevant, i)) {
+            // not reachable from output
+            continue;
+        }
+        const node_type type = circuit->types[i];
+        if (type == NODE_SCOPE) {
+            ScopeNode* scope_node = circuit->nodes[i];
+            scope_set_insert(relevant, i, scope_node->scope->scope_id);
+            scope_set_union(relevant, lit_to_var(scope_node->sub), i);
+        } else if (type == NODE_GATE) {
+            Gate* gate = circuit->nodes[i];
+            for (size_t j = 0; j < gate->num_inputs; j++) {
+                scope_set_union(relevant, lit_to_var(gate->inputs[j]), i);
+            }
+        }
     }
-    assert(universal->qtype == QUANT_FORALL);
-    
-    Scope* existential = universal->next;
-    if (existential == NULL) {
+}
+
+bool circuit_is_2qbf(Circuit* circuit) {
+    if (!circuit_is_prenex(circuit)) {
         return false;
     }
-    assert(existential->qtype == QUANT_EXISTS);
-    assert(vector_count(existential->vars) > 0);
-    
-    return existential->next == NULL;*/
+    size_t num_alternations = 0;
+    const Scope* previous = NULL;
+    for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
+        if (vector_count(scope->vars) == 0) {
+            continue;
+        }
+        // free variables belong to the existential top level
+        if (previous != NULL && (previous->qtype == QUANT_FORALL) != (scope->qtype == QUANT_FORALL)) {
+            num_alternations++;
+        }
+        previous = scope;
+    }
+    return num_alternations <= 1;
+}
+
+
+static uint64_t fingerprint_add(uint64_t hash, uint64_t value) {
+    // FNV-1a over the bytes of value
+    for (size_t i = 0; i < sizeof(value); i++) {
+        hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t fingerprint_scope(uint64_t hash, const Scope* scope) {
+    hash = fingerprint_add(hash, scope->scope_id);
+    hash = fingerprint_add(hash, (uint64_t)scope->qtype);
+    hash = fingerprint_add(hash, scope->node);
+    hash = fingerprint_add(hash, vector_count(scope->vars));
+    for (size_t i = 0; i < vector_count(scope->vars); i++) {
+        const Var* var = vector_get(scope->vars, i);
+        hash = fingerprint_add(hash, var->shared.id);
+    }
+    hash = fingerprint_add(hash, scope->num_next);
+    for (size_t i = 0; i < scope->num_next; i++) {
+        hash = fingerprint_scope(hash, scope->next[i]);
+    }
+    return hash;
+}
+
+uint64_t circuit_fingerprint(Circuit* circuit) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = fingerprint_add(hash, circuit->max_num);
+    hash = fingerprint_add(hash, (uint64_t)circuit->output);
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        hash = fingerprint_add(hash, (uint64_t)circuit->types[i]);
+        if (circuit->types[i] == NODE_GATE) {
+            const Gate* gate = circuit->nodes[i];
+            hash = fingerprint_add(hash, (uint64_t)gate->type);
+            hash = fingerprint_add(hash, gate->num_inputs);
+            for (size_t j = 0; j < gate->num_inputs; j++) {
+                hash = fingerprint_add(hash, (uint64_t)gate->inputs[j]);
+            }
+        } else if (circuit->types[i] == NODE_SCOPE) {
+            const ScopeNode* node = circuit->nodes[i];
+            hash = fingerprint_add(hash, node->scope->scope_id);
+            hash = fingerprint_add(hash, (uint64_t)node->sub);
+        }
+    }
+    return fingerprint_scope(hash, circuit->top_level);
 }
 
 
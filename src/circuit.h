@@ -16,6 +16,7 @@
 
 #include "vector.h"
 #include "bit_vector.h"
+#include "scope_set.h"
 
 typedef int32_t lit_t;
 typedef uint32_t var_t;
@@ -74,10 +75,6 @@ struct node_shared {
     size_t num_occ;
     
     int value;        // (< 0, 0, > 0) = (false, undefined, true)
-    
-    bit_vector* influences;
-    bit_vector* relevant_for;  // whether node is in scope of quantifier
-    bool dfs_processed;
 };
 
 
@@ -90,6 +87,7 @@ struct var {
     var_t var_id;
     Scope* scope;
     bool removed;
+    bool frozen;      // value must not be fixed by preprocessing, e.g., because it is assumed later
     polarity_type polarity;
     quantifier_type orig_quant;
 };
@@ -146,6 +144,8 @@ struct circuit {
     lit_t output;
     vector* vars;
     circuit_phases phase;
+    bool extensible;     // reencoding keeps all nodes such that the circuit can be extended, see circuit_extend
+    var_t t_lit_offset;  // t-literal of node n in the abstraction is n + t_lit_offset, at least max_num
     
     // Scopes
     var_t current_scope_id;
@@ -155,6 +155,10 @@ struct circuit {
     Scope* previous_scope;
     Scope* top_level;
     
+    // Indexed by node id, see circuit_compute_scope_influence and circuit_compute_relevant_scopes
+    scope_set* scope_influence;  // depths of scopes influencing a node
+    scope_set* relevant_scopes;  // ids of scopes a node is in scope of (non-prenex only)
+    
     // Propagation
     propagation* queue;
 };
@@ -217,6 +221,16 @@ bool circuit_add_to_gate(Circuit*, Gate*, lit_t);
 // Sanitize
 void circuit_reencode(Circuit*);
 
+/**
+ * Appends the variables and gates of delta to an encoded, extensible circuit
+ * and makes the output of delta the new output. The i-th quantifier block of
+ * delta (the first one being the existential top level) extends the i-th block
+ * of the circuit. Gates of delta may use every node of the circuit, nodes are
+ * identified by their original ids. Existing nodes keep their ids, the new ones
+ * get the ids following the old max_num. Delta is not modified.
+ */
+void circuit_extend(Circuit*, Circuit* delta);
+
 // Propagation
 void circuit_set_value(Circuit*, var_t node, int value);
 int circuit_get_value(Circuit*, var_t node);
@@ -239,6 +253,8 @@ void circuit_normalize_quantifier(Circuit*);
 void circuit_to_prenex(Circuit*);
 void circuit_unprenex_by_miniscoping(Circuit*);
 void circuit_flatten_gates(Circuit*);
+bool circuit_expand_universal(Circuit*, size_t max_vars);
+void circuit_relax_quantifier_prefix(Circuit*);
 
 // Analysis
 //void circuit_compute_variable_influence(Circuit*);
@@ -246,6 +262,12 @@ void circuit_compute_scope_influence(Circuit*);
 void circuit_compute_relevant_scopes(Circuit*);
 bool circuit_is_prenex(Circuit*);
 
+// Prenex with at most one quantifier alternation, empty blocks are ignored
+bool circuit_is_2qbf(Circuit*);
+
+// Hash of the structure of the circuit, i.e., nodes, quantifier tree, and output but not values
+uint64_t circuit_fingerprint(Circuit*);
+
 
 // Iterators
 Scope* circuit_next_scope_in_prefix(Scope*);
@@ -7,6 +7,10 @@
 //
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 
 #include "circuit_abstraction.h"
 #include "solver.h"
@@ -23,7 +27,7 @@ var_t node_to_t_lit(const Circuit* circuit, const node_shared* node) {
 }
 
 var_t var_id_to_t_lit(const Circuit* circuit, var_t var_id) {
-    return var_id + circuit->max_num;
+    return var_id + circuit->t_lit_offset;
 }
 
 var_t node_to_b_lit(const Circuit* circuit, const node_shared* node) {
@@ -43,8 +47,8 @@ var_t t_lit_to_b_lit(const Circuit* circuit, var_t t_lit) {
 }
 
 var_t t_lit_to_var_id(const Circuit* circuit, var_t t_lit) {
-    assert(t_lit > circuit->max_num);
-    return t_lit - circuit->max_num;
+    assert(t_lit > circuit->t_lit_offset);
+    return t_lit - circuit->t_lit_offset;
 }
 
 var_t b_lit_to_var_id(const Circuit* circuit, var_t b_lit) {
@@ -62,13 +66,13 @@ static bool node_is_relevant(CircuitAbstraction* abs, var_t node_var) {
         // every node is relevant for quantifier prefix
         return true;
     }
-    const node_shared* node = abs->scope->circuit->nodes[node_var];
-    if (bit_vector_contains(node->relevant_for, abs->scope->scope_id)) {
+    const scope_set* relevant = abs->scope->circuit->relevant_scopes;
+    if (scope_set_contains(relevant, node_var, abs->scope->scope_id)) {
         return true;
     }
     Scope* scope = abs->scope->prev;
     while (scope != NULL) {
-        if (bit_vector_max(node->relevant_for) == scope->scope_id) {
+        if (scope_set_max(relevant, node_var) == scope->scope_id) {
             return true;
         }
         scope = scope->prev;
@@ -80,7 +84,7 @@ static bool node_is_relevant(CircuitAbstraction* abs, var_t node_var) {
  * Projects the maximal scope in node to current scope
  */
 static var_t current_max(const node_shared* node, const Scope* scope) {
-    const var_t max = bit_vector_max(node->influences);
+    const var_t max = scope_set_max(scope->circuit->scope_influence, node->id);
     if (scope->max_depth != 0 && scope->max_depth < max) {
         return scope->max_depth;
     } else {
@@ -120,9 +124,9 @@ static void analyze_gate(CircuitAbstraction* abs, Scope* scope, bool negate, Gat
         }
         
         if (input_type == NODE_VAR) {
-            if (bit_vector_max(input_node->influences) < scope->depth) {
+            if (scope_set_max(scope->circuit->scope_influence, input_node->id) < scope->depth) {
                 variable_of_outer_scope = true;
-            } else if (bit_vector_contains(input_node->influences, scope->depth)) {
+            } else if (scope_set_contains(scope->circuit->scope_influence, input_node->id, scope->depth)) {
                 variable_of_current_scope = true;
             }
         } else if (input_type == NODE_GATE) {
@@ -164,7 +168,7 @@ static void analyze_gate(CircuitAbstraction* abs, Scope* scope, bool negate, Gat
         const bool combination_t_lit = input_max_scope_outer && !gate_max_scope_outer;
         
         if (variable_b_lit) {
-            assert(bit_vector_max(gate->shared.influences) > scope->depth);
+            assert(scope_set_max(scope->circuit->scope_influence, gate->shared.id) > scope->depth);
             assert(scope->num_next > 0);
             int_vector_add(abs->b_lits, b_lit);
         }
@@ -186,7 +190,7 @@ static void analyze_gate(CircuitAbstraction* abs, Scope* scope, bool negate, Gat
                     int_vector_add_sorted(abs->b_lits, other_b_lit);
                 }
             } else if (!variable_b_lit) {
-                assert(bit_vector_max(gate->shared.influences) > scope->depth);
+                assert(scope_set_max(scope->circuit->scope_influence, gate->shared.id) > scope->depth);
                 assert(scope->num_next > 0);
                 int_vector_add(abs->b_lits, b_lit);
             }
@@ -249,9 +253,9 @@ static void encode_or_gate(CircuitAbstraction* abs, Scope* scope, bool negate, G
         const node_shared* occ_node = circuit->nodes[input_var];
         const node_type type = circuit->types[input_var];
         
-        if (bit_vector_min(occ_node->influences) > scope->depth) {
+        if (scope_set_min(scope->circuit->scope_influence, occ_node->id) > scope->depth) {
             // FIXME: probably not needed since it implies
-            assert(bit_vector_max(occ_node->influences) > scope->depth);
+            assert(scope_set_max(scope->circuit->scope_influence, occ_node->id) > scope->depth);
             continue;
         }
         
@@ -259,7 +263,7 @@ static void encode_or_gate(CircuitAbstraction* abs, Scope* scope, bool negate, G
         if (type == NODE_VAR) {
             // input to the gate is a variable...
             
-            if (bit_vector_contains(occ_node->influences, scope->depth)) {
+            if (scope_set_contains(scope->circuit->scope_influence, occ_node->id, scope->depth)) {
                 // ...of current scope
                 satsolver_add(sat, transformed_input);
 #ifdef CERTIFICATION
@@ -353,7 +357,7 @@ static void append_or_gate(CircuitAbstraction* abs, Scope* scope, bool negate, G
     
     assert(!gate->keep);
     
-    if (bit_vector_min(gate->shared.influences) > scope->depth) {
+    if (scope_set_min(scope->circuit->scope_influence, gate->shared.id) > scope->depth) {
         satsolver_add(sat, -b_lit);
         return;
     }
@@ -371,14 +375,14 @@ static void append_or_gate(CircuitAbstraction* abs, Scope* scope, bool negate, G
         node_shared* occ_node = circuit->nodes[var];
         const node_type type = circuit->types[var];
         
-        if (bit_vector_min(occ_node->influences) > scope->depth) {
+        if (scope_set_min(scope->circuit->scope_influence, occ_node->id) > scope->depth) {
             satsolver_add(sat, -b_lit);
             continue;
         }
         
         if (type == NODE_VAR) {
             // Input to the gate is a variable...
-            if (bit_vector_contains(occ_node->influences, scope->depth)) {
+            if (scope_set_contains(scope->circuit->scope_influence, occ_node->id, scope->depth)) {
                 // ...of current scope
                 satsolver_add(sat, transformed_input);
             }
@@ -461,16 +465,16 @@ static void encode_and_gate(CircuitAbstraction* abs, Scope* scope, bool negate,
         node_shared* occ_node = circuit->nodes[var];
         const node_type type = circuit->types[var];
         
-        if (bit_vector_min(occ_node->influences) > scope->depth) {
+        if (scope_set_min(scope->circuit->scope_influence, occ_node->id) > scope->depth) {
             // FIXME: probably not needed since it implies
-            assert(bit_vector_max(occ_node->influences) > scope->depth);
+            assert(scope_set_max(scope->circuit->scope_influence, occ_node->id) > scope->depth);
             continue;
         }
         
         if (type == NODE_VAR) {
             // Input to the gate is a variable...
             
-            if (bit_vector_contains(occ_node->influences, scope->depth)) {
+            if (scope_set_contains(scope->circuit->scope_influence, occ_node->id, scope->depth)) {
                 // ...of current scope
                 satsolver_add(sat, transformed_input);
                 satsolver_add(sat, -b_lit);
@@ -573,7 +577,7 @@ static void encode_gate(CircuitAbstraction* abs, Scope* scope, bool negate, var_
     const quantifier_type qtype = negate ? circuit_negate_quantifier_type(scope->qtype) : scope->qtype;
     const gate_type type = normalize_gate_type(gate->type, qtype);
 
-    if (bit_vector_min(gate->shared.influences) > scope->depth) {
+    if (scope_set_min(scope->circuit->scope_influence, gate->shared.id) > scope->depth) {
         return;
     }
     if (abs->options->use_combined_abstraction && current_max(&gate->shared, scope) < scope->depth) {
@@ -658,10 +662,17 @@ static void fix_output_value(CircuitAbstraction* abs, Scope* scope, bool negate)
         append_or_gate(abs, scope, negate, gate, false);
         assert(!abs->options->certify || certification_queue_is_empty(abs->cert));
     }
+    if (abs->output_activation != 0) {
+        // retracted when the output changes, see circuit_abstraction_extend
+        satsolver_add(sat, -abs->output_activation);
+    }
     satsolver_add(sat, 0);
 }
 
-static void circuit_abstraction_build_sat_instance(CircuitAbstraction* abs, Scope* scope, bool negate) {
+/**
+ * Encodes the nodes first_node, ..., max_num and fixes the value of the output.
+ */
+static void circuit_abstraction_build_sat_instance(CircuitAbstraction* abs, Scope* scope, bool negate, var_t first_node) {
     Circuit* circuit = scope->circuit;
     SATSolver* sat = negate ? abs->negation : abs->sat;
     
@@ -670,7 +681,7 @@ static void circuit_abstraction_build_sat_instance(CircuitAbstraction* abs, Scop
     assert(vector_count(scope->vars) == 0 && scope->scope_id == 1 || vector_count(scope->vars) > 0);
     
     if (!negate) {
-        for (var_t i = 1; i <= circuit->max_num; i++) {
+        for (var_t i = first_node; i <= circuit->max_num; i++) {
             assert(circuit->nodes[i] != NULL);
             node_type type = circuit->types[i];
             
@@ -685,7 +696,7 @@ static void circuit_abstraction_build_sat_instance(CircuitAbstraction* abs, Scop
         }
     }
     
-    for (var_t i = 1; i <= circuit->max_num; i++) {
+    for (var_t i = first_node; i <= circuit->max_num; i++) {
         assert(circuit->nodes[i] != NULL);
         node_type type = circuit->types[i];
         
@@ -711,6 +722,26 @@ static void circuit_abstraction_build_sat_instance(CircuitAbstraction* abs, Scop
 }
 
 
+/**
+ * Returns a fresh variable of both sat and negation.
+ */
+static lit_t new_variable(CircuitAbstraction* abs) {
+    satsolver_new_variable(abs->sat);
+    satsolver_new_variable(abs->negation);
+    return ++abs->max_var;
+}
+
+static int new_activation(void* abs) {
+    return new_variable(abs);
+}
+
+static void add_clause(SATSolver* sat, const int_vector* clause) {
+    for (size_t i = 0; i < int_vector_count((int_vector*)clause); i++) {
+        satsolver_add(sat, int_vector_get((int_vector*)clause, i));
+    }
+    satsolver_add(sat, 0);
+}
+
 CircuitAbstraction* circuit_abstraction_init(SolverOptions* options, certification* cert, Scope* scope, CircuitAbstraction* prev) {
     CircuitAbstraction* abs = malloc(sizeof(CircuitAbstraction));
     abs->options = options;
@@ -727,11 +758,27 @@ CircuitAbstraction* circuit_abstraction_init(SolverOptions* options, certificati
     abs->t_lits = int_vector_init();
     abs->b_lits = int_vector_init();
     abs->assumptions = int_vector_init();
-    abs->entry = bit_vector_init(scope->circuit->max_num, var_id_to_t_lit(scope->circuit, scope->circuit->max_num) + 1);
+    // t_lit_offset is larger than max_num if literals are reserved for extensions
+    abs->entry = bit_vector_init(scope->circuit->t_lit_offset, var_id_to_t_lit(scope->circuit, scope->circuit->t_lit_offset) + 1);
     abs->local_unsat_core = int_vector_init();
     abs->sat_solver_assumptions = int_vector_init();
+    abs->learned_clause = int_vector_init();
+    abs->pending_refinements = vector_init();
+    abs->batch_activation = 0;
+    abs->core = int_vector_init();
+    abs->core_minimization = statistics_init(10000);
+    abs->core_literals_before = 0;
+    abs->core_literals_after = 0;
+    abs->core_checks = 0;
+    abs->core_activity = calloc(scope->circuit->t_lit_offset + 1, sizeof(double));
+    abs->core_activity_increment = 1.0;
+    abs->preferred_b_lits = int_vector_init();
+    abs->output_activation = 0;
+    abs->entry_depends_on_output = false;
+    abs->local_unsat_core_depends_on_output = false;
     
     abs->statistics = statistics_init(10000);
+    abs->perf_counters = options->perf_counters ? perf_counters_init() : NULL;
     
 #ifdef PARALLEL_SOLVING
     pthread_mutex_init(&abs->mutex, NULL);
@@ -740,23 +787,35 @@ CircuitAbstraction* circuit_abstraction_init(SolverOptions* options, certificati
 #endif
     
     // create variables needed
-    for (size_t i = 0; i < 2 * scope->circuit->max_num; i++) {
-        satsolver_new_variable(abs->sat);
-        satsolver_new_variable(abs->negation);
+    abs->max_var = 0;
+    for (size_t i = 0; i < 2 * scope->circuit->t_lit_offset; i++) {
+        new_variable(abs);
+    }
+    if (scope->circuit->extensible) {
+        abs->output_activation = new_variable(abs);
+    }
+    
+    if (options->max_refinements > 0) {
+        abs->refinements = refinement_db_init(abs->sat, options->max_refinements, new_activation, abs);
+        abs->blocking_clauses = refinement_db_init(abs->negation, options->max_refinements, new_activation, abs);
+    } else {
+        abs->refinements = NULL;
+        abs->blocking_clauses = NULL;
     }
     
+#ifdef SATSOLVER_PARTIAL_DEREF
     if (abs->scope->num_next > 0 && abs->options->use_partial_deref) {
-        fixme("save original clauses\n");
-        //satsolver_save_original_clauses(abs->sat);
+        satsolver_save_original_clauses(abs->sat);
     }
+#endif
     //satsolver_save_original_clauses(abs->negation);
     
     //satsolver_adjust(abs->sat, 2 * abs->scope->circuit->max_num);
     //satsolver_adjust(abs->negation, 2 * abs->scope->circuit->max_num);
     
     logging_debug("Level %d\n", scope->scope_id);
-    circuit_abstraction_build_sat_instance(abs, scope, false);
-    circuit_abstraction_build_sat_instance(abs, scope, true);
+    circuit_abstraction_build_sat_instance(abs, scope, false, 1);
+    circuit_abstraction_build_sat_instance(abs, scope, true, 1);
     
     if (logging_get_verbosity() >= VERBOSITY_ALL) {
         for (size_t i = 0; i < int_vector_count(abs->t_lits); i++) {
@@ -778,6 +837,119 @@ CircuitAbstraction* circuit_abstraction_init(SolverOptions* options, certificati
     return abs;
 }
 
+/**
+ * Encodes the nodes appended by circuit_extend and replaces the output.
+ *
+ * The encoding of a node only depends on the node and its inputs, thus, the
+ * clauses of the old nodes stay as they are. This does not hold for the
+ * combined abstraction, which is disabled for extensible circuits. Learned
+ * clauses remain valid unless they were derived using the clause fixing the
+ * old output, such clauses are guarded by its activation literal, see refine.
+ */
+void circuit_abstraction_extend(CircuitAbstraction* abs, var_t first_node) {
+    Circuit* circuit = abs->scope->circuit;
+    assert(circuit->extensible && abs->output_activation != 0);
+    assert(!abs->options->use_combined_abstraction);
+    assert(circuit->max_num <= circuit->t_lit_offset);
+    
+    // retract the old output permanently
+    satsolver_add(abs->sat, -abs->output_activation);
+    satsolver_add(abs->sat, 0);
+    satsolver_add(abs->negation, -abs->output_activation);
+    satsolver_add(abs->negation, 0);
+    if (abs->refinements != NULL) {
+        refinement_db_retire_containing(abs->refinements, -abs->output_activation);
+        refinement_db_retire_containing(abs->blocking_clauses, -abs->output_activation);
+    }
+    abs->output_activation = new_variable(abs);
+    
+    logging_debug("Level %d, extension from node %d\n", abs->scope->scope_id, first_node);
+    circuit_abstraction_build_sat_instance(abs, abs->scope, false, first_node);
+    circuit_abstraction_build_sat_instance(abs, abs->scope, true, first_node);
+    
+    assert(int_vector_is_sorted(abs->t_lits));
+    assert(int_vector_is_sorted(abs->b_lits));
+}
+
+static void add_refinement(CircuitAbstraction* abs, const int_vector* clause) {
+    if (abs->refinements != NULL) {
+        refinement_db_add(abs->refinements, clause);
+    } else {
+        add_clause(abs->sat, clause);
+    }
+}
+
+/**
+ * Returns whether learned_clause refutes the level, i.e., it is empty up to
+ * the guard of the output.
+ */
+static bool learned_clause_is_empty(const CircuitAbstraction* abs) {
+    const size_t count = int_vector_count(abs->learned_clause);
+    return count == 0 || (count == 1 && int_vector_get(abs->learned_clause, 0) == -abs->output_activation);
+}
+
+void circuit_abstraction_add_refinement(CircuitAbstraction* abs) {
+    // there are no further candidates to evaluate if the level is refuted
+    if (abs->options->refinement_batch > 1 && !learned_clause_is_empty(abs)) {
+        int_vector* clause = int_vector_init();
+        for (size_t i = 0; i < int_vector_count(abs->learned_clause); i++) {
+            int_vector_add(clause, int_vector_get(abs->learned_clause, i));
+        }
+        vector_add(abs->pending_refinements, clause);
+    } else {
+        add_refinement(abs, abs->learned_clause);
+    }
+    int_vector_reset(abs->learned_clause);
+}
+
+void circuit_abstraction_block_candidate(CircuitAbstraction* abs) {
+    if (abs->batch_activation == 0) {
+        abs->batch_activation = new_variable(abs);
+    }
+    // one of the disabled b-lits has to be enabled, hence, the next levels get a different entry
+    for (size_t i = 0; i < int_vector_count(abs->assumptions); i++) {
+        satsolver_add(abs->sat, int_vector_get(abs->assumptions, i));
+    }
+    satsolver_add(abs->sat, -abs->batch_activation);
+    satsolver_add(abs->sat, 0);
+}
+
+void circuit_abstraction_flush_refinements(CircuitAbstraction* abs) {
+    for (size_t i = 0; i < vector_count(abs->pending_refinements); i++) {
+        int_vector* clause = vector_get(abs->pending_refinements, i);
+        add_refinement(abs, clause);
+        int_vector_free(clause);
+    }
+    vector_reset(abs->pending_refinements);
+    if (abs->batch_activation != 0) {
+        satsolver_add(abs->sat, -abs->batch_activation);
+        satsolver_add(abs->sat, 0);
+        abs->batch_activation = 0;
+    }
+}
+
+bool circuit_abstraction_restore_clauses(CircuitAbstraction* abs, const int_vector* clauses, bool negation) {
+    refinement_db* learned = negation ? abs->blocking_clauses : abs->refinements;
+    int_vector* clause = int_vector_init();
+    bool valid = true;
+    for (size_t i = 0; i < int_vector_count((int_vector*)clauses) && valid; i++) {
+        const int lit = int_vector_get((int_vector*)clauses, i);
+        if (lit != 0) {
+            valid = lit_to_var(lit) <= (var_t)abs->max_var;
+            int_vector_add(clause, lit);
+            continue;
+        }
+        if (learned != NULL) {
+            refinement_db_add(learned, clause);
+        } else {
+            add_clause(negation ? abs->negation : abs->sat, clause);
+        }
+        int_vector_reset(clause);
+    }
+    int_vector_free(clause);
+    return valid;
+}
+
 void circuit_abstraction_free_recursive(CircuitAbstraction* abstraction) {
     for (size_t i = 0; i < abstraction->scope->num_next; i++) {
         circuit_abstraction_free_recursive(abstraction->next[i]);
@@ -790,12 +962,27 @@ void circuit_abstraction_free(CircuitAbstraction* abstraction) {
     satsolver_free(abstraction->negation);
     
     statistics_free(abstraction->statistics);
+    perf_counters_free(abstraction->perf_counters);
     
     int_vector_free(abstraction->t_lits);
     int_vector_free(abstraction->b_lits);
     int_vector_free(abstraction->assumptions);
     bit_vector_free(abstraction->entry);
     int_vector_free(abstraction->local_unsat_core);
+    int_vector_free(abstraction->sat_solver_assumptions);
+    int_vector_free(abstraction->learned_clause);
+    for (size_t i = 0; i < vector_count(abstraction->pending_refinements); i++) {
+        int_vector_free(vector_get(abstraction->pending_refinements, i));
+    }
+    vector_free(abstraction->pending_refinements);
+    int_vector_free(abstraction->core);
+    statistics_free(abstraction->core_minimization);
+    free(abstraction->core_activity);
+    int_vector_free(abstraction->preferred_b_lits);
+    if (abstraction->refinements != NULL) {
+        refinement_db_free(abstraction->refinements);
+        refinement_db_free(abstraction->blocking_clauses);
+    }
     
     free(abstraction->next);
     free(abstraction);
@@ -815,13 +1002,16 @@ void circuit_abstraction_get_assumptions(CircuitAbstraction* abstraction) {
     for (size_t i = 0; i < int_vector_count(abstraction->b_lits); i++) {
         const lit_t b_lit = int_vector_get(abstraction->b_lits, i);
         int value;
+#ifdef SATSOLVER_PARTIAL_DEREF
         if (abstraction->options->use_partial_deref) {
-            fixme("partial deref\n");
-            //value = satsolver_deref_partial(abstraction->sat, b_lit);
-            value = satsolver_value(abstraction->sat, b_lit);
+            // b-lits that are not needed to satisfy the original clauses stay unassigned, i.e., enabled
+            value = satsolver_deref_partial(abstraction->sat, b_lit);
         } else {
             value = satsolver_value(abstraction->sat, b_lit);
         }
+#else
+        value = satsolver_value(abstraction->sat, b_lit);
+#endif
         if (value >= 0) {
             continue;
         }
@@ -885,9 +1075,61 @@ void circuit_abstraction_get_assumptions(CircuitAbstraction* abstraction) {
     }
 }
 
+static double core_activity(const CircuitAbstraction* abstraction, lit_t t_lit) {
+    if (t_lit < 0) {
+        t_lit = -t_lit;
+    }
+    return abstraction->core_activity[(var_t)t_lit - abstraction->scope->circuit->t_lit_offset];
+}
+
+typedef struct {
+    lit_t lit;
+    double activity;
+} activity_lit;
+
+static int compare_decreasing_activity(const void* a, const void* b) {
+    const activity_lit* lit_a = a;
+    const activity_lit* lit_b = b;
+    if (lit_a->activity != lit_b->activity) {
+        return lit_a->activity < lit_b->activity ? 1 : -1;
+    }
+    return (lit_a->lit > lit_b->lit) - (lit_a->lit < lit_b->lit);
+}
+
+/**
+ * Assumes the negative t-literals in sat_solver_assumptions, the ones that
+ * appeared in recent cores first. SAT solvers derive the failed assumptions
+ * from the earliest assumptions involved in the conflict, hence, consecutive
+ * cores tend to agree and so do the refinements derived from them.
+ */
+static void assume_by_core_activity(CircuitAbstraction* abstraction, SATSolver* sat) {
+    const size_t num_lits = int_vector_count(abstraction->sat_solver_assumptions);
+    activity_lit* lits = malloc(sizeof(activity_lit) * (num_lits + 1));
+    for (size_t i = 0; i < num_lits; i++) {
+        lits[i].lit = int_vector_get(abstraction->sat_solver_assumptions, i);
+        lits[i].activity = core_activity(abstraction, lits[i].lit);
+    }
+    qsort(lits, num_lits, sizeof(activity_lit), compare_decreasing_activity);
+    for (size_t i = 0; i < num_lits; i++) {
+        satsolver_assume(sat, lits[i].lit);
+    }
+    free(lits);
+}
+
 void circuit_abstraction_assume_t_literals(CircuitAbstraction* abstraction, bool negation) {
     int_vector_reset(abstraction->sat_solver_assumptions);
     SATSolver* sat = negation ? abstraction->negation : abstraction->sat;
+    if (abstraction->output_activation != 0) {
+        satsolver_assume(sat, abstraction->output_activation);
+    }
+    if (!negation && abstraction->batch_activation != 0) {
+        satsolver_assume(sat, abstraction->batch_activation);
+    }
+    refinement_db* learned = negation ? abstraction->blocking_clauses : abstraction->refinements;
+    if (learned != NULL) {
+        refinement_db_assume(learned);
+    }
+    const bool ordered = abstraction->options->phase_guidance;
     for (size_t i = 0; i < int_vector_count(abstraction->t_lits); i++) {
         lit_t t_lit = int_vector_get(abstraction->t_lits, i);
         const var_t var_id = t_lit_to_var_id(abstraction->scope->circuit, t_lit);
@@ -897,13 +1139,18 @@ void circuit_abstraction_assume_t_literals(CircuitAbstraction* abstraction, bool
         if (negation) {
             t_lit = -t_lit;
         }
-        satsolver_assume(sat, t_lit);
         logging_debug("t%d ", create_lit_from_value(var_id, t_lit));
         if (t_lit < 0) {
             int_vector_add(abstraction->sat_solver_assumptions, t_lit);
         }
+        if (t_lit > 0 || !ordered) {
+            satsolver_assume(sat, t_lit);
+        }
     }
     logging_debug("\n");
+    if (ordered) {
+        assume_by_core_activity(abstraction, sat);
+    }
 }
 
 
@@ -921,14 +1168,230 @@ static void assume_current_assignment(CircuitAbstraction* abstraction) {
     logging_debug("\n");
 }
 
+#define CORE_ACTIVITY_DECAY 0.95
+#define CORE_ACTIVITY_LIMIT 1e100
+
+// Bumps the activity of the t-literals in core, recent cores weigh more
+static void bump_core_activity(CircuitAbstraction* abstraction) {
+    if (!abstraction->options->phase_guidance) {
+        return;
+    }
+    const var_t t_lit_offset = abstraction->scope->circuit->t_lit_offset;
+    for (size_t i = 0; i < int_vector_count(abstraction->core); i++) {
+        const var_t t_lit = (var_t)-int_vector_get(abstraction->core, i);
+        double* activity = &abstraction->core_activity[t_lit - t_lit_offset];
+        *activity += abstraction->core_activity_increment;
+        if (*activity > CORE_ACTIVITY_LIMIT) {
+            for (size_t j = 0; j <= t_lit_offset; j++) {
+                abstraction->core_activity[j] /= CORE_ACTIVITY_LIMIT;
+            }
+            abstraction->core_activity_increment /= CORE_ACTIVITY_LIMIT;
+        }
+    }
+    abstraction->core_activity_increment /= CORE_ACTIVITY_DECAY;
+}
+
+/**
+ * The b-literals of the last local UNSAT core, i.e., the ones that appeared
+ * in the cores of the next levels, are preferred to be enabled by sat. The
+ * preference of older cores is dropped.
+ */
+static void update_preferred_phases(CircuitAbstraction* abstraction) {
+#ifdef SATSOLVER_DEFAULT_PHASE
+    if (!abstraction->options->phase_guidance) {
+        return;
+    }
+    for (size_t i = 0; i < int_vector_count(abstraction->preferred_b_lits); i++) {
+        satsolver_set_default_phase_lit(abstraction->sat, int_vector_get(abstraction->preferred_b_lits, i), 0);
+    }
+    int_vector_reset(abstraction->preferred_b_lits);
+    for (size_t i = 0; i < int_vector_count(abstraction->local_unsat_core); i++) {
+        const lit_t b_lit = t_lit_to_b_lit(abstraction->scope->circuit, int_vector_get(abstraction->local_unsat_core, i));
+        if (int_vector_contains_sorted(abstraction->b_lits, b_lit)) {
+            satsolver_set_default_phase_lit(abstraction->sat, b_lit, 1);
+            int_vector_add(abstraction->preferred_b_lits, b_lit);
+        }
+    }
+#else
+    (void)abstraction;
+#endif
+}
+
+// Collects the failed negative t-literal assumptions of the last call of sat in core
+static void collect_failed_t_literals(CircuitAbstraction* abstraction, SATSolver* sat) {
+    int_vector_reset(abstraction->core);
+    for (size_t i = 0; i < int_vector_count(abstraction->sat_solver_assumptions); i++) {
+        const lit_t t_lit = int_vector_get(abstraction->sat_solver_assumptions, i);
+        assert(t_lit < 0);
+        if (satsolver_failed(sat, t_lit)) {
+            int_vector_add(abstraction->core, t_lit);
+        }
+    }
+}
+
+typedef struct {
+    CircuitAbstraction* abstraction;
+    bool negation;
+    bool output;         // the clause of the output was used to derive the core
+    size_t budget;       // remaining SAT calls, SIZE_MAX if unlimited
+} core_check;
+
+/**
+ * Returns whether the given negative t-literals are a core, i.e., the SAT
+ * solver is unsatisfiable under them and the assumptions of the last call
+ * that are not part of the core. Without remaining budget, the literals are
+ * conservatively assumed to be no core.
+ */
+static bool is_core(core_check* check, const lit_t* lits, size_t num_lits) {
+    if (check->budget == 0) {
+        return false;
+    }
+    if (check->budget != SIZE_MAX) {
+        check->budget--;
+    }
+    CircuitAbstraction* abstraction = check->abstraction;
+    abstraction->core_checks++;
+    SATSolver* sat = check->negation ? abstraction->negation : abstraction->sat;
+    if (check->negation) {
+        assume_current_assignment(abstraction);
+    }
+    if (check->output) {
+        satsolver_assume(sat, abstraction->output_activation);
+    }
+    refinement_db* learned = check->negation ? abstraction->blocking_clauses : abstraction->refinements;
+    if (learned != NULL) {
+        refinement_db_assume(learned);
+    }
+    for (size_t i = 0; i < int_vector_count(abstraction->t_lits); i++) {
+        lit_t t_lit = int_vector_get(abstraction->t_lits, i);
+        if (!bit_vector_contains(abstraction->entry, t_lit)) {
+            t_lit = -t_lit;
+        }
+        if (check->negation) {
+            t_lit = -t_lit;
+        }
+        if (t_lit > 0) {
+            satsolver_assume(sat, t_lit);
+        }
+    }
+    for (size_t i = 0; i < num_lits; i++) {
+        satsolver_assume(sat, lits[i]);
+    }
+    return satsolver_sat(sat) == SATSOLVER_UNSATISFIABLE;
+}
+
+/**
+ * Deletion-based minimization, every literal is dropped once. If the core
+ * remains a core without it, only the failed literals are kept.
+ */
+static size_t minimize_by_deletion(core_check* check, lit_t* core, size_t num_core) {
+    lit_t* candidate = malloc(sizeof(lit_t) * (num_core + 1));
+    size_t i = 0;
+    while (i < num_core) {
+        size_t num_candidate = 0;
+        for (size_t j = 0; j < num_core; j++) {
+            if (j != i) {
+                candidate[num_candidate++] = core[j];
+            }
+        }
+        if (!is_core(check, candidate, num_candidate)) {
+            // literal is necessary, so it is contained in every core of the remaining literals
+            i++;
+            continue;
+        }
+        SATSolver* sat = check->negation ? check->abstraction->negation : check->abstraction->sat;
+        num_core = 0;
+        for (size_t j = 0; j < num_candidate; j++) {
+            if (satsolver_failed(sat, candidate[j])) {
+                core[num_core++] = candidate[j];
+            }
+        }
+    }
+    free(candidate);
+    return num_core;
+}
+
+/**
+ * QuickXplain: appends a minimal subset of candidates to result such that it
+ * is a core together with background. The buffer background has room for
+ * all literals of the core, entries after num_background are overwritten.
+ */
+static void quickxplain(core_check* check, lit_t* background, size_t num_background, bool has_delta, const lit_t* candidates, size_t num_candidates, lit_t* result, size_t* num_result) {
+    if (has_delta && is_core(check, background, num_background)) {
+        return;
+    }
+    if (num_candidates == 1) {
+        result[(*num_result)++] = candidates[0];
+        return;
+    }
+    const size_t half = num_candidates / 2;
+    
+    // minimal subset of the second half given the first one
+    memcpy(background + num_background, candidates, sizeof(lit_t) * half);
+    const size_t begin = *num_result;
+    quickxplain(check, background, num_background + half, true, candidates + half, num_candidates - half, result, num_result);
+    
+    // minimal subset of the first half given the subset of the second one
+    const size_t num_second = *num_result - begin;
+    memcpy(background + num_background, result + begin, sizeof(lit_t) * num_second);
+    quickxplain(check, background, num_background + num_second, num_second > 0, candidates, half, result, num_result);
+}
+
+/**
+ * Minimizes core, the failed negative t-literals of the last call of sat (or
+ * negation), according to the options. As the SAT solver is called again, it
+ * has to be done after the failed assumptions were analyzed. The outermost
+ * level refines no other level, hence, its cores are not minimized.
+ */
+static void minimize_core(CircuitAbstraction* abstraction, bool negation) {
+    const size_t num_core = int_vector_count(abstraction->core);
+    if (abstraction->options->core_minimization == CORE_MINIMIZATION_NONE || abstraction->prev == NULL || num_core <= 1) {
+        return;
+    }
+    statistics_start_timer(abstraction->core_minimization);
+    
+    core_check check;
+    check.abstraction = abstraction;
+    check.negation = negation;
+    check.output = abstraction->entry_depends_on_output;
+    check.budget = abstraction->options->core_minimization_budget > 0 ? abstraction->options->core_minimization_budget : SIZE_MAX;
+    
+    lit_t* core = malloc(sizeof(lit_t) * num_core);
+    for (size_t i = 0; i < num_core; i++) {
+        core[i] = int_vector_get(abstraction->core, i);
+    }
+    size_t num_minimized;
+    if (abstraction->options->core_minimization == CORE_MINIMIZATION_DELETION) {
+        num_minimized = minimize_by_deletion(&check, core, num_core);
+    } else {
+        assert(abstraction->options->core_minimization == CORE_MINIMIZATION_QUICKXPLAIN);
+        lit_t* background = malloc(sizeof(lit_t) * num_core);
+        lit_t* result = malloc(sizeof(lit_t) * num_core);
+        num_minimized = 0;
+        quickxplain(&check, background, 0, false, core, num_core, result, &num_minimized);
+        memcpy(core, result, sizeof(lit_t) * num_minimized);
+        free(background);
+        free(result);
+    }
+    
+    int_vector_reset(abstraction->core);
+    for (size_t i = 0; i < num_minimized; i++) {
+        int_vector_add(abstraction->core, core[i]);
+    }
+    free(core);
+    
+    abstraction->core_literals_before += num_core;
+    abstraction->core_literals_after += num_minimized;
+    statistics_stop_and_record_timer(abstraction->core_minimization);
+}
+
 void circuit_abstraction_dual_propagation(CircuitAbstraction* abstraction) {
     Circuit* circuit = abstraction->scope->circuit;
     
-    assume_current_assignment(abstraction);
-    circuit_abstraction_assume_t_literals(abstraction, true);
-    
     if (abstraction->scope->num_next != 0) {
         // Add UNSAT core as blocking clause
+        int_vector* clause = abstraction->learned_clause;
+        assert(int_vector_count(clause) == 0);
         for (size_t i = 0; i < int_vector_count(abstraction->local_unsat_core); i++) {
             const lit_t failed_t_lit = int_vector_get(abstraction->local_unsat_core, i);
             assert(failed_t_lit > 0);
@@ -937,20 +1400,35 @@ void circuit_abstraction_dual_propagation(CircuitAbstraction* abstraction) {
             logging_debug("b%d ", t_lit_to_var_id(circuit, failed_t_lit));
             
             if (!int_vector_contains_sorted(abstraction->b_lits, b_lit)) {
-                satsolver_add(abstraction->negation, failed_t_lit);
+                int_vector_add(clause, failed_t_lit);
                 continue;
             }
-            satsolver_add(abstraction->negation, b_lit);
+            int_vector_add(clause, b_lit);
+        }
+        if (abstraction->local_unsat_core_depends_on_output) {
+            int_vector_add(clause, -abstraction->output_activation);
         }
-        satsolver_add(abstraction->negation, 0);
+        update_preferred_phases(abstraction);
+        if (abstraction->blocking_clauses != NULL) {
+            refinement_db_add(abstraction->blocking_clauses, clause);
+        } else {
+            add_clause(abstraction->negation, clause);
+        }
+        int_vector_reset(clause);
+        logging_debug("\n");
     }
-    logging_debug("\n");
+    
+    assume_current_assignment(abstraction);
+    circuit_abstraction_assume_t_literals(abstraction, true);
     
     sat_res result = satsolver_sat(abstraction->negation);
     assert(result == SATSOLVER_UNSATISFIABLE);
     if (result != SATSOLVER_UNSATISFIABLE) {
         logging_fatal("An internal solver error ocurred due to a bad abstraction entry.\nPlease consider sending a bug report to tentrup@react.uni-saarland.de\n");
     }
+    if (abstraction->blocking_clauses != NULL) {
+        refinement_db_analyze_failed(abstraction->blocking_clauses);
+    }
     
     // Reset variable assignments
     /*for (size_t i = 0; i < vector_count(abstraction->scope->vars); i++) {
@@ -958,15 +1436,15 @@ void circuit_abstraction_dual_propagation(CircuitAbstraction* abstraction) {
         var->shared.value = 0;
     }*/
     
+    abstraction->entry_depends_on_output = abstraction->output_activation != 0 && satsolver_failed(abstraction->negation, abstraction->output_activation);
+    collect_failed_t_literals(abstraction, abstraction->negation);
+    minimize_core(abstraction, true);
+    bump_core_activity(abstraction);
+    
     bit_vector_reset(abstraction->entry);
     logging_debug("min ");
-    for (size_t i = 0; i < int_vector_count(abstraction->sat_solver_assumptions); i++) {
-        lit_t failed_t_lit = int_vector_get(abstraction->sat_solver_assumptions, i);
-        assert(failed_t_lit < 0);
-        if (!satsolver_failed(abstraction->negation, failed_t_lit)) {
-            continue;
-        }
-        failed_t_lit = -failed_t_lit;
+    for (size_t i = 0; i < int_vector_count(abstraction->core); i++) {
+        const lit_t failed_t_lit = -int_vector_get(abstraction->core, i);
         assert(failed_t_lit > 0);
         
         const var_t node = t_lit_to_var_id(circuit, failed_t_lit);
@@ -991,15 +1469,18 @@ void circuit_abstraction_dual_propagation(CircuitAbstraction* abstraction) {
 
 void circuit_abstraction_get_unsat_core(CircuitAbstraction* abstraction) {
     Circuit* circuit = abstraction->scope->circuit;
+    abstraction->entry_depends_on_output = abstraction->output_activation != 0 && satsolver_failed(abstraction->sat, abstraction->output_activation);
+    if (abstraction->refinements != NULL) {
+        refinement_db_analyze_failed(abstraction->refinements);
+    }
+    collect_failed_t_literals(abstraction, abstraction->sat);
+    minimize_core(abstraction, false);
+    bump_core_activity(abstraction);
+    
     bit_vector_reset(abstraction->entry);
     logging_debug("unsat: ");
-    for (size_t i = 0; i < int_vector_count(abstraction->sat_solver_assumptions); i++) {
-        lit_t failed_t_lit = int_vector_get(abstraction->sat_solver_assumptions, i);
-        assert(failed_t_lit < 0);
-        if (!satsolver_failed(abstraction->sat, failed_t_lit)) {
-            continue;
-        }
-        failed_t_lit = -failed_t_lit;
+    for (size_t i = 0; i < int_vector_count(abstraction->core); i++) {
+        const lit_t failed_t_lit = -int_vector_get(abstraction->core, i);
         assert(failed_t_lit > 0);
         
         const lit_t node_id = t_lit_to_var_id(circuit, failed_t_lit);
@@ -1010,11 +1491,10 @@ void circuit_abstraction_get_unsat_core(CircuitAbstraction* abstraction) {
 }
 
 void circuit_abstraction_adjust_local_unsat_core(CircuitAbstraction* abstraction, CircuitAbstraction* child) {
+    abstraction->local_unsat_core_depends_on_output |= child->entry_depends_on_output;
     for (var_t t_lit = bit_vector_init_iteration(child->entry); bit_vector_iterate(child->entry); t_lit = bit_vector_next(child->entry)) {
         assert(t_lit > 0);
         //assert(!int_vector_contains_sorted(abstraction->local_unsat_core, t_lit));
         int_vector_add(abstraction->local_unsat_core, t_lit);
-        fixme("adjust default phase\n");
-        //satsolver_set_default_phase_lit(abstraction->sat, t_lit_to_b_lit(abstraction->scope->circuit, t_lit), 1);
     }
 }
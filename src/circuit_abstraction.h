@@ -16,6 +16,8 @@
 #include "vector.h"
 #include "satsolver.h"
 #include "statistics.h"
+#include "perf_counters.h"
+#include "refinement.h"
 
 #ifdef PARALLEL_SOLVING
 #include <pthread.h>
@@ -49,7 +51,35 @@ struct circuit_abstraction {
     int_vector* local_unsat_core;
     int_vector* sat_solver_assumptions;
     
+    // learned clauses, NULL if they are added permanently
+    refinement_db* refinements;      // of sat
+    refinement_db* blocking_clauses; // of negation
+    int_vector* learned_clause;      // clause under construction, see circuit_abstraction_add_refinement
+    lit_t max_var;                   // largest variable of sat and negation
+    
+    // batched refinements, see circuit_abstraction_block_candidate
+    vector* pending_refinements;     // learned clauses deferred until the batch is complete
+    lit_t batch_activation;          // guards the clauses blocking the candidates of the batch, 0 if none
+    
+    // core minimization, see minimize_core
+    int_vector* core;                // failed negative t-literal assumptions of the last call
+    Stats* core_minimization;        // time spent minimizing
+    size_t core_literals_before;
+    size_t core_literals_after;
+    size_t core_checks;              // SAT calls
+    
+    // phase guidance, see circuit_abstraction_adjust_local_unsat_core
+    double* core_activity;           // of t-literals in recent cores, indexed by t_lit - t_lit_offset
+    double core_activity_increment;
+    int_vector* preferred_b_lits;    // b-literals with a preferred phase in sat
+    
+    // extensible circuits, see circuit_abstraction_extend
+    lit_t output_activation;                   // guards the clause fixing the output value, 0 if not extensible
+    bool entry_depends_on_output;              // entry was derived using the clause of the current output
+    bool local_unsat_core_depends_on_output;
+    
     Stats* statistics;
+    PerfCounters* perf_counters;  // NULL if disabled
 #ifdef PARALLEL_SOLVING
     pthread_mutex_t mutex;
     pthread_t thread;
@@ -62,6 +92,28 @@ struct circuit_abstraction {
 CircuitAbstraction* circuit_abstraction_init(SolverOptions*, certification*, Scope*, CircuitAbstraction* prev);
 void circuit_abstraction_free(CircuitAbstraction*);
 void circuit_abstraction_free_recursive(CircuitAbstraction*);
+void circuit_abstraction_extend(CircuitAbstraction*, var_t first_node);
+
+// Adds learned_clause to sat (or defers it in batched mode) and resets it
+void circuit_abstraction_add_refinement(CircuitAbstraction*);
+
+/**
+ * Batched mode: blocks the current candidate of sat, i.e., the assumptions
+ * given to the next levels, until circuit_abstraction_flush_refinements. The
+ * next call of the SAT solver yields another candidate while the refinements
+ * of this one are deferred.
+ */
+void circuit_abstraction_block_candidate(CircuitAbstraction*);
+
+// Adds the deferred refinements to sat and removes the blocking clauses of the batch
+void circuit_abstraction_flush_refinements(CircuitAbstraction*);
+
+/**
+ * Adds learned clauses of a previous run on the same circuit, e.g., restored
+ * from a checkpoint, to sat (or negation). The clauses are separated by 0.
+ * Returns false if a clause contains a literal unknown to the abstraction.
+ */
+bool circuit_abstraction_restore_clauses(CircuitAbstraction*, const int_vector* clauses, bool negation);
 
 void circuit_abstraction_get_assumptions(CircuitAbstraction*);
 void circuit_abstraction_assume_t_literals(CircuitAbstraction*, bool);
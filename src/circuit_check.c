@@ -28,8 +28,8 @@ static bool circuit_check_nodes(Circuit* circuit) {
             }
             assert(num_inputs == gate->num_inputs);
             
-            if (circuit->phase == ENCODED && lit_to_var(circuit->output) == gate->shared.id) {
-                // Output has no occurrences
+            if (circuit->phase == ENCODED && !circuit->extensible && lit_to_var(circuit->output) == gate->shared.id) {
+                // Output has no occurrences (extensible circuits keep unreachable nodes)
                 assert(gate->shared.num_occ == 0);
             }
             
@@ -95,6 +95,10 @@ static void print_qcir(Circuit* circuit, FILE* file, bool symbol_table) {
         fprintf(file, "#symboltable\n");
         for (size_t i = 0; i < vector_count(circuit->vars); i++) {
             Var* var = vector_get(circuit->vars, i);
+            if (var->removed) {
+                // not part of the circuit anymore, its id may be reused
+                continue;
+            }
             fprintf(file, "#%d %d\n", var->shared.id, var->shared.orig_id);
         }
         fprintf(file, "\n\n");
@@ -13,6 +13,14 @@
 #define NO_API_ASSERTIONS
 #endif
 
+/**
+ * Optional hooks of the SAT solver backend of libsolve (e.g., PicoSAT):
+ * SATSOLVER_DEFAULT_PHASE provides satsolver_set_default_phase_lit(SATSolver*, int lit, int phase),
+ * SATSOLVER_PARTIAL_DEREF provides satsolver_save_original_clauses(SATSolver*) and satsolver_deref_partial(SATSolver*, int lit).
+ */
+//#define SATSOLVER_DEFAULT_PHASE
+//#define SATSOLVER_PARTIAL_DEREF
+
 #define LOGGING
 //#define NDEBUG
 #define CERTIFICATION
@@ -0,0 +1,437 @@
+//
+//  expansion.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include "expansion.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "logging.h"
+
+// Literals of the instantiation that are constant, they never reach a SAT solver
+#define EXPANSION_TRUE  INT32_MAX
+#define EXPANSION_FALSE (-EXPANSION_TRUE)
+
+/**
+ * Gate of the abstraction introduced by an instantiation, normalized to an AND
+ * gate over inputs that are sorted by variable and free of duplicates.
+ */
+typedef struct {
+    lit_t lit;
+    size_t num_inputs;
+    lit_t* inputs;
+} expansion_gate;
+
+static quantifier_type player(const Scope* scope) {
+    return scope->qtype == QUANT_FORALL ? QUANT_FORALL : QUANT_EXISTS;
+}
+
+static void mark_relevant_nodes(Expansion* expansion) {
+    Circuit* circuit = expansion->circuit;
+    expansion->relevant[lit_to_var(circuit->output)] = true;
+    for (var_t i = (var_t)circuit->max_num; i > 0; i--) {
+        if (!expansion->relevant[i] || circuit->types[i] != NODE_GATE) {
+            continue;
+        }
+        Gate* gate = circuit->nodes[i];
+        for (size_t j = 0; j < gate->num_inputs; j++) {
+            expansion->relevant[lit_to_var(gate->inputs[j])] = true;
+        }
+    }
+}
+
+// Nodes are topologically ordered, thus, the inputs of a gate are marked before the gate
+static void mark_inner_nodes(Expansion* expansion) {
+    Circuit* circuit = expansion->circuit;
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (!expansion->relevant[i]) {
+            continue;
+        }
+        assert(circuit->nodes[i] != NULL);
+        const node_type type = circuit->types[i];
+        if (type == NODE_VAR) {
+            const Var* var = circuit->nodes[i];
+            expansion->inner[i] = player(var->scope) != expansion->outer_qtype;
+            continue;
+        }
+        assert(type == NODE_GATE);
+        const Gate* gate = circuit->nodes[i];
+        for (size_t j = 0; j < gate->num_inputs; j++) {
+            if (expansion->inner[lit_to_var(gate->inputs[j])]) {
+                expansion->inner[i] = true;
+                break;
+            }
+        }
+    }
+}
+
+// Tseitin encoding of lit <-> type(inputs)
+static void encode_gate(SATSolver* sat, lit_t lit, gate_type type, const lit_t* inputs, size_t num_inputs) {
+    const lit_t output = type == GATE_AND ? lit : -lit;
+    const lit_t sign = type == GATE_AND ? 1 : -1;
+    for (size_t i = 0; i < num_inputs; i++) {
+        satsolver_add(sat, -output);
+        satsolver_add(sat, sign * inputs[i]);
+        satsolver_add(sat, 0);
+    }
+    for (size_t i = 0; i < num_inputs; i++) {
+        satsolver_add(sat, -sign * inputs[i]);
+    }
+    satsolver_add(sat, output);
+    satsolver_add(sat, 0);
+}
+
+/**
+ * Encodes the relevant gates, either all of them (verification) or only the
+ * ones that do not depend on the inner player (abstraction).
+ */
+static void encode_circuit(Expansion* expansion, SATSolver* sat, bool shared_only) {
+    Circuit* circuit = expansion->circuit;
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        satsolver_new_variable(sat);
+        if (!expansion->relevant[i] || circuit->types[i] != NODE_GATE) {
+            continue;
+        }
+        if (shared_only && expansion->inner[i]) {
+            continue;
+        }
+        const Gate* gate = circuit->nodes[i];
+        encode_gate(sat, (lit_t)i, gate->type, gate->inputs, gate->num_inputs);
+    }
+}
+
+Expansion* expansion_init(Circuit* circuit, bool keep_counterexamples) {
+    assert(circuit_is_2qbf(circuit));
+    assert(circuit->output != 0);
+
+    Expansion* expansion = malloc(sizeof(Expansion));
+    expansion->circuit = circuit;
+    expansion->outer_qtype = QUANT_EXISTS;
+    for (Scope* scope = circuit->top_level; scope != NULL; scope = circuit_next_scope_in_prefix(scope)) {
+        if (vector_count(scope->vars) > 0) {
+            expansion->outer_qtype = player(scope);
+            break;
+        }
+    }
+    expansion->inner = calloc(circuit->max_num + 1, sizeof(bool));
+    expansion->relevant = calloc(circuit->max_num + 1, sizeof(bool));
+    mark_relevant_nodes(expansion);
+    mark_inner_nodes(expansion);
+
+    expansion->abstraction = satsolver_init();
+    expansion->verification = satsolver_init();
+    expansion->max_var = (lit_t)circuit->max_num;
+    expansion->instance = calloc(circuit->max_num + 1, sizeof(lit_t));
+    expansion->gates = map_init();
+    expansion->instantiated_gates = vector_init();
+    expansion->lost = false;
+    expansion->counterexamples = keep_counterexamples ? int_vector_init() : NULL;
+    expansion->on_iteration = NULL;
+    expansion->context = NULL;
+
+    expansion->num_instantiations = 0;
+    expansion->num_instantiated_gates = 0;
+    expansion->num_shared_gates = 0;
+    expansion->abstraction_time = statistics_init(10000);
+    expansion->verification_time = statistics_init(10000);
+
+    encode_circuit(expansion, expansion->abstraction, true);
+    encode_circuit(expansion, expansion->verification, false);
+
+    // the inner player refutes a candidate by violating the goal
+    const lit_t goal = expansion->outer_qtype == QUANT_EXISTS ? circuit->output : -circuit->output;
+    satsolver_add(expansion->verification, -goal);
+    satsolver_add(expansion->verification, 0);
+
+    return expansion;
+}
+
+void expansion_free(Expansion* expansion) {
+    for (size_t i = 0; i < vector_count(expansion->instantiated_gates); i++) {
+        expansion_gate* gate = vector_get(expansion->instantiated_gates, i);
+        free(gate->inputs);
+        free(gate);
+    }
+    vector_free(expansion->instantiated_gates);
+    for (size_t i = 0; i < expansion->gates->size; i++) {
+        if (expansion->gates->data[i].occupied) {
+            vector_free(expansion->gates->data[i].data);
+        }
+    }
+    map_free(expansion->gates);
+
+    satsolver_free(expansion->abstraction);
+    satsolver_free(expansion->verification);
+    free(expansion->instance);
+    free(expansion->inner);
+    free(expansion->relevant);
+    statistics_free(expansion->abstraction_time);
+    statistics_free(expansion->verification_time);
+    if (expansion->counterexamples != NULL) {
+        int_vector_free(expansion->counterexamples);
+    }
+    free(expansion);
+}
+
+static int compare_by_variable(const void* a, const void* b) {
+    const lit_t lit_a = *(const lit_t*)a;
+    const lit_t lit_b = *(const lit_t*)b;
+    const var_t var_a = lit_to_var(lit_a);
+    const var_t var_b = lit_to_var(lit_b);
+    if (var_a != var_b) {
+        return var_a < var_b ? -1 : 1;
+    }
+    return (lit_a > lit_b) - (lit_a < lit_b);
+}
+
+static int hash_inputs(const lit_t* inputs, size_t num_inputs) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < num_inputs; i++) {
+        hash = (hash ^ (uint32_t)inputs[i]) * 16777619u;
+    }
+    return (int)hash;
+}
+
+/**
+ * Returns the literal of the AND gate over inputs, which are sorted and free
+ * of duplicates. Gates over the same inputs are encoded only once.
+ */
+static lit_t abstraction_and_gate(Expansion* expansion, const lit_t* inputs, size_t num_inputs) {
+    const int hash = hash_inputs(inputs, num_inputs);
+    vector* bucket = map_get(expansion->gates, hash);
+    if (bucket == NULL) {
+        bucket = vector_init();
+        map_add(expansion->gates, hash, bucket);
+    }
+    for (size_t i = 0; i < vector_count(bucket); i++) {
+        const expansion_gate* gate = vector_get(bucket, i);
+        if (gate->num_inputs != num_inputs) {
+            continue;
+        }
+        size_t j = 0;
+        while (j < num_inputs && gate->inputs[j] == inputs[j]) {
+            j++;
+        }
+        if (j == num_inputs) {
+            expansion->num_shared_gates++;
+            return gate->lit;
+        }
+    }
+
+    expansion_gate* gate = malloc(sizeof(expansion_gate));
+    satsolver_new_variable(expansion->abstraction);
+    gate->lit = ++expansion->max_var;
+    gate->num_inputs = num_inputs;
+    gate->inputs = malloc(sizeof(lit_t) * num_inputs);
+    for (size_t i = 0; i < num_inputs; i++) {
+        gate->inputs[i] = inputs[i];
+    }
+    encode_gate(expansion->abstraction, gate->lit, GATE_AND, inputs, num_inputs);
+    vector_add(bucket, gate);
+    vector_add(expansion->instantiated_gates, gate);
+    expansion->num_instantiated_gates++;
+    return gate->lit;
+}
+
+// Literal of lit in the current instantiation, nodes not depending on the inner player are shared
+static lit_t instance_literal(Expansion* expansion, lit_t lit) {
+    const var_t var = lit_to_var(lit);
+    const lit_t instance = expansion->inner[var] ? expansion->instance[var] : (lit_t)var;
+    return lit < 0 ? -instance : instance;
+}
+
+static lit_t instantiate_gate(Expansion* expansion, const Gate* gate, lit_t* inputs) {
+    // OR gates are instantiated as negated AND gates over the negated inputs
+    const lit_t sign = gate->type == GATE_AND ? 1 : -1;
+    size_t num_inputs = 0;
+    for (size_t i = 0; i < gate->num_inputs; i++) {
+        const lit_t input = sign * instance_literal(expansion, gate->inputs[i]);
+        if (input == EXPANSION_FALSE) {
+            return sign * EXPANSION_FALSE;
+        }
+        if (input != EXPANSION_TRUE) {
+            inputs[num_inputs++] = input;
+        }
+    }
+
+    qsort(inputs, num_inputs, sizeof(lit_t), compare_by_variable);
+    size_t num_unique = 0;
+    for (size_t i = 0; i < num_inputs; i++) {
+        if (num_unique > 0 && inputs[num_unique - 1] == inputs[i]) {
+            continue;
+        }
+        if (num_unique > 0 && inputs[num_unique - 1] == -inputs[i]) {
+            return sign * EXPANSION_FALSE;
+        }
+        inputs[num_unique++] = inputs[i];
+    }
+
+    if (num_unique == 0) {
+        return sign * EXPANSION_TRUE;
+    }
+    if (num_unique == 1) {
+        return sign * inputs[0];
+    }
+    return sign * abstraction_and_gate(expansion, inputs, num_unique);
+}
+
+static bool is_inner_var(Expansion* expansion, var_t node) {
+    return expansion->relevant[node] && expansion->inner[node] && expansion->circuit->types[node] == NODE_VAR;
+}
+
+static void record_counterexample(Expansion* expansion) {
+    if (expansion->counterexamples == NULL) {
+        return;
+    }
+    for (var_t i = 1; i <= expansion->circuit->max_num; i++) {
+        if (is_inner_var(expansion, i)) {
+            int_vector_add(expansion->counterexamples, expansion->instance[i] == EXPANSION_TRUE ? (int)i : -(int)i);
+        }
+    }
+    int_vector_add(expansion->counterexamples, 0);
+}
+
+/**
+ * Sets the inner variables to the counterexample given by the model of the
+ * verification.
+ */
+static void read_counterexample(Expansion* expansion) {
+    for (var_t i = 1; i <= expansion->circuit->max_num; i++) {
+        if (is_inner_var(expansion, i)) {
+            // unassigned variables do not matter for the counterexample
+            const int value = satsolver_value(expansion->verification, (lit_t)i);
+            expansion->instance[i] = value > 0 ? EXPANSION_TRUE : EXPANSION_FALSE;
+        }
+    }
+}
+
+/**
+ * Adds the goal of the outer player to the abstraction, instantiated with the
+ * counterexample given by the values of the inner variables in instance.
+ */
+static void instantiate(Expansion* expansion) {
+    Circuit* circuit = expansion->circuit;
+    lit_t* inputs = NULL;
+    size_t size_inputs = 0;
+
+    record_counterexample(expansion);
+
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (!expansion->relevant[i] || !expansion->inner[i]) {
+            continue;
+        }
+        if (circuit->types[i] == NODE_VAR) {
+            continue;
+        }
+        const Gate* gate = circuit->nodes[i];
+        if (gate->num_inputs > size_inputs) {
+            size_inputs = gate->num_inputs;
+            inputs = realloc(inputs, sizeof(lit_t) * size_inputs);
+        }
+        expansion->instance[i] = instantiate_gate(expansion, gate, inputs);
+    }
+    free(inputs);
+
+    const lit_t output = instance_literal(expansion, circuit->output);
+    const lit_t goal = expansion->outer_qtype == QUANT_EXISTS ? output : -output;
+    if (goal == EXPANSION_FALSE) {
+        expansion->lost = true;
+    } else if (goal != EXPANSION_TRUE) {  // only restored counterexamples may not refute any candidate
+        satsolver_add(expansion->abstraction, goal);
+        satsolver_add(expansion->abstraction, 0);
+    }
+    expansion->num_instantiations++;
+}
+
+static bool is_outer_var(Expansion* expansion, var_t node) {
+    return expansion->relevant[node] && !expansion->inner[node] && expansion->circuit->types[node] == NODE_VAR;
+}
+
+static void assume_candidate(Expansion* expansion) {
+    Circuit* circuit = expansion->circuit;
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (!is_outer_var(expansion, i)) {
+            continue;
+        }
+        const int value = satsolver_value(expansion->abstraction, (lit_t)i);
+        if (value != 0) {
+            satsolver_assume(expansion->verification, create_lit_from_value(i, value));
+        }
+    }
+}
+
+static void set_candidate_values(Expansion* expansion) {
+    Circuit* circuit = expansion->circuit;
+    for (var_t i = 1; i <= circuit->max_num; i++) {
+        if (is_outer_var(expansion, i)) {
+            circuit_set_value(circuit, i, satsolver_value(expansion->abstraction, (lit_t)i));
+        }
+    }
+}
+
+void expansion_add_counterexample(Expansion* expansion, const int_vector* counterexample) {
+    for (var_t i = 1; i <= expansion->circuit->max_num; i++) {
+        if (is_inner_var(expansion, i)) {
+            expansion->instance[i] = EXPANSION_FALSE;
+        }
+    }
+    for (size_t i = 0; i < int_vector_count((int_vector*)counterexample); i++) {
+        const int lit = int_vector_get((int_vector*)counterexample, i);
+        const var_t var = (var_t)abs(lit);
+        if (var <= expansion->circuit->max_num && is_inner_var(expansion, var)) {
+            expansion->instance[var] = lit > 0 ? EXPANSION_TRUE : EXPANSION_FALSE;
+        }
+    }
+    instantiate(expansion);
+}
+
+qbf_res expansion_solve(Expansion* expansion) {
+    const qbf_res outer_wins = expansion->outer_qtype == QUANT_EXISTS ? QBF_RESULT_SAT : QBF_RESULT_UNSAT;
+    const qbf_res inner_wins = expansion->outer_qtype == QUANT_EXISTS ? QBF_RESULT_UNSAT : QBF_RESULT_SAT;
+
+    while (!expansion->lost) {
+        if (expansion->on_iteration != NULL) {
+            expansion->on_iteration(expansion->context);
+        }
+        logging_debug("expansion iteration %zu\n", expansion->num_instantiations);
+
+        statistics_start_timer(expansion->abstraction_time);
+        sat_res result = satsolver_sat(expansion->abstraction);
+        statistics_stop_and_record_timer(expansion->abstraction_time);
+        if (result == SATSOLVER_UNSATISFIABLE) {
+            return inner_wins;
+        }
+        assert(result == SATSOLVER_SATISFIABLE);
+
+        assume_candidate(expansion);
+        statistics_start_timer(expansion->verification_time);
+        result = satsolver_sat(expansion->verification);
+        statistics_stop_and_record_timer(expansion->verification_time);
+        if (result == SATSOLVER_UNSATISFIABLE) {
+            set_candidate_values(expansion);
+            return outer_wins;
+        }
+        assert(result == SATSOLVER_SATISFIABLE);
+
+        read_counterexample(expansion);
+        instantiate(expansion);
+    }
+    return inner_wins;
+}
+
+void expansion_print_statistics(Expansion* expansion) {
+    printf("Statistics for expansion of the %s block\n", expansion->outer_qtype == QUANT_EXISTS ? "existential" : "universal");
+    printf("    %zu instantiations, %zu gates instantiated, %zu instantiated gates shared\n",
+           expansion->num_instantiations,
+           expansion->num_instantiated_gates,
+           expansion->num_shared_gates);
+    printf("Abstraction\n");
+    statistics_print(expansion->abstraction_time);
+    printf("Verification\n");
+    statistics_print(expansion->verification_time);
+}
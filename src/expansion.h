@@ -0,0 +1,83 @@
+//
+//  expansion.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef expansion_h
+#define expansion_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "circuit.h"
+#include "map.h"
+#include "satsolver.h"
+#include "statistics.h"
+#include "vector.h"
+
+/**
+ * Counterexample guided expansion (as in RAReQS) for circuits whose quantifier
+ * prefix has at most one alternation, see circuit_is_2qbf.
+ *
+ * The player of the outermost (non-empty) block is the outer player, its goal
+ * is the output if it is existential and the negated output if it is
+ * universal. The abstraction is one incremental SAT instance over the
+ * variables of the outer player that contains the goal instantiated with every
+ * counterexample of the inner player found so far. A candidate, i.e., a model
+ * of the abstraction, is verified by a second SAT instance that contains the
+ * negated goal and assumes the candidate. A model of the verification is the
+ * next counterexample, if there is none, the candidate is winning. Once the
+ * abstraction is unsatisfiable, the inner player wins.
+ *
+ * Instantiations share structure: nodes that do not depend on the inner
+ * player are encoded once, the values of the counterexample are propagated,
+ * and gates with the same inputs (after propagation) get the same literal.
+ */
+typedef void (*expansion_callback)(void* context);
+
+typedef struct {
+    Circuit* circuit;
+    quantifier_type outer_qtype;
+    bool* inner;         // indexed by node, node depends on a variable of the inner player
+    bool* relevant;      // indexed by node, node is in the cone of the output
+
+    SATSolver* abstraction;
+    SATSolver* verification;
+    lit_t max_var;       // of abstraction, nodes keep their id and fresh literals follow
+    lit_t* instance;     // indexed by node, literal of the node in the current instantiation
+    map* gates;          // hash of the inputs to the instantiated gates with this hash
+    vector* instantiated_gates;
+    bool lost;           // an instantiation is constantly false for the outer player
+    int_vector* counterexamples;  // inner variables of every instantiation, separated by 0, NULL if not kept
+    expansion_callback on_iteration;  // called before every iteration, e.g., to write checkpoints
+    void* context;
+
+    // statistics
+    size_t num_instantiations;
+    size_t num_instantiated_gates;
+    size_t num_shared_gates;  // instantiated gates that were already encoded
+    Stats* abstraction_time;
+    Stats* verification_time;
+} Expansion;
+
+Expansion* expansion_init(Circuit*, bool keep_counterexamples);
+void expansion_free(Expansion*);
+
+/**
+ * Instantiates the goal with a counterexample given as literals of the inner
+ * variables, e.g., one kept by a previous run, see counterexamples. Variables
+ * that do not occur are false.
+ */
+void expansion_add_counterexample(Expansion*, const int_vector* counterexample);
+
+/**
+ * Solves the circuit. If the outer player wins, the values of its variables
+ * are set in the circuit, see circuit_get_value.
+ */
+qbf_res expansion_solve(Expansion*);
+
+void expansion_print_statistics(Expansion*);
+
+#endif /* expansion_h */
@@ -164,6 +164,8 @@ Fixpoint* fixpoint_init_from_aiger(aiger* instance) {
     fixpoint->options->preprocess = false;
     fixpoint->options->assignment_b_lit_minimization = true;
     fixpoint->options->use_combined_abstraction = true;
+    fixpoint->options->max_refinements = 0;  // literals after the abstraction are allocated by next_lit
+    fixpoint->options->core_minimization = CORE_MINIMIZATION_NONE;  // entries are minimized under incremental_lit, see minimize_by_dropping_literals
     
     fixpoint->prime_mapping = map_init();
     fixpoint->unprime_mapping = map_init();
@@ -216,15 +218,15 @@ static void push_incremental(Fixpoint* fixpoint) {
     
     satsolver_add(fixpoint->universal->negation, -fixpoint->incremental_lit);
     satsolver_add(fixpoint->universal->negation, -(lit_t)fixpoint->fixpoint->shared.id);
-    for (int_queue_element* iterator = fixpoint->universal_incremental.first; iterator != NULL; iterator = iterator->next) {
-        satsolver_add(fixpoint->universal->negation, iterator->value);
+    for (size_t i = 0; i < int_queue_count(&fixpoint->universal_incremental); i++) {
+        satsolver_add(fixpoint->universal->negation, int_queue_get(&fixpoint->universal_incremental, i));
     }
     satsolver_add(fixpoint->universal->negation, 0);
     
     satsolver_add(fixpoint->existential->negation, -fixpoint->incremental_lit);
     satsolver_add(fixpoint->existential->negation, -(lit_t)fixpoint->fixpoint_prime->shared.id);
-    for (int_queue_element* iterator = fixpoint->existential_incremental.first; iterator != NULL; iterator = iterator->next) {
-        satsolver_add(fixpoint->existential->negation, iterator->value);
+    for (size_t i = 0; i < int_queue_count(&fixpoint->existential_incremental); i++) {
+        satsolver_add(fixpoint->existential->negation, int_queue_get(&fixpoint->existential_incremental, i));
     }
     satsolver_add(fixpoint->existential->negation, 0);
 }
@@ -43,7 +43,8 @@
     vfprintf(stdout, format, arg);\
     va_end(arg);
 
-verbosity logging_verbosity = VERBOSITY_NORMAL;
+// per thread, such that independent solvers can run in parallel
+_Thread_local verbosity logging_verbosity = VERBOSITY_NORMAL;
 
 #ifdef LOGGING
 
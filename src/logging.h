@@ -38,7 +38,7 @@ void fixme(const char* format, ...);
 #define fixme(format, ...)
 #endif
 
-void logging_set_verbosity(verbosity);
+void logging_set_verbosity(verbosity);  // affects the calling thread only
 
 #ifdef LOGGING
 verbosity logging_get_verbosity(void);
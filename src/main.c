@@ -7,10 +7,13 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <unistd.h>
 #include "getopt.h"
 
+#include "batch.h"
 #include "solver.h"
 #include "qcir.h"
 #include "logging.h"
@@ -19,20 +22,47 @@
 
 static void print_usage(const char* name) {
     printf("usage: %s [options] file\n"
+           "       %s [options] --batch directory/list\n"
            "options:\n"
 #ifdef CERTIFICATION
            "  -c                        enable certification\n"
 #endif
            "  -v                        enable verbose output\n"
+           "  --engine mode             solving engine, mode is auto (expansion for 2QBF, abstraction\n"
+           "                            otherwise), abstraction, or expansion (default auto)\n"
            "  --preprocessing 1/0       enable/disable preprocessing (default 1)\n"
            "  --miniscoping 1/0         enable/disable miniscoping (default 0)\n"
+           "  --expansion N             expand innermost universal blocks with at most N variables (default 0)\n"
+           "  --dependency-scheme 1/0   enable/disable moving variables outwards by dependency analysis (default 0)\n"
            "  --statistics              show collected solving statistics\n"
+           "  --perf-counters           collect hardware performance counters (implies --statistics)\n"
            "  --partial-assignment      print satisfying assignment of outermost quantifier\n"
            "  --assignment-minimization mimimize abstraction entries based on assignments\n"
+           "  --max-refinements N       learned clauses per SAT solver before the least active ones\n"
+           "                            are retired, 0 keeps all (default 2000)\n"
+           "  --refinement-batch N      candidates per level that are evaluated by the inner levels\n"
+           "                            before their refinements are added together (default 1)\n"
+           "  --phase-guidance 1/0      order assumptions (and phases, if supported by the SAT solver)\n"
+           "                            by the recent UNSAT cores (default 0)\n"
+           "  --use-partial-deref 1/0   shrink entries by partial assignments of the SAT solver,\n"
+           "                            if supported (default 0)\n"
+           "  --core-minimization mode  minimize abstraction entries and UNSAT cores, mode is none,\n"
+           "                            deletion, or quickxplain (default none)\n"
+           "  --core-minimization-budget N\n"
+           "                            SAT calls per minimized core, 0 is unlimited (default 100)\n"
+           "  --batch directory/list    solve all *.qcir files in directory (or all files in list,\n"
+           "                            one per line) and print one CSV line per instance\n"
+           "  --jobs N                  number of instances solved concurrently in batch mode\n"
+           "                            (default number of processors)\n"
+           "  --delta file              extend the circuit by the QCIR file and solve again if the\n"
+           "                            previous result is UNSAT, can be given repeatedly\n"
+           "  --checkpoint file         periodically write the solver state to file\n"
+           "  --checkpoint-interval N   seconds between two checkpoints (default 600)\n"
+           "  --resume file             continue solving from a checkpoint instead of an input file\n"
 #ifdef PARALLEL_SOLVING
            "  --num-threads N           number of threads to use during solving (default 2)\n"
 #endif
-           "  -h/--help                 show this message and exit\n", name);
+           "  -h/--help                 show this message and exit\n", name, name);
 }
 
 static bool parse_boolean_argument(const char* cmd, const char* arg) {
@@ -50,6 +80,9 @@ int main(int argc, char * const argv[]) {
     FILE* file = NULL;
     SolverOptions* options = solver_get_default_options();
     size_t max_num = 0;
+    const char* batch = NULL;
+    long num_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    vector* deltas = vector_init();
     
     // Handling of command line arguments
     const char * ch;
@@ -64,12 +97,29 @@ int main(int argc, char * const argv[]) {
             logging_set_verbosity(VERBOSITY_ALL);
             break;
         
+        GETOPT_OPTARG("--engine"):
+            if (strcmp(optarg, "auto") == 0) {
+                options->engine = SOLVER_ENGINE_AUTO;
+            } else if (strcmp(optarg, "abstraction") == 0) {
+                options->engine = SOLVER_ENGINE_ABSTRACTION;
+            } else if (strcmp(optarg, "expansion") == 0) {
+                options->engine = SOLVER_ENGINE_EXPANSION;
+            } else {
+                logging_fatal("Wrong argument %s for %s, expect auto, abstraction, or expansion\n", optarg, ch);
+            }
+            break;
         GETOPT_OPTARG("--preprocessing"):
             options->preprocess = parse_boolean_argument(ch, optarg);
             break;
         GETOPT_OPTARG("--miniscoping"):
             options->miniscoping = parse_boolean_argument(ch, optarg);
             break;
+        GETOPT_OPTARG("--expansion"):
+            options->expansion = strtoul(optarg, NULL, 0);
+            break;
+        GETOPT_OPTARG("--dependency-scheme"):
+            options->dependency_scheme = parse_boolean_argument(ch, optarg);
+            break;
 #ifdef CERTIFICATION
         GETOPT_OPT("-c"):
             options->certify = 1;
@@ -78,6 +128,10 @@ int main(int argc, char * const argv[]) {
         GETOPT_OPT("--statistics"):
             options->statistics = 1;
             break;
+        GETOPT_OPT("--perf-counters"):
+            options->perf_counters = true;
+            options->statistics = 1;
+            break;
         GETOPT_OPT("--partial-assignment"):
             options->partial_assignment = true;
             break;
@@ -91,11 +145,71 @@ int main(int argc, char * const argv[]) {
             break;
 
             
+        GETOPT_OPTARG("--batch"):
+            batch = optarg;
+            break;
+        GETOPT_OPTARG("--jobs"):
+            num_jobs = strtol(optarg, NULL, 0);
+            if (num_jobs <= 0) {
+                logging_error("Illegal number of jobs %s\n", optarg);
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        GETOPT_OPTARG("--delta"):
+            vector_add(deltas, (void*)optarg);
+            options->extensible = true;
+            break;
+        GETOPT_OPTARG("--checkpoint"):
+            options->checkpoint = optarg;
+            break;
+        GETOPT_OPTARG("--checkpoint-interval"):
+            options->checkpoint_interval = strtod(optarg, NULL);
+            if (options->checkpoint_interval <= 0.0) {
+                logging_fatal("Wrong argument %s for %s, expect a positive number of seconds\n", optarg, ch);
+            }
+            break;
+        GETOPT_OPTARG("--resume"):
+            options->resume = optarg;
+            break;
+            
         GETOPT_OPTARG("--assignment-minimization"):
             options->assignment_b_lit_minimization = parse_boolean_argument(ch, optarg);
             break;
+        GETOPT_OPTARG("--max-refinements"):
+            options->max_refinements = strtoul(optarg, NULL, 0);
+            break;
+        GETOPT_OPTARG("--refinement-batch"):
+            options->refinement_batch = strtoul(optarg, NULL, 0);
+            if (options->refinement_batch == 0) {
+                logging_fatal("Wrong argument %s for %s, expect a positive number\n", optarg, ch);
+            }
+            break;
+        GETOPT_OPTARG("--core-minimization"):
+            if (strcmp(optarg, "none") == 0) {
+                options->core_minimization = CORE_MINIMIZATION_NONE;
+            } else if (strcmp(optarg, "deletion") == 0) {
+                options->core_minimization = CORE_MINIMIZATION_DELETION;
+            } else if (strcmp(optarg, "quickxplain") == 0) {
+                options->core_minimization = CORE_MINIMIZATION_QUICKXPLAIN;
+            } else {
+                logging_fatal("Wrong argument %s for %s, expect none, deletion, or quickxplain\n", optarg, ch);
+            }
+            break;
+        GETOPT_OPTARG("--core-minimization-budget"):
+            options->core_minimization_budget = strtoul(optarg, NULL, 0);
+            break;
         GETOPT_OPTARG("--use-partial-deref"):
             options->use_partial_deref = parse_boolean_argument(ch, optarg);
+#ifndef SATSOLVER_PARTIAL_DEREF
+            if (options->use_partial_deref) {
+                logging_warn("Partial dereferencing is not supported by the SAT solver backend and is ignored\n");
+                options->use_partial_deref = false;
+            }
+#endif
+            break;
+        GETOPT_OPTARG("--phase-guidance"):
+            options->phase_guidance = parse_boolean_argument(ch, optarg);
             break;
         
 #ifdef PARALLEL_SOLVING
@@ -118,11 +232,64 @@ int main(int argc, char * const argv[]) {
         }
     }
     
-    if (!options->preprocess) {
+    if (options->extensible && (options->certify || batch != NULL)) {
+        logging_error("Extensions are not supported with certification or in batch mode\n");
+        free(options);
+        return 1;
+    }
+    
+    if ((options->checkpoint != NULL || options->resume != NULL)
+        && (options->certify || options->extensible || options->partial_assignment || batch != NULL)) {
+        logging_error("Checkpoints are not supported with certification, extensions, partial assignments, or in batch mode\n");
+        free(options);
+        return 1;
+    }
+#ifdef PARALLEL_SOLVING
+    if (options->checkpoint != NULL) {
+        logging_error("Checkpoints are not supported with parallel solving\n");
+        free(options);
+        return 1;
+    }
+#endif
+    if (options->checkpoint != NULL && options->max_refinements == 0) {
+        logging_warn("Learned clauses are only written to checkpoints if they are retired, see --max-refinements\n");
+    }
+    
+    if (!options->preprocess && !options->extensible) {
         logging_warn("Preprocessing is disabled, this will likely harm solving performance\n");
     }
     
-    if (optind < argc) {
+    if (batch != NULL) {
+        if (options->certify || options->partial_assignment || options->statistics) {
+            logging_error("Certification, partial assignments, and statistics are not supported in batch mode\n");
+            free(options);
+            return 1;
+        }
+        if (optind < argc) {
+            logging_warn("Positional arguments are ignored in batch mode\n");
+        }
+        vector* instances = batch_collect_instances(batch);
+        if (instances == NULL) {
+            free(options);
+            return 1;
+        }
+        if (logging_get_verbosity() == VERBOSITY_NORMAL) {
+            // warnings of the individual instances would interleave with the results
+            logging_set_verbosity(VERBOSITY_NONE);
+        }
+        size_t num_failed = batch_solve(instances, options, num_jobs > 0 ? (size_t)num_jobs : 1, stdout);
+        batch_free_instances(instances);
+        free(options);
+        return num_failed > 0 ? 1 : 0;
+    }
+    
+    if (options->resume != NULL) {
+        // the checkpoint contains the circuit
+        file_name = options->resume;
+        for (int i = optind; i < argc; i++) {
+            logging_warn("Positional argument \"%s\" is ignored when resuming\n", argv[i]);
+        }
+    } else if (optind < argc) {
         file_name = argv[optind];
         if (optind + 1 < argc) {
             logging_warn("More than one positional argument given, see --help for more information\n");
@@ -161,6 +328,34 @@ int main(int argc, char * const argv[]) {
     
     qbf_res res = solver_sat(solver);
     
+    // bound-increasing mode, every extension is solved while the result is UNSAT
+    for (size_t i = 0; i < vector_count(deltas) && res == QBF_RESULT_UNSAT; i++) {
+        printf("r UNSAT\n");
+        fflush(stdout);
+        Circuit* delta = circuit_init();
+        statistics_start_timer(parsing_time);
+        error = circuit_open_and_read_qcir_file(delta, vector_get(deltas, i), true);
+        statistics_stop_and_record_timer(parsing_time);
+        if (error) {
+            circuit_free(delta);
+            solver_free(solver);
+            return 1;
+        }
+        solver_extend(solver, delta);
+        circuit_free(delta);
+        res = solver_sat(solver);
+    }
+    vector_free(deltas);
+    
+    int_vector* partial_assignment = solver_get_partial_assignment(solver);
+    if (partial_assignment != NULL) {
+        printf("V ");
+        for (size_t i = 0; i < int_vector_count(partial_assignment); i++) {
+            printf("%d ", int_vector_get(partial_assignment, i));
+        }
+        printf("0\n");
+    }
+    
     if (options->statistics) {
         printf("Parsing took ");
         statistics_print_time(parsing_time);
@@ -185,5 +380,8 @@ int main(int argc, char * const argv[]) {
         }
     }
     
+    solver_free(solver);
+    free(options);
+    
     return res;
 }
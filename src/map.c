@@ -1,14 +1,15 @@
 #include <assert.h>
+#include <stdint.h>
 
 #include "map.h"
 #include "logging.h"
 
 
-#define INITIAL_MAP_SIZE 10
+#define INITIAL_MAP_SIZE 16
 
 // From https://gist.github.com/badboy/6267743
-static int hash32shiftmult(int key) {
-    int c2 = 0x27d4eb2d; // a prime or an odd constant
+static uint32_t hash32shiftmult(uint32_t key) {
+    uint32_t c2 = 0x27d4eb2d; // a prime or an odd constant
     key = (key ^ 61) ^ (key >> 16);
     key = key + (key << 3);
     key = key ^ (key >> 4);
@@ -18,30 +19,50 @@ static int hash32shiftmult(int key) {
 }
 
 static size_t hash_function(int key, size_t size) {
-    return (size_t)hash32shiftmult(key) % size;
+    assert((size & (size - 1)) == 0);
+    return (size_t)hash32shiftmult((uint32_t)key) & (size - 1);
+}
+
+// Keep load factor below 3/4 such that probe sequences stay short
+static bool needs_resize(size_t count, size_t size) {
+    return 4 * count > 3 * size;
+}
+
+static size_t size_for_count(size_t count) {
+    size_t size = INITIAL_MAP_SIZE;
+    while (needs_resize(count, size)) {
+        size *= 2;
+    }
+    return size;
 }
 
 map* map_init() {
-    return map_init_size(INITIAL_MAP_SIZE);
+    return map_init_size(0);
 }
 
 map* map_init_size(size_t size) {
     map* container = malloc(sizeof(map));
-    container->data = calloc(sizeof(map_entry*), size);
+    container->size = size_for_count(size);
+    container->data = calloc(container->size, sizeof(map_entry));
     container->count = 0;
-    container->size = size;
     return container;
 }
 
-static map_entry* map_get_entry(const map* container, int key) {
-    size_t hash = hash_function(key, container->size);
-    assert(hash < container->size);
-    
-    map_entry* entry = container->data[hash];
-    while (entry != NULL && entry->key != key) {
-        entry = entry->next;
+/**
+ * Returns the slot containing key, or the empty slot where key would be inserted.
+ */
+static size_t map_find_slot(const map* container, int key) {
+    const size_t mask = container->size - 1;
+    size_t slot = hash_function(key, container->size);
+    while (container->data[slot].occupied && container->data[slot].key != key) {
+        slot = (slot + 1) & mask;
     }
-    return entry;
+    return slot;
+}
+
+static map_entry* map_get_entry(const map* container, int key) {
+    map_entry* entry = &container->data[map_find_slot(container, key)];
+    return entry->occupied ? entry : NULL;
 }
 
 bool map_contains(const map* container, int key) {
@@ -57,6 +78,11 @@ void* map_get(const map* container, int key) {
     return NULL;
 }
 
+void** map_get_reference(map* container, int key) {
+    map_entry* entry = map_get_entry(container, key);
+    return entry != NULL ? &entry->data : NULL;
+}
+
 // Same as map_add, but works only if the element is already in the map
 void map_update(map* container, int key, void* data) {
     map_entry* entry = map_get_entry(container, key);
@@ -65,82 +91,97 @@ void map_update(map* container, int key, void* data) {
 }
 
 void map_add(map* container, int key, void* data) {
-    assert(!map_get(container, key));
-    size_t hash = hash_function(key, container->size);
-    assert(hash < container->size);
-    
-    map_entry* new_entry = malloc(sizeof(map_entry));
-    new_entry->key = key;
-    new_entry->data = data;
-    new_entry->next = container->data[hash];
-    container->data[hash] = new_entry;
-    
-    container->count++;
-    
-    if (container->count > container->size + container->size / 2) {
+    assert(!map_contains(container, key));
+    if (needs_resize(container->count + 1, container->size)) {
         map_resize(container, 2 * container->size);
     }
+
+    map_entry* entry = &container->data[map_find_slot(container, key)];
+    assert(!entry->occupied);
+    entry->key = key;
+    entry->data = data;
+    entry->occupied = true;
+
+    container->count++;
 }
 
 void map_resize(map* container, size_t new_size) {
     logging_debug("Resizing container to size %zu\n", new_size);
     size_t old_size = container->size;
-    map_entry** old_data = container->data;
-    
-    container->size = new_size;
-    container->data = calloc(sizeof(map_entry*), new_size);
-    
+    map_entry* old_data = container->data;
+
+    // new_size is rounded up to the next power of two that can hold all entries
+    size_t size = size_for_count(container->count);
+    while (size < new_size) {
+        size *= 2;
+    }
+    container->size = size;
+    container->data = calloc(size, sizeof(map_entry));
+
     for (size_t i = 0; i < old_size; i++) {
-        map_entry* entry = old_data[i];
-        while (entry != NULL) {
-            map_entry* next = entry->next;
-            size_t new_hash = hash_function(entry->key, container->size);
-            assert(new_hash < container->size);
-            
-            entry->next = container->data[new_hash];
-            container->data[new_hash] = entry;
-            
-            entry = next;
+        if (!old_data[i].occupied) {
+            continue;
         }
+        map_entry* entry = &container->data[map_find_slot(container, old_data[i].key)];
+        assert(!entry->occupied);
+        *entry = old_data[i];
     }
-    
-    free(old_data);
-}
 
-static void map_free_entry(map_entry* entry) {
-    free(entry);
+    free(old_data);
 }
 
 void map_remove(map* container, int key) {
-    size_t hash = hash_function(key, container->size);
-    assert(hash < container->size);
-    
-    map_entry* entry = container->data[hash];
-    map_entry* prev = NULL;
-    while (entry != NULL && entry->key != key) {
-        prev = entry;
-        entry = entry->next;
-    }
-    if (entry == NULL) {
+    const size_t mask = container->size - 1;
+    size_t slot = map_find_slot(container, key);
+    if (!container->data[slot].occupied) {
         return;
     }
-    
-    if (prev == NULL) {
-        container->data[hash] = entry->next;
-    } else {
-        prev->next = entry->next;
+
+    // Backward shift deletion: move following entries of the probe sequence
+    // into the hole unless their home slot lies cyclically in (slot, next].
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & mask;
+        if (!container->data[next].occupied) {
+            break;
+        }
+        const size_t home = hash_function(container->data[next].key, container->size);
+        const bool stays = (slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next);
+        if (!stays) {
+            container->data[slot] = container->data[next];
+            slot = next;
+        }
     }
-    
-    map_free_entry(entry);
+    container->data[slot].occupied = false;
+    container->count--;
 }
 
 void map_free(map* container) {
-    for (size_t i = 0; i < container->size; i++) {
-        map_entry* next_e;
-        for (map_entry* e = container->data[i]; e != NULL; e = next_e) {
-            next_e = e->next;
-            map_free_entry(e);
-        }
-    }
+    free(container->data);
     free(container);
 }
+
+
+// Batch operations
+
+void map_get_batch(const map* container, const int* keys, size_t num_keys, void** results) {
+    for (size_t i = 0; i < num_keys; i++) {
+        results[i] = map_get(container, keys[i]);
+    }
+}
+
+void map_add_batch(map* container, const int* keys, void* const* data, size_t num_keys) {
+    // resize at most once
+    if (needs_resize(container->count + num_keys, container->size)) {
+        map_resize(container, size_for_count(container->count + num_keys));
+    }
+    for (size_t i = 0; i < num_keys; i++) {
+        map_add(container, keys[i], data[i]);
+    }
+}
+
+void map_update_batch(map* container, const int* keys, void* const* data, size_t num_keys) {
+    for (size_t i = 0; i < num_keys; i++) {
+        map_update(container, keys[i], data[i]);
+    }
+}
@@ -4,19 +4,21 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-struct map_entry;
-typedef struct map_entry map_entry;
-
-struct map_entry {
-    int        key;
-    void*      data;
-    map_entry* next;
-};
+/**
+ * Hash map from int keys to pointers using open addressing with linear
+ * probing. Entries are stored inline in a single array whose size is a
+ * power of two, hence, there is no allocation per entry.
+ */
+typedef struct {
+    int   key;
+    bool  occupied;
+    void* data;
+} map_entry;
 
 typedef struct {
-    map_entry** data;
-    size_t      size;
-    size_t      count;
+    map_entry* data;
+    size_t     size;   // number of slots, always a power of two
+    size_t     count;  // number of occupied slots
 } map;
 
 map* map_init(void);
@@ -28,4 +30,15 @@ void map_update(map* container, int key, void* data);
 void map_resize(map* container, size_t new_size);
 void map_remove(map* container, int key);
 void map_free(map* container);
+
+/**
+ * Returns a reference to the data stored for key, NULL if key is not contained.
+ * The reference is invalidated by any subsequent map_add, map_remove, or map_resize.
+ */
+void** map_get_reference(map* container, int key);
+
+// Batch operations, results[i]/data[i] corresponds to keys[i]
+void map_get_batch(const map* container, const int* keys, size_t num_keys, void** results);
+void map_add_batch(map* container, const int* keys, void* const* data, size_t num_keys);
+void map_update_batch(map* container, const int* keys, void* const* data, size_t num_keys);
 #endif
@@ -0,0 +1,354 @@
+//
+//  microbench.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bit_vector.h"
+#include "circuit.h"
+#include "map.h"
+#include "queue.h"
+#include "statistics.h"
+#include "vector.h"
+#include "logging.h"
+#include "getopt.h"
+
+#define MICROBENCH_SEED 0x9E3779B97F4A7C15ULL
+
+typedef struct {
+    uint64_t state;
+} rng;
+
+static uint64_t rng_next(rng* r) {
+    // xorshift64*
+    r->state ^= r->state >> 12;
+    r->state ^= r->state << 25;
+    r->state ^= r->state >> 27;
+    return r->state * 0x2545F4914F6CDD1DULL;
+}
+
+static size_t rng_below(rng* r, size_t bound) {
+    return (size_t)(rng_next(r) % bound);
+}
+
+// Prevents the compiler from optimizing away the benchmarked operations
+static volatile size_t sink;
+
+static bool csv_output = false;
+static double scale = 1.0;  // multiplier for the number of operations per benchmark
+
+static Stats* timer;
+
+static void benchmark_start() {
+    statistics_start_timer(timer);
+}
+
+/**
+ * Stops the timer and reports the time per operation as well as the throughput.
+ */
+static void benchmark_stop_and_report(const char* name, size_t size, size_t operations) {
+    const double before = timer->accumulated_value;
+    statistics_stop_and_record_timer(timer);
+    const double seconds = timer->accumulated_value - before;
+    const double ns_per_op = seconds * 1e9 / (double)operations;
+    const double mops = seconds > 0 ? (double)operations / seconds / 1e6 : 0.0;
+    if (csv_output) {
+        printf("%s,%zu,%zu,%f,%f\n", name, size, operations, ns_per_op, mops);
+    } else {
+        printf("%-32s %10zu %12zu %12.2f ns/op %10.2f Mop/s\n", name, size, operations, ns_per_op, mops);
+    }
+}
+
+static size_t num_operations(size_t base) {
+    size_t operations = (size_t)((double)base * scale);
+    return operations > 0 ? operations : 1;
+}
+
+
+// bit_vector
+
+static void benchmark_bit_vector(size_t size) {
+    rng r = { MICROBENCH_SEED };
+    const size_t operations = num_operations(1 << 22);
+    size_t* indices = malloc(sizeof(size_t) * operations);
+    for (size_t i = 0; i < operations; i++) {
+        indices[i] = rng_below(&r, size);
+    }
+
+    bit_vector* bv = bit_vector_init(0, size);
+    benchmark_start();
+    for (size_t i = 0; i < operations; i++) {
+        bit_vector_add(bv, indices[i]);
+    }
+    benchmark_stop_and_report("bit_vector_add", size, operations);
+
+    size_t found = 0;
+    benchmark_start();
+    for (size_t i = 0; i < operations; i++) {
+        found += bit_vector_contains(bv, rng_below(&r, size)) ? 1 : 0;
+    }
+    benchmark_stop_and_report("bit_vector_contains", size, operations);
+    sink = found;
+
+    // sparse vector with ~1% density as it is typical for abstraction entries
+    bit_vector_reset(bv);
+    for (size_t i = 0; i < size / 100 + 1; i++) {
+        bit_vector_add(bv, rng_below(&r, size));
+    }
+    const size_t iterations = num_operations((1 << 24) / size + 1);
+    size_t sum = 0;
+    benchmark_start();
+    for (size_t k = 0; k < iterations; k++) {
+        for (size_t i = bit_vector_init_iteration(bv); bit_vector_iterate(bv); i = bit_vector_next(bv)) {
+            sum += i;
+        }
+    }
+    benchmark_stop_and_report("bit_vector_iterate (1% dense)", size, iterations);
+    sink = sum;
+
+    bit_vector* other = bit_vector_init(0, size);
+    for (size_t i = 0; i < size / 10 + 1; i++) {
+        bit_vector_add(other, rng_below(&r, size));
+    }
+    benchmark_start();
+    for (size_t k = 0; k < iterations; k++) {
+        bit_vector_update_or(bv, other);
+    }
+    benchmark_stop_and_report("bit_vector_update_or", size, iterations);
+
+    bit_vector_free(other);
+    bit_vector_free(bv);
+    free(indices);
+}
+
+
+// map
+
+static void benchmark_map(size_t size) {
+    rng r = { MICROBENCH_SEED };
+    const size_t operations = num_operations(1 << 21);
+    map* m = map_init();
+    for (size_t i = 1; i <= size; i++) {
+        map_add(m, (int)i, (void*)i);
+    }
+
+    size_t sum = 0;
+    benchmark_start();
+    for (size_t i = 0; i < operations; i++) {
+        const int key = (int)rng_below(&r, size) + 1;
+        sum += (size_t)map_get(m, key);
+    }
+    benchmark_stop_and_report("map_get", size, operations);
+    sink = sum;
+
+    benchmark_start();
+    for (size_t i = 0; i < operations; i++) {
+        const int key = (int)rng_below(&r, size) + 1;
+        map_update(m, key, (void*)(i + 1));
+    }
+    benchmark_stop_and_report("map_update", size, operations);
+
+    map_free(m);
+}
+
+
+// int_queue
+
+static void benchmark_int_queue(size_t size) {
+    const size_t rounds = num_operations((1 << 22) / size + 1);
+    int_queue queue;
+    int_queue_init(&queue);
+
+    size_t sum = 0;
+    benchmark_start();
+    for (size_t k = 0; k < rounds; k++) {
+        for (size_t i = 0; i < size; i++) {
+            int_queue_push(&queue, (int)i);
+        }
+        while (!int_queue_is_empty(&queue)) {
+            sum += (size_t)int_queue_pop(&queue);
+        }
+    }
+    benchmark_stop_and_report("int_queue_push+pop", size, rounds * size);
+    sink = sum;
+}
+
+
+// int_vector
+
+static void benchmark_int_vector(size_t size) {
+    rng r = { MICROBENCH_SEED };
+    const size_t operations = num_operations(1 << 22);
+    int_vector* vec = int_vector_init();
+    for (size_t i = 0; i < size; i++) {
+        int_vector_add(vec, (int)(2 * i));  // sorted, only even values
+    }
+    assert(int_vector_is_sorted(vec));
+
+    size_t found = 0;
+    benchmark_start();
+    for (size_t i = 0; i < operations; i++) {
+        found += int_vector_contains_sorted(vec, (int)rng_below(&r, 2 * size)) ? 1 : 0;
+    }
+    benchmark_stop_and_report("int_vector_contains_sorted", size, operations);
+    sink = found;
+
+    int_vector_free(vec);
+}
+
+
+// circuit evaluation
+
+/**
+ * Builds a prenex circuit with the given number of quantifier levels, each
+ * having width variables, followed by depth layers of width gates each.
+ * Gates alternate between AND and OR by layer and draw fan_in inputs from the
+ * previous layer.
+ */
+static Circuit* build_synthetic_circuit(rng* r, size_t levels, size_t width, size_t depth, size_t fan_in) {
+    const size_t num_vars = levels * width;
+    const size_t max_num = num_vars + depth * width + 1;
+    Circuit* circuit = circuit_init();
+    circuit_adjust(circuit, max_num);
+
+    var_t next_id = 1;
+    for (size_t level = 0; level < levels; level++) {
+        Scope* scope = circuit_init_scope(circuit, level % 2 == 0 ? QUANT_EXISTS : QUANT_FORALL);
+        for (size_t i = 0; i < width; i++) {
+            circuit_new_var(circuit, scope, next_id++);
+        }
+    }
+
+    var_t layer_start = 1;
+    size_t layer_size = num_vars;
+    for (size_t layer = 0; layer < depth; layer++) {
+        const var_t current_start = next_id;
+        for (size_t i = 0; i < width; i++) {
+            Gate* gate = circuit_add_gate(circuit, next_id++, layer % 2 == 0 ? GATE_AND : GATE_OR);
+            for (size_t j = 0; j < fan_in; j++) {
+                const var_t input = layer_start + (var_t)rng_below(r, layer_size);
+                circuit_add_to_gate(circuit, gate, create_lit(input, rng_below(r, 2) == 0));
+            }
+        }
+        layer_start = current_start;
+        layer_size = width;
+    }
+
+    // output combines the last layer
+    Gate* output = circuit_add_gate(circuit, next_id, GATE_AND);
+    for (size_t i = 0; i < layer_size; i++) {
+        circuit_add_to_gate(circuit, output, (lit_t)(layer_start + i));
+    }
+    circuit_set_output(circuit, (lit_t)next_id);
+    circuit_reencode(circuit);
+    return circuit;
+}
+
+static void benchmark_circuit_evaluate(size_t width, size_t depth) {
+    rng r = { MICROBENCH_SEED };
+    const size_t levels = 4;
+    Circuit* circuit = build_synthetic_circuit(&r, levels, width, depth, 3);
+    const size_t iterations = num_operations((1 << 22) / (width * depth) + 1);
+
+    benchmark_start();
+    for (size_t k = 0; k < iterations; k++) {
+        // assign variables level-wise as done during solving
+        for (size_t i = 0; i < vector_count(circuit->vars); i++) {
+            Var* var = vector_get(circuit->vars, i);
+            if (var == NULL) {
+                continue;
+            }
+            const int level = (int)var->scope->scope_id;
+            circuit_set_value(circuit, var->shared.id, rng_below(&r, 2) == 0 ? level : -level);
+        }
+        circuit_evaluate_max(circuit, (int)circuit->max_scope_id);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "circuit_evaluate_max (depth %zu)", depth);
+    benchmark_stop_and_report(name, circuit->max_num, iterations);
+    sink = (size_t)circuit_get_value(circuit, lit_to_var(circuit->output));
+
+    circuit_free(circuit);
+}
+
+
+static void print_usage(const char* name) {
+    printf("usage: %s [options]\n\n"
+           "Runs microbenchmarks of the data structures used during solving and\n"
+           "reports the time per operation and the throughput.\n\n"
+           "options:\n"
+           "  --csv                     print results as CSV\n"
+           "  --scale F                 multiply the number of operations by F (default 1.0)\n"
+           "  -h/--help                 show this message and exit\n", name);
+}
+
+int main(int argc, char* const argv[]) {
+    const char* ch;
+    while ((ch = GETOPT(argc, argv)) != NULL) {
+        GETOPT_SWITCH(ch) {
+        GETOPT_OPT("-h"):
+        GETOPT_OPT("--help"):
+            print_usage(argv[0]);
+            return 0;
+            break;
+        GETOPT_OPT("--csv"):
+            csv_output = true;
+            break;
+        GETOPT_OPTARG("--scale"):
+            scale = strtod(optarg, NULL);
+            if (scale <= 0) {
+                logging_error("Illegal scale %s\n", optarg);
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        GETOPT_MISSING_ARG:
+            printf("missing argument to %s\n", ch);
+            /* FALLTHROUGH */
+        GETOPT_DEFAULT:
+            printf("unknown argument %s\n", ch);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    timer = statistics_init(10000);
+
+    if (csv_output) {
+        printf("benchmark,size,operations,ns_per_op,mops_per_s\n");
+    } else {
+        printf("%-32s %10s %12s %18s %16s\n", "benchmark", "size", "operations", "time", "throughput");
+    }
+
+    const size_t sizes[] = { 64, 1024, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchmark_bit_vector(sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchmark_map(sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchmark_int_queue(sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        benchmark_int_vector(sizes[i]);
+    }
+
+    const size_t widths[] = { 100, 1000, 10000 };
+    const size_t depths[] = { 4, 16, 64 };
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        for (size_t j = 0; j < sizeof(depths) / sizeof(depths[0]); j++) {
+            benchmark_circuit_evaluate(widths[i], depths[j]);
+        }
+    }
+
+    statistics_free(timer);
+    return 0;
+}
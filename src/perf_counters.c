@@ -0,0 +1,213 @@
+//
+//  perf_counters.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include "perf_counters.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* counter_names[PERF_COUNTER_NUM] = {
+    "Cycles",
+    "Instructions",
+    "Cache misses",
+    "Branch misses"
+};
+
+typedef enum {
+    GROUP_UNINITIALIZED = 0,
+    GROUP_AVAILABLE,
+    GROUP_UNAVAILABLE
+} group_state;
+
+// counters measure the calling thread, so the group is opened per thread
+static _Thread_local group_state state = GROUP_UNINITIALIZED;
+
+#ifdef __linux__
+
+static const uint64_t counter_configs[PERF_COUNTER_NUM] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static _Thread_local int group_fds[PERF_COUNTER_NUM];
+static _Thread_local size_t num_opened = 0;  // number of counters in group, read order follows group_fds
+
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = (group_fd == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void open_group(void) {
+    assert(state == GROUP_UNINITIALIZED);
+    for (size_t i = 0; i < PERF_COUNTER_NUM; i++) {
+        group_fds[i] = -1;
+    }
+
+    group_fds[PERF_COUNTER_CYCLES] = open_counter(counter_configs[PERF_COUNTER_CYCLES], -1);
+    if (group_fds[PERF_COUNTER_CYCLES] < 0) {
+        logging_warn("hardware performance counters are not available (check /proc/sys/kernel/perf_event_paranoid)\n");
+        state = GROUP_UNAVAILABLE;
+        return;
+    }
+    num_opened = 1;
+
+    // remaining counters are optional, e.g., cache misses are not exposed in some virtual machines
+    for (size_t i = PERF_COUNTER_CYCLES + 1; i < PERF_COUNTER_NUM; i++) {
+        group_fds[i] = open_counter(counter_configs[i], group_fds[PERF_COUNTER_CYCLES]);
+        if (group_fds[i] >= 0) {
+            num_opened++;
+        } else {
+            logging_info("performance counter \"%s\" is not available\n", counter_names[i]);
+        }
+    }
+
+    ioctl(group_fds[PERF_COUNTER_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group_fds[PERF_COUNTER_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    state = GROUP_AVAILABLE;
+}
+
+/**
+ * Reads the current values of all counters in the group, scaled to account for
+ * multiplexing of the hardware counters.
+ */
+static void read_group(uint64_t* values) {
+    assert(state == GROUP_AVAILABLE);
+    uint64_t buffer[3 + PERF_COUNTER_NUM];
+    memset(values, 0, PERF_COUNTER_NUM * sizeof(uint64_t));
+
+    ssize_t size = read(group_fds[PERF_COUNTER_CYCLES], buffer, sizeof(buffer));
+    if (size < (ssize_t)(3 * sizeof(uint64_t))) {
+        return;
+    }
+
+    const uint64_t nr = buffer[0];
+    const uint64_t time_enabled = buffer[1];
+    const uint64_t time_running = buffer[2];
+    assert(nr == num_opened);
+
+    size_t position = 0;
+    for (size_t i = 0; i < PERF_COUNTER_NUM && position < nr; i++) {
+        if (group_fds[i] < 0) {
+            continue;
+        }
+        uint64_t value = buffer[3 + position++];
+        if (time_running > 0 && time_running < time_enabled) {
+            value = (uint64_t)((double)value * ((double)time_enabled / (double)time_running));
+        }
+        values[i] = value;
+    }
+}
+
+static bool counter_is_available(perf_counter_type type) {
+    return state == GROUP_AVAILABLE && group_fds[type] >= 0;
+}
+
+#else
+
+static void open_group(void) {
+    logging_warn("hardware performance counters are only supported on Linux\n");
+    state = GROUP_UNAVAILABLE;
+}
+
+static void read_group(uint64_t* values) {
+    memset(values, 0, PERF_COUNTER_NUM * sizeof(uint64_t));
+}
+
+static bool counter_is_available(perf_counter_type type) {
+    return false;
+}
+
+#endif
+
+PerfCounters* perf_counters_init() {
+    if (state == GROUP_UNINITIALIZED) {
+        open_group();
+    }
+    PerfCounters* counters = malloc(sizeof(PerfCounters));
+    memset(counters->values, 0, sizeof(counters->values));
+    memset(counters->start, 0, sizeof(counters->start));
+    counters->calls_num = 0;
+    counters->running = false;
+    return counters;
+}
+
+void perf_counters_free(PerfCounters* counters) {
+    free(counters);
+}
+
+bool perf_counters_available() {
+    return state == GROUP_AVAILABLE;
+}
+
+void perf_counters_start(PerfCounters* counters) {
+    if (counters == NULL || state != GROUP_AVAILABLE) {
+        return;
+    }
+    assert(!counters->running);
+    counters->running = true;
+    read_group(counters->start);
+}
+
+void perf_counters_stop_and_record(PerfCounters* counters) {
+    if (counters == NULL || state != GROUP_AVAILABLE) {
+        return;
+    }
+    assert(counters->running);
+    counters->running = false;
+    uint64_t current[PERF_COUNTER_NUM];
+    read_group(current);
+    for (size_t i = 0; i < PERF_COUNTER_NUM; i++) {
+        if (current[i] > counters->start[i]) {
+            counters->values[i] += current[i] - counters->start[i];
+        }
+    }
+    counters->calls_num++;
+}
+
+void perf_counters_print(PerfCounters* counters) {
+    if (counters == NULL || state != GROUP_AVAILABLE) {
+        // unavailability was already reported on initialization
+        return;
+    }
+    for (size_t i = 0; i < PERF_COUNTER_NUM; i++) {
+        printf("    %-13s: ", counter_names[i]);
+        if (!counter_is_available(i)) {
+            printf("n/a\n");
+            continue;
+        }
+        printf("%llu", (unsigned long long)counters->values[i]);
+        if (i == PERF_COUNTER_INSTRUCTIONS && counters->values[PERF_COUNTER_CYCLES] > 0) {
+            printf(" (IPC %.2f)", (double)counters->values[i] / (double)counters->values[PERF_COUNTER_CYCLES]);
+        } else if (i == PERF_COUNTER_BRANCH_MISSES && counters->values[PERF_COUNTER_INSTRUCTIONS] > 0) {
+            printf(" (%.2f per 1k instructions)", 1000.0 * (double)counters->values[i] / (double)counters->values[PERF_COUNTER_INSTRUCTIONS]);
+        } else if (i == PERF_COUNTER_CACHE_MISSES && counters->values[PERF_COUNTER_INSTRUCTIONS] > 0) {
+            printf(" (%.2f per 1k instructions)", 1000.0 * (double)counters->values[i] / (double)counters->values[PERF_COUNTER_INSTRUCTIONS]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,48 @@
+//
+//  perf_counters.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef perf_counters_h
+#define perf_counters_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    PERF_COUNTER_CYCLES = 0,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_NUM
+} perf_counter_type;
+
+/**
+ * Accumulates hardware performance counters (via Linux perf_event_open) over
+ * all start/stop intervals, analogous to Stats used as a timer.
+ *
+ * All instances share one counter group that counts user-space events of the
+ * thread that created the first instance. Counters are unavailable on other
+ * platforms or when the kernel denies access, in which case every operation
+ * is a no-op and a single warning is emitted on initialization.
+ *
+ * All functions accept NULL, such that the counters can be disabled by not
+ * initializing them.
+ */
+typedef struct {
+    uint64_t values[PERF_COUNTER_NUM];
+    uint64_t start[PERF_COUNTER_NUM];
+    int calls_num;
+    bool running;
+} PerfCounters;
+
+PerfCounters* perf_counters_init(void);
+void perf_counters_free(PerfCounters*);
+void perf_counters_start(PerfCounters*);
+void perf_counters_stop_and_record(PerfCounters*);
+bool perf_counters_available(void);
+void perf_counters_print(PerfCounters*);
+
+#endif /* perf_counters_h */
@@ -308,7 +308,7 @@ int circuit_open_and_read_qcir_file(Circuit* circuit, const char* file_name, boo
     }
     
     if (!file) {
-        logging_fatal("File \"%s\" does not exist!\n", file_name);
+        logging_error("File \"%s\" does not exist!\n", file_name);
         return -1;
     }
     
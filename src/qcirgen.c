@@ -0,0 +1,410 @@
+//
+//  qcirgen.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "circuit.h"
+#include "vector.h"
+#include "logging.h"
+#include "getopt.h"
+
+typedef struct {
+    size_t levels;          // alternation depth (number of quantifier blocks)
+    size_t width;           // variables per quantifier block
+    size_t fan_in;          // inputs per gate
+    size_t depth;           // number of gate layers
+    size_t gates_per_layer;
+    double sharing;         // probability that a gate input reuses an arbitrary earlier node
+    size_t scope_nodes;     // number of components with local quantifiers, 0 for prenex
+    quantifier_type outermost;
+    uint64_t seed;
+} generator_options;
+
+typedef struct {
+    var_t id;
+    gate_type type;
+    int_vector* inputs;
+} generated_gate;
+
+typedef struct {
+    var_t id;
+    quantifier_type qtype;
+    int_vector* vars;
+    lit_t sub;
+} generated_scope_node;
+
+typedef struct {
+    generator_options* options;
+    uint64_t rng_state;
+    var_t next_id;
+    vector* blocks;       // int_vector* of variables per level of the prefix
+    vector* gates;        // generated_gate*
+    vector* scope_nodes;  // generated_scope_node*
+    var_t output;
+} generator;
+
+
+static uint64_t rng_next(generator* gen) {
+    // xorshift64*
+    gen->rng_state ^= gen->rng_state >> 12;
+    gen->rng_state ^= gen->rng_state << 25;
+    gen->rng_state ^= gen->rng_state >> 27;
+    return gen->rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static size_t rng_below(generator* gen, size_t bound) {
+    assert(bound > 0);
+    return (size_t)(rng_next(gen) % bound);
+}
+
+static double rng_unit(generator* gen) {
+    return (double)(rng_next(gen) >> 11) / (double)(1ULL << 53);
+}
+
+static quantifier_type level_quantifier(generator_options* options, size_t level) {
+    return level % 2 == 0 ? options->outermost : circuit_negate_quantifier_type(options->outermost);
+}
+
+static int_vector* new_block(generator* gen) {
+    int_vector* block = int_vector_init();
+    for (size_t i = 0; i < gen->options->width; i++) {
+        int_vector_add(block, (int)gen->next_id++);
+    }
+    return block;
+}
+
+static generated_gate* new_gate(generator* gen, gate_type type) {
+    generated_gate* gate = malloc(sizeof(generated_gate));
+    gate->id = gen->next_id++;
+    gate->type = type;
+    gate->inputs = int_vector_init();
+    vector_add(gen->gates, gate);
+    return gate;
+}
+
+/**
+ * Generates the gate layers of one component over the given visible variables.
+ * Every gate draws its inputs from the previous layer, preferring nodes that
+ * have not been used yet (tree-like). With probability sharing, an input is
+ * instead drawn uniformly from all earlier nodes of the component, which
+ * introduces shared subcircuits and long edges.
+ *
+ * @return the id of the gate combining the last layer
+ */
+static var_t generate_component(generator* gen, int_vector* visible_vars) {
+    generator_options* options = gen->options;
+    int_vector* earlier = int_vector_init();   // all nodes of previous layers
+    int_vector* previous = int_vector_init();  // nodes of previous layer
+    int_vector* unused = int_vector_init();    // nodes of previous layer not used as input yet are stored
+    size_t num_unused = 0;                     // in the first num_unused positions
+    int_vector* current = int_vector_init();
+
+    for (size_t i = 0; i < int_vector_count(visible_vars); i++) {
+        int_vector_add(earlier, int_vector_get(visible_vars, i));
+        int_vector_add(previous, int_vector_get(visible_vars, i));
+        int_vector_add(unused, int_vector_get(visible_vars, i));
+    }
+    num_unused = int_vector_count(unused);
+
+    for (size_t layer = 0; layer < options->depth; layer++) {
+        const gate_type type = layer % 2 == 0 ? GATE_AND : GATE_OR;
+        int_vector_reset(current);
+        for (size_t i = 0; i < options->gates_per_layer; i++) {
+            generated_gate* gate = new_gate(gen, type);
+            for (size_t j = 0; j < options->fan_in; j++) {
+                int node;
+                if (rng_unit(gen) < options->sharing) {
+                    node = int_vector_get(earlier, rng_below(gen, int_vector_count(earlier)));
+                } else if (num_unused > 0) {
+                    // remove random unused node by swapping it behind the unused ones
+                    const size_t position = rng_below(gen, num_unused);
+                    num_unused--;
+                    node = int_vector_get(unused, position);
+                    int_vector_set(unused, position, int_vector_get(unused, num_unused));
+                    int_vector_set(unused, num_unused, node);
+                } else {
+                    node = int_vector_get(previous, rng_below(gen, int_vector_count(previous)));
+                }
+                const bool negated = rng_below(gen, 2) == 0;
+                int_vector_add(gate->inputs, negated ? -node : node);
+            }
+            int_vector_add(current, (int)gate->id);
+        }
+
+        int_vector_reset(previous);
+        int_vector_reset(unused);
+        for (size_t i = 0; i < int_vector_count(current); i++) {
+            int_vector_add(earlier, int_vector_get(current, i));
+            int_vector_add(previous, int_vector_get(current, i));
+            int_vector_add(unused, int_vector_get(current, i));
+        }
+        num_unused = int_vector_count(unused);
+    }
+
+    // combine last layer with the gate type of the next layer
+    generated_gate* top = new_gate(gen, options->depth % 2 == 0 ? GATE_AND : GATE_OR);
+    for (size_t i = 0; i < int_vector_count(previous); i++) {
+        int_vector_add(top->inputs, int_vector_get(previous, i));
+    }
+
+    int_vector_free(earlier);
+    int_vector_free(previous);
+    int_vector_free(unused);
+    int_vector_free(current);
+    return top->id;
+}
+
+static void generate(generator* gen) {
+    generator_options* options = gen->options;
+
+    if (options->scope_nodes == 0) {
+        int_vector* visible = int_vector_init();
+        for (size_t level = 0; level < options->levels; level++) {
+            int_vector* block = new_block(gen);
+            for (size_t i = 0; i < int_vector_count(block); i++) {
+                int_vector_add(visible, int_vector_get(block, i));
+            }
+            vector_add(gen->blocks, block);
+        }
+        gen->output = generate_component(gen, visible);
+        int_vector_free(visible);
+        return;
+    }
+
+    // non-prenex: the outermost block is shared, every component binds its own inner blocks by scope nodes
+    assert(options->levels >= 2);
+    int_vector* outer = new_block(gen);
+    vector_add(gen->blocks, outer);
+
+    int_vector* tops = int_vector_init();
+    for (size_t component = 0; component < options->scope_nodes; component++) {
+        int_vector* visible = int_vector_init();
+        for (size_t i = 0; i < int_vector_count(outer); i++) {
+            int_vector_add(visible, int_vector_get(outer, i));
+        }
+        vector* local_blocks = vector_init();
+        for (size_t level = 1; level < options->levels; level++) {
+            int_vector* block = new_block(gen);
+            for (size_t i = 0; i < int_vector_count(block); i++) {
+                int_vector_add(visible, int_vector_get(block, i));
+            }
+            vector_add(local_blocks, block);
+        }
+
+        lit_t sub = (lit_t)generate_component(gen, visible);
+        for (size_t level = options->levels - 1; level >= 1; level--) {
+            generated_scope_node* scope_node = malloc(sizeof(generated_scope_node));
+            scope_node->id = gen->next_id++;
+            scope_node->qtype = level_quantifier(options, level);
+            scope_node->vars = vector_get(local_blocks, level - 1);
+            scope_node->sub = sub;
+            vector_add(gen->scope_nodes, scope_node);
+            sub = (lit_t)scope_node->id;
+        }
+        int_vector_add(tops, sub);
+        vector_free(local_blocks);
+        int_vector_free(visible);
+    }
+
+    generated_gate* output = new_gate(gen, GATE_AND);
+    for (size_t i = 0; i < int_vector_count(tops); i++) {
+        int_vector_add(output->inputs, int_vector_get(tops, i));
+    }
+    gen->output = output->id;
+    int_vector_free(tops);
+}
+
+static void print_variable_list(FILE* file, int_vector* vars) {
+    for (size_t i = 0; i < int_vector_count(vars); i++) {
+        fprintf(file, "%s%d", i == 0 ? "" : ", ", int_vector_get(vars, i));
+    }
+}
+
+/**
+ * Prints the generated formula in QCIR format. Gates and scope nodes are
+ * printed in order of their ids, i.e., every node is defined before its use.
+ */
+static void print_qcir(generator* gen, FILE* file) {
+    generator_options* options = gen->options;
+    fprintf(file, "#QCIR-G14 %u\n", gen->next_id - 1);
+    for (size_t level = 0; level < vector_count(gen->blocks); level++) {
+        fprintf(file, "%s(", level_quantifier(options, level) == QUANT_EXISTS ? "exists" : "forall");
+        print_variable_list(file, vector_get(gen->blocks, level));
+        fprintf(file, ")\n");
+    }
+    fprintf(file, "output(%u)\n", gen->output);
+
+    size_t gate_index = 0;
+    size_t scope_index = 0;
+    while (gate_index < vector_count(gen->gates) || scope_index < vector_count(gen->scope_nodes)) {
+        generated_gate* gate = gate_index < vector_count(gen->gates) ? vector_get(gen->gates, gate_index) : NULL;
+        generated_scope_node* scope_node = scope_index < vector_count(gen->scope_nodes) ? vector_get(gen->scope_nodes, scope_index) : NULL;
+        if (scope_node == NULL || (gate != NULL && gate->id < scope_node->id)) {
+            fprintf(file, "%u = %s(", gate->id, gate->type == GATE_AND ? "and" : "or");
+            print_variable_list(file, gate->inputs);
+            fprintf(file, ")\n");
+            gate_index++;
+        } else {
+            fprintf(file, "%u = %s(", scope_node->id, scope_node->qtype == QUANT_EXISTS ? "exists" : "forall");
+            print_variable_list(file, scope_node->vars);
+            fprintf(file, "; %d)\n", scope_node->sub);
+            scope_index++;
+        }
+    }
+}
+
+static void generator_free(generator* gen) {
+    for (size_t i = 0; i < vector_count(gen->blocks); i++) {
+        int_vector_free(vector_get(gen->blocks, i));
+    }
+    vector_free(gen->blocks);
+    for (size_t i = 0; i < vector_count(gen->gates); i++) {
+        generated_gate* gate = vector_get(gen->gates, i);
+        int_vector_free(gate->inputs);
+        free(gate);
+    }
+    vector_free(gen->gates);
+    for (size_t i = 0; i < vector_count(gen->scope_nodes); i++) {
+        generated_scope_node* scope_node = vector_get(gen->scope_nodes, i);
+        int_vector_free(scope_node->vars);
+        free(scope_node);
+    }
+    vector_free(gen->scope_nodes);
+}
+
+static void print_usage(const char* name) {
+    printf("usage: %s [options] [output_file]\n\n"
+           "Generates a random QCIR formula with the given shape.\n\n"
+           "options:\n"
+           "  --levels N                alternation depth, i.e., number of quantifier blocks (default 3)\n"
+           "  --width N                 variables per quantifier block (default 10)\n"
+           "  --fan-in N                inputs per gate (default 3)\n"
+           "  --depth N                 number of gate layers (default 4)\n"
+           "  --gates N                 gates per layer (default 20)\n"
+           "  --sharing F               probability in [0,1] that a gate input is shared with\n"
+           "                            other gates instead of being a fresh node (default 0.2)\n"
+           "  --scope-nodes N           generate non-prenex formula with N components, each\n"
+           "                            binding the inner levels by scope nodes, i.e., N*(levels-1)\n"
+           "                            scope nodes in total (default 0, prenex)\n"
+           "  --outermost e/a           quantifier of the outermost block (default e)\n"
+           "  --seed N                  seed of the random generator (default 1)\n"
+           "  -h/--help                 show this message and exit\n", name);
+}
+
+static size_t parse_positive_argument(const char* cmd, const char* arg) {
+    long value = strtol(arg, NULL, 0);
+    if (value <= 0) {
+        logging_fatal("Wrong argument %s for %s, expect positive number\n", arg, cmd);
+    }
+    return (size_t)value;
+}
+
+int main(int argc, char* const argv[]) {
+    const char* output_file_name = NULL;
+    FILE* output = stdout;
+    generator_options options = {
+        .levels = 3,
+        .width = 10,
+        .fan_in = 3,
+        .depth = 4,
+        .gates_per_layer = 20,
+        .sharing = 0.2,
+        .scope_nodes = 0,
+        .outermost = QUANT_EXISTS,
+        .seed = 1
+    };
+
+    const char* ch;
+    while ((ch = GETOPT(argc, argv)) != NULL) {
+        GETOPT_SWITCH(ch) {
+        GETOPT_OPT("-h"):
+        GETOPT_OPT("--help"):
+            print_usage(argv[0]);
+            return 0;
+            break;
+        GETOPT_OPTARG("--levels"):
+            options.levels = parse_positive_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--width"):
+            options.width = parse_positive_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--fan-in"):
+            options.fan_in = parse_positive_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--depth"):
+            options.depth = parse_positive_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--gates"):
+            options.gates_per_layer = parse_positive_argument(ch, optarg);
+            break;
+        GETOPT_OPTARG("--sharing"):
+            options.sharing = strtod(optarg, NULL);
+            if (options.sharing < 0 || options.sharing > 1) {
+                logging_fatal("Wrong argument %s for %s, expect value in [0,1]\n", optarg, ch);
+            }
+            break;
+        GETOPT_OPTARG("--scope-nodes"):
+            options.scope_nodes = strtoul(optarg, NULL, 0);
+            break;
+        GETOPT_OPTARG("--outermost"):
+            if (strcmp(optarg, "e") == 0) {
+                options.outermost = QUANT_EXISTS;
+            } else if (strcmp(optarg, "a") == 0) {
+                options.outermost = QUANT_FORALL;
+            } else {
+                logging_fatal("Wrong argument %s for %s, expect e/a\n", optarg, ch);
+            }
+            break;
+        GETOPT_OPTARG("--seed"):
+            options.seed = strtoull(optarg, NULL, 0);
+            break;
+        GETOPT_MISSING_ARG:
+            printf("missing argument to %s\n", ch);
+            /* FALLTHROUGH */
+        GETOPT_DEFAULT:
+            printf("unknown argument %s\n", ch);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.scope_nodes > 0 && options.levels < 2) {
+        logging_error("Non-prenex formulas require at least two quantifier levels\n");
+        return 1;
+    }
+
+    if (optind < argc) {
+        output_file_name = argv[optind];
+        output = fopen(output_file_name, "w");
+        if (output == NULL) {
+            logging_error("Cannot open output file %s\n", output_file_name);
+            return 1;
+        }
+    }
+
+    generator gen;
+    gen.options = &options;
+    gen.rng_state = options.seed != 0 ? options.seed : 1;  // xorshift state must not be zero
+    gen.next_id = 1;
+    gen.blocks = vector_init();
+    gen.gates = vector_init();
+    gen.scope_nodes = vector_init();
+    gen.output = 0;
+
+    generate(&gen);
+    print_qcir(&gen, output);
+    generator_free(&gen);
+
+    if (output != stdout) {
+        fclose(output);
+    }
+    return 0;
+}
@@ -7,6 +7,7 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 
@@ -141,39 +142,53 @@ int main(int argc, char* const argv[]) {
     return 0;
 }
 
-static unsigned calculate_circuit_depth_recursive(Circuit* circuit, lit_t lit, unsigned current_depth) {
-    const var_t var = lit_to_var(lit);
-    switch (circuit->types[var]) {
-        case NODE_VAR:
-            return current_depth + 1;
-        
-        case NODE_SCOPE:
-        {
-            ScopeNode* scope = circuit->nodes[var];
-            return calculate_circuit_depth_recursive(circuit, scope->sub, current_depth + 1) + 1;
-        }
-            
-        case NODE_GATE:
-        {
-            Gate* gate = circuit->nodes[var];
-            unsigned max = current_depth + 1;
-            for (size_t i = 0; i < gate->num_inputs; i++) {
-                unsigned recursive = calculate_circuit_depth_recursive(circuit, gate->inputs[i], current_depth + 1);
-                if (recursive > max) {
-                    max = recursive;
+/**
+ * Computes the length of the longest path from the output to a variable, where
+ * scope nodes count twice. Nodes are topologically ordered after reencoding,
+ * thus, the height of every node is computed once from the heights of its
+ * inputs.
+ */
+static unsigned calculate_circuit_depth(Circuit* circuit) {
+    unsigned* height = calloc(circuit->max_num + 1, sizeof(unsigned));
+    
+    for (size_t i = 1; i <= circuit->max_num; i++) {
+        switch (circuit->types[i]) {
+            case NODE_VAR:
+                height[i] = 1;
+                break;
+                
+            case NODE_SCOPE:
+            {
+                ScopeNode* scope = circuit->nodes[i];
+                const var_t sub = lit_to_var(scope->sub);
+                assert(sub < i);
+                height[i] = height[sub] + 2;
+                break;
+            }
+                
+            case NODE_GATE:
+            {
+                Gate* gate = circuit->nodes[i];
+                unsigned max = 0;
+                for (size_t j = 0; j < gate->num_inputs; j++) {
+                    const var_t input = lit_to_var(gate->inputs[j]);
+                    assert(input < i);
+                    if (height[input] > max) {
+                        max = height[input];
+                    }
                 }
+                height[i] = max + 1;
+                break;
             }
-            return max;
+                
+            default:
+                // removed node
+                assert(circuit->nodes[i] == NULL);
+                break;
         }
-            
-            break;
-            
-        default:
-            abort();
     }
-    abort();
-}
-
-static unsigned calculate_circuit_depth(Circuit* circuit) {
-    return calculate_circuit_depth_recursive(circuit, circuit->output, 0);
+    
+    const unsigned depth = height[lit_to_var(circuit->output)];
+    free(height);
+    return depth;
 }
@@ -0,0 +1,234 @@
+//
+//  quabs.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "quabs.h"
+#include "circuit.h"
+#include "logging.h"
+#include "qcir.h"
+#include "solver.h"
+
+struct quabs {
+    SolverOptions* options;
+    Circuit* circuit;  // owned by solver once it is initialized
+    Solver* solver;    // NULL before quabs_solve
+    Circuit* delta;    // extension of the circuit applied by the next quabs_solve, extensible mode only
+    qbf_res result;
+};
+
+static quantifier_type import_quantifier(quabs_quantifier qtype) {
+    switch (qtype) {
+        case QUABS_EXISTS:
+            return QUANT_EXISTS;
+        case QUABS_FORALL:
+            return QUANT_FORALL;
+        case QUABS_FREE:
+            return QUANT_FREE;
+        default:
+            api_expect(false, "unknown quantifier %d\n", qtype);
+            return QUANT_EXISTS;
+    }
+}
+
+static void expect_building(quabs* solver) {
+    api_expect(solver->solver == NULL, "options cannot be changed after solving\n");
+}
+
+/**
+ * Returns the circuit that is changed by the builder functions, i.e., the
+ * circuit itself before solving and the pending extension afterwards.
+ */
+static Circuit* building_circuit(quabs* solver) {
+    if (solver->solver == NULL) {
+        return solver->circuit;
+    }
+    api_expect(solver->options->extensible, "circuit cannot be changed after solving if not in extensible mode\n");
+    if (solver->delta == NULL) {
+        solver->delta = circuit_init();
+    }
+    return solver->delta;
+}
+
+quabs* quabs_init() {
+    quabs* solver = malloc(sizeof(quabs));
+    solver->options = solver_get_default_options();
+    solver->circuit = circuit_init();
+    solver->solver = NULL;
+    solver->delta = NULL;
+    solver->result = QBF_RESULT_UNKNOWN;
+    return solver;
+}
+
+void quabs_free(quabs* solver) {
+    if (solver->solver != NULL) {
+        solver_free(solver->solver);
+    } else {
+        circuit_free(solver->circuit);
+    }
+    if (solver->delta != NULL) {
+        circuit_free(solver->delta);
+    }
+    free(solver->options);
+    free(solver);
+}
+
+void quabs_set_verbosity(int level) {
+    api_expect(level >= VERBOSITY_NONE && level <= VERBOSITY_ALL, "verbosity must be between %d and %d\n", VERBOSITY_NONE, VERBOSITY_ALL);
+    logging_set_verbosity((verbosity)level);
+}
+
+void quabs_set_preprocessing(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->preprocess = value;
+}
+
+void quabs_set_miniscoping(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->miniscoping = value;
+}
+
+void quabs_set_expansion(quabs* solver, size_t max_vars) {
+    expect_building(solver);
+    solver->options->expansion = max_vars;
+}
+
+void quabs_set_dependency_scheme(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->dependency_scheme = value;
+}
+
+void quabs_set_certification(quabs* solver, bool value) {
+    expect_building(solver);
+#ifdef CERTIFICATION
+    solver->options->certify = value;
+#else
+    api_expect(!value, "certification is not compiled in\n");
+#endif
+}
+
+void quabs_set_partial_assignment(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->partial_assignment = value;
+}
+
+void quabs_set_incremental(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->incremental = value;
+}
+
+void quabs_set_extensible(quabs* solver, bool value) {
+    expect_building(solver);
+    solver->options->extensible = value;
+}
+
+void quabs_add_quantifier_block(quabs* solver, quabs_quantifier qtype, const int* vars, size_t num_vars) {
+    Circuit* circuit = building_circuit(solver);
+    Scope* scope = circuit_init_scope(circuit, import_quantifier(qtype));
+    for (size_t i = 0; i < num_vars; i++) {
+        api_expect(vars[i] > 0, "variables must be greater than zero\n");
+        circuit_new_var(circuit, scope, (var_t)vars[i]);
+    }
+}
+
+void quabs_add_gate(quabs* solver, int gate_id, quabs_gate type, const int* inputs, size_t num_inputs) {
+    Circuit* circuit = building_circuit(solver);
+    api_expect(gate_id > 0, "gates must be greater than zero\n");
+    api_expect(type == QUABS_AND || type == QUABS_OR, "unknown gate type %d\n", type);
+    Gate* gate = circuit_add_gate(circuit, (var_t)gate_id, type == QUABS_AND ? GATE_AND : GATE_OR);
+    for (size_t i = 0; i < num_inputs; i++) {
+        circuit_add_to_gate(circuit, gate, inputs[i]);
+    }
+}
+
+void quabs_add_scope_gate(quabs* solver, int gate_id, quabs_quantifier qtype, const int* vars, size_t num_vars, int sub) {
+    expect_building(solver);  // extensions must be prenex
+    api_expect(gate_id > 0, "gates must be greater than zero\n");
+    api_expect(qtype != QUABS_FREE, "scope gates must be existential or universal\n");
+    ScopeNode* scope_node = circuit_new_scope_node(solver->circuit, import_quantifier(qtype), (var_t)gate_id);
+    for (size_t i = 0; i < num_vars; i++) {
+        api_expect(vars[i] > 0, "variables must be greater than zero\n");
+        circuit_new_var(solver->circuit, scope_node->scope, (var_t)vars[i]);
+    }
+    circuit_set_scope_node(solver->circuit, scope_node, sub);
+}
+
+void quabs_set_output(quabs* solver, int literal) {
+    circuit_set_output(building_circuit(solver), literal);
+}
+
+int quabs_read_qcir(quabs* solver, FILE* file) {
+    // extensions may refer to existing nodes, hence, they are read leniently
+    return circuit_from_qcir(building_circuit(solver), file, solver->solver != NULL);
+}
+
+int quabs_read_qcir_file(quabs* solver, const char* file_name) {
+    return circuit_open_and_read_qcir_file(building_circuit(solver), file_name, solver->solver != NULL);
+}
+
+int quabs_solve(quabs* solver) {
+    if (solver->solver == NULL) {
+        solver->solver = solver_init(solver->options, solver->circuit);
+    }
+    if (solver->delta != NULL) {
+        solver_extend(solver->solver, solver->delta);
+        circuit_free(solver->delta);
+        solver->delta = NULL;
+    }
+    solver->result = solver_sat(solver->solver);
+    switch (solver->result) {
+        case QBF_RESULT_SAT:
+            return QUABS_RESULT_SAT;
+        case QBF_RESULT_UNSAT:
+            return QUABS_RESULT_UNSAT;
+        default:
+            return QUABS_RESULT_UNKNOWN;
+    }
+}
+
+void quabs_assume(quabs* solver, int literal) {
+    if (solver->solver == NULL) {
+        solver->solver = solver_init(solver->options, solver->circuit);
+    }
+    solver_assume(solver->solver, literal);
+}
+
+bool quabs_failed(quabs* solver, int literal) {
+    api_expect(solver->solver != NULL, "quabs_solve must be called first\n");
+    return solver_failed(solver->solver, literal);
+}
+
+int quabs_get_value(quabs* solver, int var) {
+    api_expect(solver->solver != NULL, "quabs_solve must be called first\n");
+    api_expect(solver->options->partial_assignment, "partial assignment option is not set\n");
+    int_vector* partial_assignment = solver_get_partial_assignment(solver->solver);
+    if (partial_assignment == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < int_vector_count(partial_assignment); i++) {
+        const int lit = int_vector_get(partial_assignment, i);
+        if (lit == var || lit == -var) {
+            return lit;
+        }
+    }
+    return 0;
+}
+
+int quabs_write_certificate(quabs* solver, FILE* file) {
+    api_expect(solver->solver != NULL, "quabs_solve must be called first\n");
+#ifdef CERTIFICATION
+    if (!solver->options->certify || solver->result == QBF_RESULT_UNKNOWN) {
+        return -1;
+    }
+    certification_write(&solver->solver->cert, solver->result, file);
+    return 0;
+#else
+    (void)file;
+    return -1;
+#endif
+}
@@ -0,0 +1,117 @@
+//
+//  quabs.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef quabs_h
+#define quabs_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Library interface of QuAbS (libquabs).
+ *
+ * A quabs instance owns a circuit and solves it once, or repeatedly under
+ * assumptions in incremental mode. Instances are independent of each other,
+ * hence, different instances can be used concurrently from different
+ * threads. A single instance must not be used by more than one thread at the
+ * same time.
+ *
+ * Variables and gates are identified by positive integers, literals are
+ * signed integers as in QCIR. Misuse of the interface, e.g., redefining a
+ * node or solving twice outside of incremental or extensible mode, aborts with
+ * an API error.
+ *
+ * Typical use:
+ *
+ *     quabs* solver = quabs_init();
+ *     int x[] = { 1 }, y[] = { 2 }, g[] = { 1, -2 };
+ *     quabs_add_quantifier_block(solver, QUABS_FORALL, x, 1);
+ *     quabs_add_quantifier_block(solver, QUABS_EXISTS, y, 1);
+ *     quabs_add_gate(solver, 3, QUABS_OR, g, 2);
+ *     quabs_set_output(solver, 3);
+ *     int result = quabs_solve(solver);  // QUABS_RESULT_SAT
+ *     quabs_free(solver);
+ */
+
+typedef struct quabs quabs;
+
+#define QUABS_RESULT_UNKNOWN 0
+#define QUABS_RESULT_SAT     10
+#define QUABS_RESULT_UNSAT   20
+
+typedef enum {
+    QUABS_EXISTS,
+    QUABS_FORALL,
+    QUABS_FREE  // free variables are treated as outermost existential
+} quabs_quantifier;
+
+typedef enum {
+    QUABS_AND,
+    QUABS_OR
+} quabs_gate;
+
+quabs* quabs_init(void);
+void   quabs_free(quabs*);
+
+// Verbosity of the calling thread, 0 prints errors only (default 1)
+void   quabs_set_verbosity(int level);
+
+// Options have to be set before quabs_solve
+void   quabs_set_preprocessing(quabs*, bool);
+void   quabs_set_miniscoping(quabs*, bool);
+void   quabs_set_expansion(quabs*, size_t max_vars);
+void   quabs_set_dependency_scheme(quabs*, bool);
+void   quabs_set_certification(quabs*, bool);  // required for quabs_write_certificate
+void   quabs_set_partial_assignment(quabs*, bool);  // required for quabs_get_value
+void   quabs_set_incremental(quabs*, bool);  // required for quabs_assume, excludes certification
+void   quabs_set_extensible(quabs*, bool);  // allows building after quabs_solve, excludes certification
+
+/**
+ * Building the circuit, quantifier blocks are added from outermost to
+ * innermost. In extensible mode, the circuit can be extended after
+ * quabs_solve: new variables are added to the existing blocks, the i-th call
+ * of quabs_add_quantifier_block extends the i-th block (the first block is the
+ * existential top level), new gates may use existing nodes, and the output
+ * has to be set again. Scope gates are not supported in extensions.
+ */
+void   quabs_add_quantifier_block(quabs*, quabs_quantifier, const int* vars, size_t num_vars);
+void   quabs_add_gate(quabs*, int gate, quabs_gate, const int* inputs, size_t num_inputs);
+void   quabs_add_scope_gate(quabs*, int gate, quabs_quantifier, const int* vars, size_t num_vars, int sub);
+void   quabs_set_output(quabs*, int literal);
+
+// Reading the circuit from QCIR, returns 0 on success
+int    quabs_read_qcir(quabs*, FILE*);
+int    quabs_read_qcir_file(quabs*, const char* file_name);
+
+// Solves the circuit, can be called repeatedly in incremental mode
+int    quabs_solve(quabs*);
+
+/**
+ * Incremental mode: assumes literal for the next call of quabs_solve only.
+ * Only variables of the outermost existential (or free) block can be
+ * assumed. Constraints can be added under an activation variable a of this
+ * block, e.g., or(-a, constraint), and are enabled by assuming a. Everything
+ * learned is kept between calls.
+ */
+void   quabs_assume(quabs*, int literal);
+
+// Returns whether the assumption literal was used to derive the last UNSAT result
+bool   quabs_failed(quabs*, int literal);
+
+/**
+ * Returns the value of variable var in the partial assignment, i.e., var or
+ * -var, and 0 if var is unassigned. The partial assignment is only available
+ * for the outermost quantifier block if it is winning, i.e., existential
+ * and SAT or universal and UNSAT.
+ */
+int    quabs_get_value(quabs*, int var);
+
+// Writes the Skolem (SAT) or Herbrand (UNSAT) function in ASCII AIGER format, returns 0 on success
+int    quabs_write_certificate(quabs*, FILE*);
+
+#endif /* quabs_h */
@@ -12,73 +12,89 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#define INITIAL_QUEUE_CAPACITY 16
+
 void int_queue_init(int_queue* queue) {
-    queue->first = queue->last = NULL;
+    queue->data = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+    queue->count = 0;
+}
+
+void int_queue_free(int_queue* queue) {
+    free(queue->data);
+    int_queue_init(queue);
+}
+
+void int_queue_reset(int_queue* queue) {
+    queue->head = 0;
+    queue->count = 0;
 }
 
 bool int_queue_is_empty(int_queue* queue) {
-    return queue->last == NULL;
+    return queue->count == 0;
+}
+
+static void int_queue_grow(int_queue* queue) {
+    const size_t new_capacity = queue->capacity == 0 ? INITIAL_QUEUE_CAPACITY : 2 * queue->capacity;
+    int* data = malloc(sizeof(int) * new_capacity);
+    // linearize elements at the front of the new buffer
+    for (size_t i = 0; i < queue->count; i++) {
+        data[i] = queue->data[(queue->head + i) & (queue->capacity - 1)];
+    }
+    free(queue->data);
+    queue->data = data;
+    queue->capacity = new_capacity;
+    queue->head = 0;
 }
 
 void int_queue_push(int_queue* queue, int value) {
-    int_queue_element* element = malloc(sizeof(int_queue_element));
-    element->value = value;
-    element->next = NULL;
-    if (queue->first == NULL) {
-        assert(queue->last == NULL);
-        queue->first = queue->last = element;
-    } else {
-        assert(queue->last != NULL);
-        int_queue_element* previous_last = queue->last;
-        queue->last = element;
-        previous_last->next = element;
+    if (queue->count == queue->capacity) {
+        int_queue_grow(queue);
     }
+    assert(queue->count < queue->capacity);
+    queue->data[(queue->head + queue->count) & (queue->capacity - 1)] = value;
+    queue->count++;
 }
 
 int int_queue_pop(int_queue* queue) {
     assert(!int_queue_is_empty(queue));
-    int_queue_element* element = queue->first;
-    assert(element != NULL);
-    
-    const int value = element->value;
-    
-    if (queue->first == queue->last) {
-        // pop last element
-        queue->first = queue->last = NULL;
-    } else {
-        queue->first = element->next;
-    }
-    
-    free(element);
-    
+    const int value = queue->data[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
     return value;
 }
 
 bool int_queue_has_at_least_one_element(int_queue* queue) {
-    return queue->first != NULL;
+    return queue->count >= 1;
 }
 
 bool int_queue_has_at_least_two_elements(int_queue* queue) {
-    return queue->first != NULL && queue->first != queue->last;
+    return queue->count >= 2;
 }
 
 bool int_queue_has_more_than_two_elements(int_queue* queue) {
-    if (queue->first == NULL) {
-        return false;
-    }
-    if (queue->first->next == NULL) {
-        return false;
-    }
-    if (queue->first->next == queue->last) {
-        return false;
-    }
-    return true;
+    return queue->count > 2;
+}
+
+size_t int_queue_count(int_queue* queue) {
+    return queue->count;
+}
+
+int int_queue_get(int_queue* queue, size_t index) {
+    assert(index < queue->count);
+    return queue->data[(queue->head + index) & (queue->capacity - 1)];
+}
+
+void int_queue_set(int_queue* queue, size_t index, int value) {
+    assert(index < queue->count);
+    queue->data[(queue->head + index) & (queue->capacity - 1)] = value;
 }
 
 void int_queue_print(int_queue* queue) {
     printf("int_queue");
-    for (int_queue_element* element = queue->first; element != NULL; element = element->next) {
-        printf(" %d", element->value);
+    for (size_t i = 0; i < queue->count; i++) {
+        printf(" %d", int_queue_get(queue, i));
     }
     printf("\n");
 }
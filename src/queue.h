@@ -10,26 +10,35 @@
 #define queue_h
 
 #include <stdbool.h>
+#include <stddef.h>
 
-typedef struct int_queue_element int_queue_element;
-
-struct int_queue_element {
-    int value;
-    int_queue_element* next;
-};
-
+/**
+ * FIFO queue of integers implemented as growable ring buffer.
+ * The buffer is allocated lazily on the first push and reused afterwards,
+ * i.e., pushing and popping does not allocate in the steady state.
+ */
 typedef struct {
-    int_queue_element* first;
-    int_queue_element* last;
+    int* data;
+    size_t capacity;  // always zero or a power of two
+    size_t head;      // position of first element
+    size_t count;
 } int_queue;
 
 void int_queue_init(int_queue*);
+void int_queue_free(int_queue*);
+void int_queue_reset(int_queue*);
 bool int_queue_is_empty(int_queue*);
 void int_queue_push(int_queue*, int);
 int int_queue_pop(int_queue*);
 bool int_queue_has_at_least_one_element(int_queue*);
 bool int_queue_has_at_least_two_elements(int_queue*);
 bool int_queue_has_more_than_two_elements(int_queue*);
+size_t int_queue_count(int_queue*);
+
+// Access to the i-th element from the front of the queue
+int int_queue_get(int_queue*, size_t);
+void int_queue_set(int_queue*, size_t, int);
+
 void int_queue_print(int_queue*);
 
 #endif /* queue_h */
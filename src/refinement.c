@@ -0,0 +1,467 @@
+//
+//  refinement.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "refinement.h"
+#include "logging.h"
+
+#define REFINEMENT_ACTIVITY_DECAY 0.999
+#define REFINEMENT_ACTIVITY_LIMIT 1e100
+#define REFINEMENT_LIMIT_GROWTH   10  // the limit grows by (at least) 1/10 with every reduction
+
+refinement_db* refinement_db_init(SATSolver* sat, size_t limit, refinement_activation new_activation, void* context) {
+    assert(limit > 0);
+    refinement_db* db = malloc(sizeof(refinement_db));
+    db->sat = sat;
+    db->new_activation = new_activation;
+    db->context = context;
+    db->clauses = vector_init();
+    db->occurrences = map_init();
+    db->watches = map_init();
+    db->limit = limit;
+    db->increment = 1.0;
+    db->num_learned = 0;
+    db->num_skipped = 0;
+    db->num_strengthened = 0;
+    db->num_strengthened_active = 0;
+    db->num_retired_cold = 0;
+    db->num_retired_subsumed = 0;
+    db->num_retired_guarded = 0;
+    db->num_reductions = 0;
+    db->max_active = 0;
+    return db;
+}
+
+static void free_refinement(refinement* clause) {
+    int_vector_free(clause->lits);
+    free(clause);
+}
+
+static void free_index(map* index) {
+    for (size_t i = 0; i < index->size; i++) {
+        if (index->data[i].occupied) {
+            vector_free(index->data[i].data);
+        }
+    }
+    map_free(index);
+}
+
+void refinement_db_free(refinement_db* db) {
+    for (size_t i = 0; i < vector_count(db->clauses); i++) {
+        free_refinement(vector_get(db->clauses, i));
+    }
+    vector_free(db->clauses);
+    free_index(db->occurrences);
+    free_index(db->watches);
+    free(db);
+}
+
+static uint64_t literal_signature(int lit) {
+    const unsigned value = lit < 0 ? 2 * (unsigned)-lit + 1 : 2 * (unsigned)lit;
+    return (uint64_t)1 << (value % 64);
+}
+
+static void compute_signature(refinement* clause) {
+    clause->signature = 0;
+    for (size_t i = 0; i < int_vector_count(clause->lits); i++) {
+        clause->signature |= literal_signature(int_vector_get(clause->lits, i));
+    }
+}
+
+// Returns the clauses of index for literal, NULL if there are none
+static vector* index_get(map* index, int lit) {
+    return map_get(index, lit);
+}
+
+static void index_add(map* index, int lit, refinement* clause) {
+    void** reference = map_get_reference(index, lit);
+    if (reference != NULL) {
+        vector_add(*reference, clause);
+        return;
+    }
+    vector* clauses = vector_init();
+    vector_add(clauses, clause);
+    map_add(index, lit, clauses);
+}
+
+static void index_remove(map* index, int lit, refinement* clause) {
+    vector* clauses = map_get(index, lit);
+    assert(clauses != NULL);
+    const bool removed = vector_remove(clauses, clause);
+    assert(removed);
+    (void)removed;
+}
+
+/**
+ * Adds the clause to the occurrence lists and watches it by the literal with
+ * the fewest watches, such that the watch lists stay short. The empty clause
+ * is watched by 0.
+ */
+static void attach(refinement_db* db, refinement* clause) {
+    size_t min_watches = SIZE_MAX;
+    clause->watch = 0;
+    for (size_t i = 0; i < int_vector_count(clause->lits); i++) {
+        const int lit = int_vector_get(clause->lits, i);
+        index_add(db->occurrences, lit, clause);
+        const vector* watches = index_get(db->watches, lit);
+        const size_t num_watches = watches == NULL ? 0 : vector_count((vector*)watches);
+        if (num_watches < min_watches) {
+            min_watches = num_watches;
+            clause->watch = lit;
+        }
+    }
+    index_add(db->watches, clause->watch, clause);
+}
+
+static void detach(refinement_db* db, refinement* clause) {
+    for (size_t i = 0; i < int_vector_count(clause->lits); i++) {
+        index_remove(db->occurrences, int_vector_get(clause->lits, i), clause);
+    }
+    index_remove(db->watches, clause->watch, clause);
+}
+
+// Retires a clause that was already removed from db->clauses
+static void retire(refinement_db* db, refinement* clause) {
+    detach(db, clause);
+    satsolver_add(db->sat, -clause->activation);
+    satsolver_add(db->sat, 0);
+    free_refinement(clause);
+}
+
+/**
+ * Returns whether every literal of a except ignored is contained in b, both
+ * are sorted. Use ignored = 0 for plain subsumption.
+ */
+static bool subsumes_ignoring(const refinement* a, const refinement* b, int ignored) {
+    const uint64_t ignored_signature = ignored != 0 ? literal_signature(ignored) : 0;
+    if ((a->signature & ~(b->signature | ignored_signature)) != 0) {
+        return false;
+    }
+    const size_t count_a = int_vector_count(a->lits);
+    const size_t count_b = int_vector_count(b->lits);
+    if (count_a > count_b + (ignored != 0 ? 1 : 0)) {
+        return false;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < count_a; i++) {
+        const int lit = int_vector_get(a->lits, i);
+        if (lit == ignored) {
+            continue;
+        }
+        while (j < count_b && int_vector_get(b->lits, j) < lit) {
+            j++;
+        }
+        if (j == count_b || int_vector_get(b->lits, j) != lit) {
+            return false;
+        }
+        j++;
+    }
+    return true;
+}
+
+// Returns an active clause that subsumes candidate, NULL if there is none
+static refinement* find_subsuming(refinement_db* db, const refinement* candidate) {
+    vector* empty = index_get(db->watches, 0);
+    if (empty != NULL && vector_count(empty) > 0) {
+        return vector_get(empty, 0);
+    }
+    for (size_t i = 0; i < int_vector_count(candidate->lits); i++) {
+        vector* watches = index_get(db->watches, int_vector_get(candidate->lits, i));
+        if (watches == NULL) {
+            continue;
+        }
+        for (size_t j = 0; j < vector_count(watches); j++) {
+            refinement* clause = vector_get(watches, j);
+            if (subsumes_ignoring(clause, candidate, 0)) {
+                return clause;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Self-subsuming resolution: removes every literal lit of candidate for which
+ * an active clause contains -lit and is otherwise contained in candidate, as
+ * the resolvent of both is candidate without lit.
+ */
+static void strengthen_candidate(refinement_db* db, refinement* candidate) {
+    size_t i = 0;
+    while (i < int_vector_count(candidate->lits)) {
+        const int lit = int_vector_get(candidate->lits, i);
+        vector* occurrences = index_get(db->occurrences, -lit);
+        bool strengthened = false;
+        for (size_t j = 0; occurrences != NULL && j < vector_count(occurrences); j++) {
+            if (subsumes_ignoring(vector_get(occurrences, j), candidate, -lit)) {
+                strengthened = true;
+                break;
+            }
+        }
+        if (!strengthened) {
+            i++;
+            continue;
+        }
+        int_vector* lits = int_vector_init();
+        for (size_t k = 0; k < int_vector_count(candidate->lits); k++) {
+            if (k != i) {
+                int_vector_add(lits, int_vector_get(candidate->lits, k));
+            }
+        }
+        int_vector_free(candidate->lits);
+        candidate->lits = lits;
+        compute_signature(candidate);
+        db->num_strengthened++;
+    }
+}
+
+// Returns the literal of clause with the shortest occurrence list
+static int least_occurring_literal(refinement_db* db, const refinement* clause) {
+    int result = 0;
+    size_t min_occurrences = SIZE_MAX;
+    for (size_t i = 0; i < int_vector_count(clause->lits); i++) {
+        const int lit = int_vector_get(clause->lits, i);
+        vector* occurrences = index_get(db->occurrences, lit);
+        const size_t num_occurrences = occurrences == NULL ? 0 : vector_count(occurrences);
+        if (num_occurrences < min_occurrences) {
+            min_occurrences = num_occurrences;
+            result = lit;
+        }
+    }
+    return result;
+}
+
+// Moves the active clauses that are subsumed by clause to retired
+static void collect_subsumed(refinement_db* db, const refinement* clause, vector* retired) {
+    if (int_vector_count(clause->lits) == 0) {
+        for (size_t i = 0; i < vector_count(db->clauses); i++) {
+            vector_add(retired, vector_get(db->clauses, i));
+        }
+        return;
+    }
+    vector* occurrences = index_get(db->occurrences, least_occurring_literal(db, clause));
+    for (size_t i = 0; occurrences != NULL && i < vector_count(occurrences); i++) {
+        refinement* other = vector_get(occurrences, i);
+        if (subsumes_ignoring(clause, other, 0)) {
+            vector_add(retired, other);
+        }
+    }
+}
+
+static void add_to_solver(refinement_db* db, refinement* clause) {
+    for (size_t i = 0; i < int_vector_count(clause->lits); i++) {
+        satsolver_add(db->sat, int_vector_get(clause->lits, i));
+    }
+    satsolver_add(db->sat, -clause->activation);
+    satsolver_add(db->sat, 0);
+}
+
+static void insert(refinement_db* db, refinement* clause) {
+    clause->activation = db->new_activation(db->context);
+    assert(clause->activation > 0);
+    add_to_solver(db, clause);
+    attach(db, clause);
+    vector_add(db->clauses, clause);
+}
+
+static void remove_active(refinement_db* db, vector* removed) {
+    for (size_t i = 0; i < vector_count(removed); i++) {
+        refinement* clause = vector_get(removed, i);
+        vector_remove(db->clauses, clause);
+        retire(db, clause);
+    }
+}
+
+/**
+ * Replaces the active clauses that candidate strengthens by self-subsuming
+ * resolution, i.e., clauses containing -lit for a literal lit of candidate
+ * that contain candidate without lit.
+ */
+static void strengthen_active(refinement_db* db, const refinement* candidate) {
+    vector* replaced = vector_init();
+    vector* strengthened = vector_init();
+    for (size_t i = 0; i < int_vector_count(candidate->lits); i++) {
+        const int lit = int_vector_get(candidate->lits, i);
+        vector* occurrences = index_get(db->occurrences, -lit);
+        for (size_t j = 0; occurrences != NULL && j < vector_count(occurrences); j++) {
+            refinement* other = vector_get(occurrences, j);
+            if (vector_contains(replaced, other) || !subsumes_ignoring(candidate, other, lit)) {
+                continue;
+            }
+            refinement* clause = malloc(sizeof(refinement));
+            clause->lits = int_vector_init();
+            for (size_t k = 0; k < int_vector_count(other->lits); k++) {
+                const int other_lit = int_vector_get(other->lits, k);
+                if (other_lit != -lit) {
+                    int_vector_add(clause->lits, other_lit);
+                }
+            }
+            compute_signature(clause);
+            clause->activity = other->activity;
+            vector_add(replaced, other);
+            vector_add(strengthened, clause);
+        }
+    }
+    remove_active(db, replaced);
+    for (size_t i = 0; i < vector_count(strengthened); i++) {
+        refinement* clause = vector_get(strengthened, i);
+        // the active clauses are free of subsumption, hence, the strengthened clause is not subsumed
+        vector* subsumed = vector_init();
+        collect_subsumed(db, clause, subsumed);
+        db->num_retired_subsumed += vector_count(subsumed);
+        remove_active(db, subsumed);
+        vector_free(subsumed);
+        insert(db, clause);
+        db->num_strengthened_active++;
+    }
+    vector_free(replaced);
+    vector_free(strengthened);
+}
+
+static int compare_activity(const void* a, const void* b) {
+    const double activity_a = (*(refinement* const*)a)->activity;
+    const double activity_b = (*(refinement* const*)b)->activity;
+    return (activity_a > activity_b) - (activity_a < activity_b);
+}
+
+static void reduce(refinement_db* db) {
+    const size_t num_clauses = vector_count(db->clauses);
+    refinement** clauses = malloc(sizeof(refinement*) * num_clauses);
+    for (size_t i = 0; i < num_clauses; i++) {
+        clauses[i] = vector_get(db->clauses, i);
+    }
+
+    // least active half, binary clauses are cheap and kept
+    qsort(clauses, num_clauses, sizeof(refinement*), compare_activity);
+    vector_reset(db->clauses);
+    for (size_t i = 0; i < num_clauses; i++) {
+        if (i < num_clauses / 2 && int_vector_count(clauses[i]->lits) > 2) {
+            retire(db, clauses[i]);
+            db->num_retired_cold++;
+        } else {
+            vector_add(db->clauses, clauses[i]);
+        }
+    }
+    free(clauses);
+
+    db->num_reductions++;
+    db->limit += db->limit / REFINEMENT_LIMIT_GROWTH + 1;
+    logging_info("Refinement reduction: %zu of %zu clauses are kept, next reduction at %zu\n", vector_count(db->clauses), num_clauses, db->limit);
+}
+
+static void bump(refinement_db* db, refinement* clause) {
+    clause->activity += db->increment;
+    if (clause->activity > REFINEMENT_ACTIVITY_LIMIT) {
+        for (size_t j = 0; j < vector_count(db->clauses); j++) {
+            refinement* other = vector_get(db->clauses, j);
+            other->activity /= REFINEMENT_ACTIVITY_LIMIT;
+        }
+        db->increment /= REFINEMENT_ACTIVITY_LIMIT;
+    }
+}
+
+bool refinement_db_add(refinement_db* db, const int_vector* clause) {
+    if (vector_count(db->clauses) >= db->limit) {
+        // before adding, as the new clause is needed by the next call of the SAT solver
+        reduce(db);
+    }
+
+    refinement* learned = malloc(sizeof(refinement));
+    learned->lits = int_vector_init();
+    learned->activity = db->increment;  // as active as a clause that was just used
+    for (size_t i = 0; i < int_vector_count((int_vector*)clause); i++) {
+        const int lit = int_vector_get((int_vector*)clause, i);
+        assert(lit != 0);
+        if (!int_vector_contains_sorted(learned->lits, lit)) {
+            int_vector_add_sorted(learned->lits, lit);
+        }
+    }
+    compute_signature(learned);
+    db->num_learned++;
+
+    strengthen_candidate(db, learned);
+    refinement* subsuming = find_subsuming(db, learned);
+    if (subsuming != NULL) {
+        // the clause was derived again, the subsuming one is still in use
+        bump(db, subsuming);
+        db->num_skipped++;
+        free_refinement(learned);
+        return false;
+    }
+
+    vector* subsumed = vector_init();
+    collect_subsumed(db, learned, subsumed);
+    db->num_retired_subsumed += vector_count(subsumed);
+    remove_active(db, subsumed);
+    vector_free(subsumed);
+    strengthen_active(db, learned);
+
+    insert(db, learned);
+    if (vector_count(db->clauses) > db->max_active) {
+        db->max_active = vector_count(db->clauses);
+    }
+    return true;
+}
+
+void refinement_db_assume(refinement_db* db) {
+    for (size_t i = 0; i < vector_count(db->clauses); i++) {
+        const refinement* clause = vector_get(db->clauses, i);
+        satsolver_assume(db->sat, clause->activation);
+    }
+}
+
+void refinement_db_analyze_failed(refinement_db* db) {
+    for (size_t i = 0; i < vector_count(db->clauses); i++) {
+        refinement* clause = vector_get(db->clauses, i);
+        if (satsolver_failed(db->sat, clause->activation)) {
+            bump(db, clause);
+        }
+    }
+    db->increment /= REFINEMENT_ACTIVITY_DECAY;
+}
+
+void refinement_db_retire_containing(refinement_db* db, int literal) {
+    vector* occurrences = index_get(db->occurrences, literal);
+    if (occurrences == NULL) {
+        return;
+    }
+    vector* retired = vector_init();
+    for (size_t i = 0; i < vector_count(occurrences); i++) {
+        vector_add(retired, vector_get(occurrences, i));
+    }
+    db->num_retired_guarded += vector_count(retired);
+    remove_active(db, retired);
+    vector_free(retired);
+}
+
+void refinement_db_write(refinement_db* db, FILE* file, const char* name) {
+    for (size_t i = 0; i < vector_count(db->clauses); i++) {
+        refinement* clause = vector_get(db->clauses, i);
+        fprintf(file, "%s", name);
+        for (size_t j = 0; j < int_vector_count(clause->lits); j++) {
+            fprintf(file, " %d", int_vector_get(clause->lits, j));
+        }
+        fprintf(file, " 0\n");
+    }
+}
+
+void refinement_db_print_statistics(refinement_db* db, const char* name) {
+    printf("    %s: %zu learned, %zu skipped as subsumed, %zu literals strengthened, %zu active (max %zu), %zu active strengthened, retired %zu cold, %zu subsumed, %zu guarded in %zu reductions\n",
+           name,
+           db->num_learned,
+           db->num_skipped,
+           db->num_strengthened,
+           vector_count(db->clauses),
+           db->max_active,
+           db->num_strengthened_active,
+           db->num_retired_cold,
+           db->num_retired_subsumed,
+           db->num_retired_guarded,
+           db->num_reductions);
+}
@@ -0,0 +1,102 @@
+//
+//  refinement.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef refinement_h
+#define refinement_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "map.h"
+#include "satsolver.h"
+#include "vector.h"
+
+/**
+ * Learned clauses of one SAT solver of the abstraction, i.e., the refinements
+ * of sat and the blocking clauses of negation.
+ *
+ * Every clause is guarded by its own activation literal that is assumed in
+ * every call of the SAT solver. When the activation literal is among the
+ * failed assumptions, the clause was used to derive unsatisfiability and its
+ * activity is bumped. Once the number of active clauses exceeds a limit, the
+ * least active half of them is retired by fixing their activation literal to
+ * false, such that the SAT solver can remove them. The limit grows with every
+ * reduction, so the abstraction refinement still terminates.
+ *
+ * The active clauses are kept free of subsumption: before a clause is given
+ * to the SAT solver, it is strengthened by self-subsuming resolution with the
+ * active clauses and skipped if an active clause subsumes it. Otherwise, the
+ * active clauses it subsumes are retired and the ones it strengthens are
+ * replaced. Forward checks use a one-watched-literal index, i.e., every
+ * active clause is watched by one of its literals and a subsuming clause is
+ * found among the watches of the literals of the new clause. Backward checks
+ * use full occurrence lists.
+ */
+typedef struct {
+    int_vector* lits;     // sorted, without the activation literal
+    uint64_t signature;   // over-approximation of lits for subsumption checks
+    int activation;
+    int watch;            // literal of lits watching the clause
+    double activity;
+} refinement;
+
+// Returns a fresh variable of the SAT solver that is used as activation literal
+typedef int (*refinement_activation)(void* context);
+
+typedef struct {
+    SATSolver* sat;
+    refinement_activation new_activation;
+    void* context;
+    vector* clauses;      // active refinements
+    map* occurrences;     // literal -> vector of the active clauses containing it
+    map* watches;         // literal -> vector of the active clauses watched by it
+    size_t limit;         // number of active clauses that triggers a reduction
+    double increment;     // current activity bump
+
+    // statistics
+    size_t num_learned;
+    size_t num_skipped;            // subsumed by an active clause when added
+    size_t num_strengthened;       // literals removed from new clauses
+    size_t num_strengthened_active;  // active clauses replaced by a strengthened clause
+    size_t num_retired_cold;
+    size_t num_retired_subsumed;
+    size_t num_retired_guarded;
+    size_t num_reductions;
+    size_t max_active;
+} refinement_db;
+
+refinement_db* refinement_db_init(SATSolver*, size_t limit, refinement_activation, void* context);
+void refinement_db_free(refinement_db*);
+
+/**
+ * Adds the clause guarded by a fresh activation literal unless it is subsumed
+ * by an active clause. Returns whether the clause was added, the clause itself
+ * is not modified.
+ */
+bool refinement_db_add(refinement_db*, const int_vector* clause);
+
+// Assumes the activation literals of all active clauses
+void refinement_db_assume(refinement_db*);
+
+// Bumps the activity of clauses whose activation literal failed, call after an UNSAT result
+void refinement_db_analyze_failed(refinement_db*);
+
+// Retires all clauses containing literal, e.g., clauses guarded by a literal fixed to false
+void refinement_db_retire_containing(refinement_db*, int literal);
+
+static inline size_t refinement_db_count(const refinement_db* db) {
+    return vector_count(db->clauses);
+}
+
+// Writes the active clauses, one per line as name followed by the literals and 0
+void refinement_db_write(refinement_db*, FILE*, const char* name);
+
+void refinement_db_print_statistics(refinement_db*, const char* name);
+
+#endif /* refinement_h */
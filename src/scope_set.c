@@ -0,0 +1,150 @@
+//
+//  scope_set.c
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scope_set.h"
+
+scope_set* scope_set_init(size_t num_nodes, size_t universe) {
+    assert(universe <= UINT32_MAX);
+    scope_set* set = malloc(sizeof(scope_set));
+    set->num_nodes = num_nodes;
+    set->universe = universe;
+    set->num_words = (universe + 63) / 64;
+    set->min = malloc(sizeof(uint32_t) * num_nodes);
+    set->max = calloc(num_nodes, sizeof(uint32_t));
+    set->exact = calloc(num_nodes, sizeof(uint32_t));
+    for (size_t i = 0; i < num_nodes; i++) {
+        set->min[i] = UINT32_MAX;
+    }
+    set->pool = NULL;
+    set->pool_count = 0;
+    set->pool_size = 0;
+    return set;
+}
+
+void scope_set_free(scope_set* set) {
+    if (set == NULL) {
+        return;
+    }
+    free(set->min);
+    free(set->max);
+    free(set->exact);
+    free(set->pool);
+    free(set);
+}
+
+static uint64_t* exact_words(const scope_set* set, size_t node) {
+    assert(set->exact[node] != 0);
+    return &set->pool[(set->exact[node] - 1) * set->num_words];
+}
+
+static void words_add_range(uint64_t* words, size_t from, size_t to) {
+    for (size_t element = from; element <= to; element++) {
+        words[element / 64] |= (uint64_t)1 << (element % 64);
+    }
+}
+
+/**
+ * Switches node to the exact representation, the elements are still [min, max].
+ */
+static void make_exact(scope_set* set, size_t node) {
+    assert(set->exact[node] == 0);
+    if (set->pool_count == set->pool_size) {
+        set->pool_size = set->pool_size == 0 ? 64 : 2 * set->pool_size;
+        set->pool = realloc(set->pool, sizeof(uint64_t) * set->num_words * set->pool_size);
+    }
+    assert(set->pool_count < UINT32_MAX);
+    set->exact[node] = (uint32_t)++set->pool_count;
+    uint64_t* words = exact_words(set, node);
+    memset(words, 0, sizeof(uint64_t) * set->num_words);
+    if (!scope_set_is_empty(set, node)) {
+        words_add_range(words, set->min[node], set->max[node]);
+    }
+}
+
+void scope_set_insert(scope_set* set, size_t node, size_t element) {
+    assert(node < set->num_nodes);
+    assert(element < set->universe);
+    const uint32_t value = (uint32_t)element;
+    if (scope_set_is_empty(set, node)) {
+        set->min[node] = set->max[node] = value;
+        return;
+    }
+    if (set->exact[node] == 0) {
+        if (value >= set->min[node] && value <= set->max[node]) {
+            return;
+        }
+        // still an interval if element is adjacent
+        if (value + 1 == set->min[node]) {
+            set->min[node] = value;
+            return;
+        }
+        if (value == set->max[node] + 1) {
+            set->max[node] = value;
+            return;
+        }
+        make_exact(set, node);
+    }
+    uint64_t* words = exact_words(set, node);
+    words[element / 64] |= (uint64_t)1 << (element % 64);
+    if (value < set->min[node]) {
+        set->min[node] = value;
+    }
+    if (value > set->max[node]) {
+        set->max[node] = value;
+    }
+}
+
+void scope_set_union(scope_set* set, size_t node, size_t other_node) {
+    assert(node < set->num_nodes && other_node < set->num_nodes);
+    if (scope_set_is_empty(set, other_node) || node == other_node) {
+        return;
+    }
+    if (scope_set_is_empty(set, node) && set->exact[node] == 0 && set->exact[other_node] == 0) {
+        set->min[node] = set->min[other_node];
+        set->max[node] = set->max[other_node];
+        return;
+    }
+    
+    const uint32_t other_min = set->min[other_node];
+    const uint32_t other_max = set->max[other_node];
+    
+    if (set->exact[node] == 0 && set->exact[other_node] == 0) {
+        // union of two intervals is an interval if they overlap or are adjacent
+        if ((uint64_t)other_min <= (uint64_t)set->max[node] + 1 && (uint64_t)set->min[node] <= (uint64_t)other_max + 1) {
+            if (other_min < set->min[node]) {
+                set->min[node] = other_min;
+            }
+            if (other_max > set->max[node]) {
+                set->max[node] = other_max;
+            }
+            return;
+        }
+    }
+    
+    if (set->exact[node] == 0) {
+        make_exact(set, node);
+    }
+    uint64_t* words = exact_words(set, node);
+    if (set->exact[other_node] == 0) {
+        words_add_range(words, other_min, other_max);
+    } else {
+        const uint64_t* other_words = exact_words(set, other_node);
+        for (size_t i = 0; i < set->num_words; i++) {
+            words[i] |= other_words[i];
+        }
+    }
+    if (scope_set_is_empty(set, node) || other_min < set->min[node]) {
+        set->min[node] = other_min;
+    }
+    if (other_max > set->max[node]) {
+        set->max[node] = other_max;
+    }
+}
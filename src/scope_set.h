@@ -0,0 +1,67 @@
+//
+//  scope_set.h
+//  caqe-qcir
+//
+//  Copyright © 2016 Saarland University. All rights reserved.
+//
+
+#ifndef scope_set_h
+#define scope_set_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCOPE_SET_NO_ENTRY SIZE_MAX
+
+/**
+ * Compact representation of one set of small integers (scope depths or scope
+ * ids) per circuit node, indexed by node id.
+ *
+ * Every set is stored as an interval [min, max] in dense arrays. Only sets
+ * that are not contiguous get an exact bitset in a shared pool. A set switches
+ * to the exact representation at most once, so the pool never contains
+ * garbage, and there is no allocation per node.
+ */
+typedef struct {
+    size_t    num_nodes;
+    size_t    universe;   // elements are in [0, universe)
+    size_t    num_words;  // words per exact set
+    uint32_t* min;        // min > max for the empty set
+    uint32_t* max;
+    uint32_t* exact;      // 1 + index of the exact set in pool, 0 if the set is [min, max]
+    uint64_t* pool;
+    size_t    pool_count;
+    size_t    pool_size;
+} scope_set;
+
+scope_set* scope_set_init(size_t num_nodes, size_t universe);
+void scope_set_free(scope_set*);
+
+void scope_set_insert(scope_set*, size_t node, size_t element);
+void scope_set_union(scope_set*, size_t node, size_t other_node);  // set of node |= set of other_node
+
+static inline bool scope_set_is_empty(const scope_set* set, size_t node) {
+    return set->min[node] > set->max[node];
+}
+
+static inline size_t scope_set_min(const scope_set* set, size_t node) {
+    return scope_set_is_empty(set, node) ? SCOPE_SET_NO_ENTRY : set->min[node];
+}
+
+static inline size_t scope_set_max(const scope_set* set, size_t node) {
+    return scope_set_is_empty(set, node) ? SCOPE_SET_NO_ENTRY : set->max[node];
+}
+
+static inline bool scope_set_contains(const scope_set* set, size_t node, size_t element) {
+    if (element < set->min[node] || element > set->max[node]) {
+        return false;
+    }
+    if (set->exact[node] == 0) {
+        return true;
+    }
+    const uint64_t* words = &set->pool[(set->exact[node] - 1) * set->num_words];
+    return (words[element / 64] >> (element % 64)) & 1;
+}
+
+#endif /* scope_set_h */
@@ -15,8 +15,12 @@
 #include "vector.h"
 #include "logging.h"
 #include "circuit_abstraction.h"
+#include "expansion.h"
+#include "checkpoint.h"
 #include "vector.h"
 #include "util.h"
+#include "map.h"
+#include "perf_counters.h"
 
 #ifdef PARALLEL_SOLVING
 #include "semaphore.h"
@@ -30,6 +34,7 @@ struct solver_argument {
 typedef struct {
     Solver public;
     CircuitAbstraction* abstraction;
+    Expansion* expansion;  // replaces the abstraction if the expansion engine is used
 
 #ifdef PARALLEL_SOLVING
     semaphore num_threads;
@@ -39,6 +44,26 @@ typedef struct {
     Stats* preprocessing;
     Stats* building_abstraction;
     Stats* solving;
+    
+    // hardware performance counters, NULL if disabled
+    PerfCounters* encoding_counters;
+    PerfCounters* preprocessing_counters;
+    PerfCounters* building_abstraction_counters;
+    PerfCounters* solving_counters;
+    
+    // literals of the outermost quantifier block, NULL if not available
+    int_vector* partial_assignment;
+    
+    // incremental solving
+    map* frozen_vars;            // original id to variable of the outermost existential block
+    int_vector* assumptions;     // literals (original ids) assumed in the next call of solver_sat
+    int_vector* assumption_lits; // assumptions translated to literals of the outermost abstraction
+    qbf_res result;              // of the last call of solver_sat
+    
+    // checkpoints, see checkpoint.h
+    char* snapshot;              // QCIR of the circuit after preprocessing, NULL if not written
+    uint64_t fingerprint;        // of the circuit the abstraction is built from
+    double last_checkpoint;      // time the last checkpoint was written or solving started
 } solver_private;
 
 #ifdef PARALLEL_SOLVING
@@ -109,7 +134,7 @@ static void refine(CircuitAbstraction* abstraction, CircuitAbstraction* child) {
         const lit_t b_lit = t_lit_to_b_lit(circuit, failed_t_lit);
         
         if (!int_vector_contains_sorted(abstraction->b_lits, b_lit)) {
-            satsolver_add(abstraction->sat, failed_t_lit);
+            int_vector_add(abstraction->learned_clause, failed_t_lit);
             logging_debug("t%d ", failed_var);
             assert(!int_vector_contains_sorted(abstraction->assumptions, b_lit));
             continue;
@@ -119,16 +144,20 @@ static void refine(CircuitAbstraction* abstraction, CircuitAbstraction* child) {
             assert(false);
             continue;
         }
-        satsolver_add(abstraction->sat, b_lit);
+        int_vector_add(abstraction->learned_clause, b_lit);
         logging_debug("b%d ", failed_var);
     }
     if (child->scope->node != 0) {
         const lit_t failed_var = child->scope->node;
         const lit_t b_lit = var_id_to_b_lit(circuit, failed_var);
-        satsolver_add(abstraction->sat, b_lit);
+        int_vector_add(abstraction->learned_clause, b_lit);
         logging_debug("b%d ", failed_var);
     }
-    satsolver_add(abstraction->sat, 0);
+    if (child->entry_depends_on_output) {
+        // the refinement is retracted together with the output of an extensible circuit
+        int_vector_add(abstraction->learned_clause, -abstraction->output_activation);
+    }
+    circuit_abstraction_add_refinement(abstraction);
     logging_debug("\n");
     
     if (abstraction->scope->scope_id > 1 && abstraction->options->assignment_b_lit_minimization) {
@@ -153,7 +182,7 @@ static void refine(CircuitAbstraction* abstraction, CircuitAbstraction* child) {
     printf("C ");
     for (size_t i = 0; i < vector_count(circuit->vars); i++) {
         Var* var = vector_get(circuit->vars, i);
-        if (var->scope != abstraction->scope) {
+        if (var->scope != scope) {
             continue;
         }
         if (var->shared.value == 0) {
@@ -190,6 +219,59 @@ static bool abstraction_is_enabled(Solver* solver, CircuitAbstraction* abstracti
     return int_vector_contains_sorted(abstraction->assumptions, scope_node_b_var);
 }
 
+static void write_levels_recursively(FILE* file, CircuitAbstraction* abstraction, size_t* index) {
+    checkpoint_write_level(file, (*index)++, abstraction->statistics, abstraction->refinements, abstraction->blocking_clauses);
+    for (size_t i = 0; i < abstraction->scope->num_next; i++) {
+        write_levels_recursively(file, abstraction->next[i], index);
+    }
+}
+
+static void write_checkpoint(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    const char* file_name = solver->options->checkpoint;
+    FILE* file = checkpoint_begin(file_name, private->snapshot, private->fingerprint);
+    if (file == NULL) {
+        return;
+    }
+    // split the running timer such that the time solved so far is included
+    statistics_stop_and_record_timer(private->solving);
+    statistics_start_timer(private->solving);
+    
+    checkpoint_write_statistics(file, "encoding", private->encoding);
+    checkpoint_write_statistics(file, "preprocessing", private->preprocessing);
+    checkpoint_write_statistics(file, "building", private->building_abstraction);
+    checkpoint_write_statistics(file, "solving", private->solving);
+    if (private->expansion != NULL) {
+        checkpoint_write_statistics(file, "abstraction", private->expansion->abstraction_time);
+        checkpoint_write_statistics(file, "verification", private->expansion->verification_time);
+        checkpoint_write_counterexamples(file, private->expansion->counterexamples);
+    } else {
+        size_t index = 0;
+        write_levels_recursively(file, private->abstraction, &index);
+    }
+    if (checkpoint_commit(file, file_name)) {
+        logging_info("Checkpoint written to %s\n", file_name);
+    }
+}
+
+/**
+ * Writes a checkpoint if the interval has passed since the last one. Learned
+ * clauses stay valid throughout the search, so this can be called between
+ * any two SAT calls.
+ */
+static void checkpoint_if_due(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    if (solver->options->checkpoint == NULL || get_seconds() - private->last_checkpoint < solver->options->checkpoint_interval) {
+        return;
+    }
+    write_checkpoint(solver);
+    private->last_checkpoint = get_seconds();
+}
+
+static void checkpoint_if_due_untyped(void* solver) {
+    checkpoint_if_due(solver);
+}
+
 qbf_res solve_recursive(Solver*, CircuitAbstraction* abstraction);
 
 #ifdef PARALLEL_SOLVING
@@ -297,12 +379,23 @@ qbf_res solve_recursive(Solver* solver, CircuitAbstraction* abstraction) {
     const qbf_res good_result = is_existential ? QBF_RESULT_SAT : QBF_RESULT_UNSAT;
     const qbf_res bad_result = is_existential ? QBF_RESULT_UNSAT : QBF_RESULT_SAT;
     //const solver_private* private = (solver_private*)solver;
+    size_t num_candidates = 0;  // in the current batch, see circuit_abstraction_block_candidate
     
     while (true) {
+        checkpoint_if_due(solver);
         logging_info("\n%s level %d\n", is_existential ? "existential" : "universal", abstraction->scope->scope_id);
         statistics_start_timer(abstraction->statistics);
+        perf_counters_start(abstraction->perf_counters);
         
         circuit_abstraction_assume_t_literals(abstraction, false);
+        if (abstraction->prev == NULL) {
+            // assumptions of the incremental interface, the outermost level does
+            // not refine any other level, thus, no learned clause depends on them
+            const solver_private* private = (solver_private*)solver;
+            for (size_t i = 0; i < int_vector_count(private->assumption_lits); i++) {
+                satsolver_assume(abstraction->sat, int_vector_get(private->assumption_lits, i));
+            }
+        }
         
         sat_res result = satsolver_sat(abstraction->sat);
         if (result == SATSOLVER_SATISFIABLE) {
@@ -310,6 +403,7 @@ qbf_res solve_recursive(Solver* solver, CircuitAbstraction* abstraction) {
             
             if (abstraction->scope->num_next == 0) {
                 circuit_abstraction_dual_propagation(abstraction);
+                perf_counters_stop_and_record(abstraction->perf_counters);
                 statistics_stop_and_record_timer(abstraction->statistics);
                 return good_result;
             }
@@ -317,10 +411,12 @@ qbf_res solve_recursive(Solver* solver, CircuitAbstraction* abstraction) {
             
             circuit_abstraction_get_assumptions(abstraction);
             
+            perf_counters_stop_and_record(abstraction->perf_counters);
             statistics_stop_and_record_timer(abstraction->statistics);
             
             abstraction->result = good_result;
             int_vector_reset(abstraction->local_unsat_core);
+            abstraction->local_unsat_core_depends_on_output = false;
             
 #ifdef PARALLEL_SOLVING
             solve_sub_concurrently(solver, abstraction);
@@ -330,12 +426,29 @@ qbf_res solve_recursive(Solver* solver, CircuitAbstraction* abstraction) {
             
             if (abstraction->result == good_result) {
                 circuit_abstraction_dual_propagation(abstraction);
+                circuit_abstraction_flush_refinements(abstraction);
                 return good_result;
             }
             
+            num_candidates++;
+            if (num_candidates < solver->options->refinement_batch && int_vector_count(abstraction->assumptions) > 0) {
+                circuit_abstraction_block_candidate(abstraction);
+            } else {
+                circuit_abstraction_flush_refinements(abstraction);
+                num_candidates = 0;
+            }
+            
+        } else if (num_candidates > 0) {
+            // the candidates of the batch are only blocked, the result has to be confirmed by their refinements
+            assert(result == SATSOLVER_UNSATISFIABLE);
+            perf_counters_stop_and_record(abstraction->perf_counters);
+            statistics_stop_and_record_timer(abstraction->statistics);
+            circuit_abstraction_flush_refinements(abstraction);
+            num_candidates = 0;
         } else {
             assert(result == SATSOLVER_UNSATISFIABLE);
             circuit_abstraction_get_unsat_core(abstraction);
+            perf_counters_stop_and_record(abstraction->perf_counters);
             statistics_stop_and_record_timer(abstraction->statistics);
             return bad_result;
         }
@@ -343,34 +456,45 @@ qbf_res solve_recursive(Solver* solver, CircuitAbstraction* abstraction) {
 }
 
 
-static void print_partial_assignment(Solver* solver, CircuitAbstraction* abstraction) {
+static void record_partial_assignment(Solver* solver, Scope* scope) {
+    solver_private* private = (solver_private*)solver;
     Circuit* circuit = solver->circuit;
-    printf("V ");
+    assert(private->partial_assignment == NULL);
+    private->partial_assignment = int_vector_init();
     for (size_t i = 0; i < vector_count(circuit->vars); i++) {
         Var* var = vector_get(circuit->vars, i);
-        if (var->scope != abstraction->scope) {
+        if (var->scope != scope) {
             continue;
         }
         if (var->shared.value == 0) {
             continue;
         }
-        printf("%d ", var->shared.value > 0 ? var->shared.orig_id : -var->shared.orig_id);
+        int_vector_add(private->partial_assignment, var->shared.value > 0 ? var->shared.orig_id : -var->shared.orig_id);
     }
-    printf("0\n");
 }
 
 static qbf_res solve(Solver* solver) {
     solver_private* private = (solver_private*)solver;
-    qbf_res result = solve_recursive(solver, private->abstraction);
+    if (private->partial_assignment != NULL) {
+        // from a previous call in incremental mode
+        int_vector_free(private->partial_assignment);
+        private->partial_assignment = NULL;
+    }
+    qbf_res result;
+    if (private->expansion != NULL) {
+        result = expansion_solve(private->expansion);
+    } else {
+        result = solve_recursive(solver, private->abstraction);
+    }
     bool partial_assignment = solver->options->partial_assignment;
     if (partial_assignment) {
-        CircuitAbstraction* top_level = private->abstraction;
-        if (vector_count(top_level->scope->vars) == 0 && top_level->scope->num_next == 1) {
+        Scope* top_level = solver->circuit->top_level;
+        if (vector_count(top_level->vars) == 0 && top_level->num_next == 1) {
             top_level = top_level->next[0];
         }
-        if ((result == QBF_RESULT_SAT && top_level->scope->qtype == QUANT_EXISTS)
-            || (result == QBF_RESULT_UNSAT && top_level->scope->qtype == QUANT_FORALL)) {
-            print_partial_assignment(solver, top_level);
+        if ((result == QBF_RESULT_SAT && top_level->qtype == QUANT_EXISTS)
+            || (result == QBF_RESULT_UNSAT && top_level->qtype == QUANT_FORALL)) {
+            record_partial_assignment(solver, top_level);
         }
     }
     return result;
@@ -382,6 +506,24 @@ Solver* solver_init(SolverOptions* options, Circuit* circuit) {
     private->public.options = options;
     private->public.circuit = circuit;
     private->abstraction = NULL;
+    private->expansion = NULL;
+    private->partial_assignment = NULL;
+    private->frozen_vars = NULL;
+    private->assumptions = int_vector_init();
+    private->assumption_lits = int_vector_init();
+    private->result = QBF_RESULT_UNKNOWN;
+    private->snapshot = NULL;
+    private->fingerprint = 0;
+    private->last_checkpoint = 0.0;
+    
+    api_expect(!options->incremental || !options->certify, "certification is not supported in incremental mode\n");
+    api_expect(!options->extensible || !options->certify, "certification is not supported in extensible mode\n");
+    api_expect((options->checkpoint == NULL && options->resume == NULL) || (!options->certify && !options->incremental && !options->extensible),
+               "checkpoints are not supported with certification, in incremental, or in extensible mode\n");
+    api_expect(options->resume == NULL || !options->partial_assignment, "partial assignments are not supported when resuming\n");
+#ifdef PARALLEL_SOLVING
+    api_expect(options->checkpoint == NULL, "checkpoints are not supported with parallel solving\n");
+#endif
     
 #ifdef PARALLEL_SOLVING
     semaphore_init(&private->num_threads, options->num_threads);
@@ -398,31 +540,86 @@ Solver* solver_init(SolverOptions* options, Circuit* circuit) {
     private->preprocessing = statistics_init(10000);
     private->building_abstraction = statistics_init(10000);
     private->solving = statistics_init(10000);
+    
+    if (options->perf_counters) {
+        private->encoding_counters = perf_counters_init();
+        private->preprocessing_counters = perf_counters_init();
+        private->building_abstraction_counters = perf_counters_init();
+        private->solving_counters = perf_counters_init();
+    } else {
+        private->encoding_counters = NULL;
+        private->preprocessing_counters = NULL;
+        private->building_abstraction_counters = NULL;
+        private->solving_counters = NULL;
+    }
     return &private->public;
 }
 
 void solver_free(Solver* solver) {
     solver_private* private = (solver_private*)solver;
-    circuit_abstraction_free_recursive(private->abstraction);
+    if (private->abstraction != NULL) {
+        circuit_abstraction_free_recursive(private->abstraction);
+    }
+    if (private->expansion != NULL) {
+        expansion_free(private->expansion);
+    }
+    
+#ifdef CERTIFICATION
+    if (solver->options->certify) {
+        certification_free(&solver->cert);
+    }
+#endif
+    
+    // the solver takes ownership of the circuit in solver_init
+    circuit_free(solver->circuit);
     
     statistics_free(private->encoding);
     statistics_free(private->preprocessing);
     statistics_free(private->building_abstraction);
     statistics_free(private->solving);
+    
+    perf_counters_free(private->encoding_counters);
+    perf_counters_free(private->preprocessing_counters);
+    perf_counters_free(private->building_abstraction_counters);
+    perf_counters_free(private->solving_counters);
+    
+    if (private->partial_assignment != NULL) {
+        int_vector_free(private->partial_assignment);
+    }
+    free(private->snapshot);
+    if (private->frozen_vars != NULL) {
+        map_free(private->frozen_vars);
+    }
+    int_vector_free(private->assumptions);
+    int_vector_free(private->assumption_lits);
     free(private);
 }
 
 SolverOptions* solver_get_default_options() {
     SolverOptions* options = malloc(sizeof(SolverOptions));
+    options->engine = SOLVER_ENGINE_AUTO;
     options->preprocess = true;
     options->miniscoping = false;
+    options->expansion = 0;
+    options->dependency_scheme = false;
     options->certify = false;
     options->statistics = false;
     options->partial_assignment = false;
+    options->perf_counters = false;
+    options->incremental = false;
+    options->extensible = false;
+    options->checkpoint = NULL;
+    options->checkpoint_interval = 600.0;
+    options->resume = NULL;
     
     // low level solver features
+    options->max_refinements = 2000;
+    options->refinement_batch = 1;
+    options->core_minimization = CORE_MINIMIZATION_NONE;
+    options->core_minimization_budget = 100;
     options->assignment_b_lit_minimization = true;  // minimize b_lit entry according to assignments of circuit
     options->use_partial_deref = false;
+    options->phase_guidance = false;
     options->use_combined_abstraction = true;
     
 #ifdef PARALLEL_SOLVING
@@ -432,21 +629,235 @@ SolverOptions* solver_get_default_options() {
     return options;
 }
 
-qbf_res solver_sat(Solver* solver) {
+/**
+ * Variables of the outermost existential block can be assumed in incremental
+ * mode. Assumptions on them do not invalidate any learned refinement, as the
+ * outermost level refines no other level (see solve_recursive).
+ */
+static void freeze_outermost_block(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    Scope* top_level = solver->circuit->top_level;
+    assert(top_level->qtype == QUANT_EXISTS);
+    if (private->frozen_vars == NULL) {
+        private->frozen_vars = map_init_size(vector_count(top_level->vars));
+    }
+    for (size_t i = 0; i < vector_count(top_level->vars); i++) {
+        Var* var = vector_get(top_level->vars, i);
+        if (var->frozen) {
+            // frozen before the circuit was extended
+            continue;
+        }
+        var->frozen = true;
+        map_add(private->frozen_vars, (int)var->shared.orig_id, var);
+    }
+}
+
+static const Var* get_frozen_var(Solver* solver, lit_t lit) {
+    solver_private* private = (solver_private*)solver;
+    api_expect(solver->options->incremental, "assumptions are only supported in incremental mode\n");
+    const Var* var = private->frozen_vars != NULL ? map_get(private->frozen_vars, (int)lit_to_var(lit)) : NULL;
+    api_expect(var != NULL, "only variables of the outermost existential block can be assumed, %d is not\n", lit);
+    return var;
+}
+
+static void import_assumptions(Solver* solver) {
     solver_private* private = (solver_private*)solver;
+    int_vector_reset(private->assumption_lits);
+    for (size_t i = 0; i < int_vector_count(private->assumptions); i++) {
+        const lit_t lit = int_vector_get(private->assumptions, i);
+        const Var* var = get_frozen_var(solver, lit);
+        if (var->removed) {
+            // variable does not influence the result
+            continue;
+        }
+        assert(var->scope == solver->circuit->top_level);
+        int_vector_add(private->assumption_lits, create_lit(var->shared.id, lit < 0));
+    }
+    int_vector_reset(private->assumptions);
+}
+
+/**
+ * In extensible mode, the literals of the abstraction are reserved for this
+ * many times the current number of nodes, see circuit_abstraction_extend.
+ * The abstraction is built again once they are exhausted.
+ */
+#define EXTENSION_RESERVE_FACTOR 4
+
+static void build_abstraction(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    Circuit* circuit = solver->circuit;
+    
+    circuit_compute_scope_influence(circuit);
+    if (!circuit_is_prenex(circuit)) {
+        logging_warn("The input appears to be non-prenex. Solving is supported but is less tested than prenex input. Try prenexing the formula if you encounter problems.\n");
+        circuit_compute_relevant_scopes(circuit);
+    }
+    if (circuit->extensible) {
+        circuit->t_lit_offset = EXTENSION_RESERVE_FACTOR * (var_t)circuit->max_num;
+    }
+    
+    private->abstraction = build_circuit_abstraction(solver, circuit->top_level, NULL);
+}
+
+/**
+ * The expansion engine is used for 2QBF if it is not excluded by the options,
+ * it supports neither certification, nor assumptions, nor extensions.
+ */
+static bool use_expansion(Solver* solver) {
+    const SolverOptions* options = solver->options;
+    if (options->engine == SOLVER_ENGINE_ABSTRACTION) {
+        return false;
+    }
+    const bool supported = !options->certify && !options->incremental && !options->extensible;
+    if (supported && circuit_is_2qbf(solver->circuit)) {
+        return true;
+    }
+    if (options->engine == SOLVER_ENGINE_EXPANSION) {
+        logging_warn("The expansion engine requires a 2QBF without certification, assumptions, or extensions, the abstraction is used instead\n");
+    }
+    return false;
+}
+
+/**
+ * Keeps the circuit after preprocessing for checkpoints. Resuming from the
+ * snapshot yields the same node ids again, as the circuit is encoded, and the
+ * remaining steps of build are repeated.
+ */
+static void take_snapshot(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    free(private->snapshot);
+    size_t size;
+    FILE* file = open_memstream(&private->snapshot, &size);
+    circuit_write_qcir_with_symboltable(solver->circuit, file);
+    fclose(file);
+}
+
+/**
+ * Identifies the abstraction that learned clauses refer to, i.e., the circuit
+ * and whether the combined abstraction is used, which changes the encoding.
+ */
+static uint64_t solver_fingerprint(Solver* solver) {
+    const uint64_t fingerprint = circuit_fingerprint(solver->circuit);
+    return solver->options->use_combined_abstraction ? fingerprint : ~fingerprint;
+}
+
+static void restore_levels_recursively(Solver* solver, Checkpoint* checkpoint, CircuitAbstraction* abstraction, size_t* index) {
+    checkpoint_level* level = checkpoint_get_level(checkpoint, (*index)++);
+    if (level == NULL) {
+        logging_fatal("Checkpoint %s contains no level %zu\n", solver->options->resume, *index - 1);
+    }
+    if (!statistics_merge(abstraction->statistics, level->statistics)
+        || !circuit_abstraction_restore_clauses(abstraction, level->refinements, false)
+        || !circuit_abstraction_restore_clauses(abstraction, level->blocking_clauses, true)) {
+        logging_fatal("Checkpoint %s is malformed at level %zu\n", solver->options->resume, *index - 1);
+    }
+    for (size_t i = 0; i < abstraction->scope->num_next; i++) {
+        restore_levels_recursively(solver, checkpoint, abstraction->next[i], index);
+    }
+}
+
+/**
+ * Adds the learned clauses (or counterexamples of the expansion) and the
+ * statistics of the checkpoint the circuit was read from.
+ */
+static void restore_checkpoint(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    const char* file_name = solver->options->resume;
+    Checkpoint* checkpoint = checkpoint_read(file_name);
+    if (checkpoint == NULL) {
+        logging_fatal("Cannot resume from %s\n", file_name);
+    }
+    if (checkpoint->fingerprint != private->fingerprint) {
+        logging_fatal("Checkpoint %s does not match the circuit, it was written with different options\n", file_name);
+    }
+    
+    checkpoint_restore_statistics(checkpoint, "encoding", private->encoding);
+    checkpoint_restore_statistics(checkpoint, "preprocessing", private->preprocessing);
+    checkpoint_restore_statistics(checkpoint, "building", private->building_abstraction);
+    checkpoint_restore_statistics(checkpoint, "solving", private->solving);
+    
+    const bool written_by_expansion = vector_count(checkpoint->levels) == 0;
+    if (written_by_expansion != (private->expansion != NULL)) {
+        logging_warn("Checkpoint %s was written by another engine, the learned state is ignored\n", file_name);
+    } else if (private->expansion != NULL) {
+        checkpoint_restore_statistics(checkpoint, "abstraction", private->expansion->abstraction_time);
+        checkpoint_restore_statistics(checkpoint, "verification", private->expansion->verification_time);
+        int_vector* counterexample = int_vector_init();
+        for (size_t i = 0; i < int_vector_count(checkpoint->counterexamples); i++) {
+            const int lit = int_vector_get(checkpoint->counterexamples, i);
+            if (lit != 0) {
+                int_vector_add(counterexample, lit);
+                continue;
+            }
+            expansion_add_counterexample(private->expansion, counterexample);
+            int_vector_reset(counterexample);
+        }
+        int_vector_free(counterexample);
+    } else {
+        size_t index = 0;
+        restore_levels_recursively(solver, checkpoint, private->abstraction, &index);
+    }
+    logging_info("Resumed from checkpoint %s\n", file_name);
+    checkpoint_free(checkpoint);
+}
+
+static void build(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    
+    if (solver->options->incremental) {
+        freeze_outermost_block(solver);
+    }
+    if (solver->options->extensible) {
+        // the encoding of a node in the combined abstraction depends on the
+        // parents of the node, so it would change when the circuit is extended
+        solver->options->use_combined_abstraction = false;
+        solver->circuit->extensible = true;
+    }
+    
+    // expansion, the relaxed quantifier prefix, and miniscoping change the
+    // quantification of the original variables, which is relied on by
+    // certificates, the partial assignment, assumptions, and extensions
+    const bool keep_prefix = solver->options->certify || solver->options->partial_assignment || solver->options->incremental || solver->options->extensible;
+    
     statistics_start_timer(private->encoding);
+    perf_counters_start(private->encoding_counters);
     circuit_reencode(solver->circuit);
+    perf_counters_stop_and_record(private->encoding_counters);
     statistics_stop_and_record_timer(private->encoding);
     
-    if (solver->options->preprocess) {
+    if (solver->options->extensible) {
+        api_expect(circuit_is_prenex(solver->circuit), "extensible circuits must be prenex\n");
+    }
+    
+    // preprocessing removes nodes and fixes values that extensions may depend on,
+    // a resumed circuit is the snapshot of a checkpoint that is already preprocessed
+    if (solver->options->preprocess && !solver->options->extensible && solver->options->resume == NULL) {
         statistics_start_timer(private->preprocessing);
+        perf_counters_start(private->preprocessing_counters);
         circuit_preprocess(solver->circuit);
+        if (solver->options->expansion > 0 && !keep_prefix) {
+            while (circuit_expand_universal(solver->circuit, solver->options->expansion)) {
+                circuit_preprocess(solver->circuit);
+            }
+        }
+        if (solver->options->dependency_scheme && !keep_prefix) {
+            circuit_relax_quantifier_prefix(solver->circuit);
+        }
+        perf_counters_stop_and_record(private->preprocessing_counters);
         statistics_stop_and_record_timer(private->preprocessing);
     }
     
-    if (solver->options->miniscoping) {
+    if (solver->options->checkpoint != NULL) {
+        take_snapshot(solver);
+    }
+    
+    if (solver->options->miniscoping && !keep_prefix) {
+        statistics_start_timer(private->preprocessing);
         circuit_unprenex_by_miniscoping(solver->circuit);
-        // TODO: preprocess after miniscoping?
+        if (solver->options->preprocess) {
+            circuit_preprocess(solver->circuit);
+        }
+        statistics_stop_and_record_timer(private->preprocessing);
     }
     
     if (logging_get_verbosity() >= VERBOSITY_ALL) {
@@ -463,17 +874,79 @@ qbf_res solver_sat(Solver* solver) {
     
     
     statistics_start_timer(private->building_abstraction);
-    circuit_compute_scope_influence(solver->circuit);
-    if (!circuit_is_prenex(solver->circuit)) {
-        logging_warn("The input appears to be non-prenex. Solving is supported but is less tested than prenex input. Try prenexing the formula if you encounter problems.\n");
-        circuit_compute_relevant_scopes(solver->circuit);
+    perf_counters_start(private->building_abstraction_counters);
+    if (use_expansion(solver)) {
+        private->expansion = expansion_init(solver->circuit, solver->options->checkpoint != NULL);
+        private->expansion->on_iteration = checkpoint_if_due_untyped;
+        private->expansion->context = solver;
+    } else {
+        build_abstraction(solver);
+    }
+    if (solver->options->checkpoint != NULL || solver->options->resume != NULL) {
+        private->fingerprint = solver_fingerprint(solver);
     }
+    if (solver->options->resume != NULL) {
+        restore_checkpoint(solver);
+    }
+    perf_counters_stop_and_record(private->building_abstraction_counters);
+    statistics_stop_and_record_timer(private->building_abstraction);
+}
+
+static void extend_circuit_abstraction(CircuitAbstraction* abstraction, var_t first_node) {
+    circuit_abstraction_extend(abstraction, first_node);
+    for (size_t i = 0; i < abstraction->scope->num_next; i++) {
+        extend_circuit_abstraction(abstraction->next[i], first_node);
+    }
+}
+
+void solver_extend(Solver* solver, Circuit* delta) {
+    solver_private* private = (solver_private*)solver;
+    api_expect(solver->options->extensible, "circuit can only be extended in extensible mode\n");
+    if (private->abstraction == NULL) {
+        build(solver);
+    }
+    Circuit* circuit = solver->circuit;
+    const var_t first_node = (var_t)circuit->max_num + 1;
     
-    private->abstraction = build_circuit_abstraction(solver, solver->circuit->top_level, NULL);
+    statistics_start_timer(private->encoding);
+    perf_counters_start(private->encoding_counters);
+    circuit_extend(circuit, delta);
+    perf_counters_stop_and_record(private->encoding_counters);
+    statistics_stop_and_record_timer(private->encoding);
+    
+    if (solver->options->incremental) {
+        freeze_outermost_block(solver);
+    }
+    
+    statistics_start_timer(private->building_abstraction);
+    perf_counters_start(private->building_abstraction_counters);
+    if (circuit->max_num <= circuit->t_lit_offset) {
+        circuit_compute_scope_influence(circuit);
+        extend_circuit_abstraction(private->abstraction, first_node);
+    } else {
+        logging_info("Reserved literals are exhausted, the abstraction is built again\n");
+        circuit_abstraction_free_recursive(private->abstraction);
+        build_abstraction(solver);
+    }
+    perf_counters_stop_and_record(private->building_abstraction_counters);
     statistics_stop_and_record_timer(private->building_abstraction);
+}
+
+qbf_res solver_sat(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    if (private->abstraction == NULL && private->expansion == NULL) {
+        build(solver);
+    } else {
+        // the abstraction, including all learned refinements, is reused
+        api_expect(solver->options->incremental || solver->options->extensible, "solver can be called only once if not in incremental or extensible mode\n");
+    }
+    import_assumptions(solver);
     
+    private->last_checkpoint = get_seconds();
     statistics_start_timer(private->solving);
+    perf_counters_start(private->solving_counters);
     qbf_res result = solve(solver);
+    perf_counters_stop_and_record(private->solving_counters);
     statistics_stop_and_record_timer(private->solving);
     
 #ifdef CERTIFICATION
@@ -482,33 +955,98 @@ qbf_res solver_sat(Solver* solver) {
     }
 #endif
     
+    private->result = result;
     return result;
 }
 
+void solver_assume(Solver* solver, lit_t lit) {
+    solver_private* private = (solver_private*)solver;
+    api_expect(solver->options->incremental, "assumptions are only supported in incremental mode\n");
+    api_expect(lit != 0, "literal must not be zero\n");
+    int_vector_add(private->assumptions, lit);
+}
+
+bool solver_failed(Solver* solver, lit_t lit) {
+    solver_private* private = (solver_private*)solver;
+    api_expect(private->result == QBF_RESULT_UNSAT, "failed assumptions are only available after an UNSAT result\n");
+    const Var* var = get_frozen_var(solver, lit);
+    if (var->removed) {
+        return false;
+    }
+    const lit_t sat_lit = create_lit(var->shared.id, lit < 0);
+    if (int_vector_find(private->assumption_lits, sat_lit) == VECTOR_NOT_FOUND) {
+        return false;
+    }
+    return satsolver_failed(private->abstraction->sat, sat_lit);
+}
+
 static void print_scope_statistics_recursively(CircuitAbstraction* abs) {
     printf("Statistics for %s level %d\n", abs->scope->qtype == QUANT_EXISTS ? "existential" : "universal", abs->scope->scope_id);
     statistics_print(abs->statistics);
+    perf_counters_print(abs->perf_counters);
+    if (abs->refinements != NULL) {
+        refinement_db_print_statistics(abs->refinements, "Refinements");
+        refinement_db_print_statistics(abs->blocking_clauses, "Blocking clauses");
+    }
+    if (abs->options->core_minimization != CORE_MINIMIZATION_NONE) {
+        printf("    Core minimization: %zu of %zu literals kept in %d cores using %zu SAT calls, took %f\n",
+               abs->core_literals_after,
+               abs->core_literals_before,
+               abs->core_minimization->calls_num,
+               abs->core_checks,
+               abs->core_minimization->accumulated_value);
+    }
     
     for (size_t i = 0; i < abs->scope->num_next; i++) {
         print_scope_statistics_recursively(abs->next[i]);
     }
 }
 
+int_vector* solver_get_partial_assignment(Solver* solver) {
+    solver_private* private = (solver_private*)solver;
+    return private->partial_assignment;
+}
+
+double solver_get_phase_time(Solver* solver, solver_phase phase) {
+    solver_private* private = (solver_private*)solver;
+    switch (phase) {
+        case SOLVER_PHASE_REENCODING:
+            return private->encoding->accumulated_value;
+        case SOLVER_PHASE_PREPROCESSING:
+            return private->preprocessing->accumulated_value;
+        case SOLVER_PHASE_BUILDING_ABSTRACTION:
+            return private->building_abstraction->accumulated_value;
+        case SOLVER_PHASE_SOLVING:
+            return private->solving->accumulated_value;
+        default:
+            api_expect(false, "unknown solver phase %d\n", phase);
+            return 0.0;
+    }
+}
+
 void solver_print_statistics(Solver* solver) {
     solver_private* private = (solver_private*)solver;
     
     printf("Reencoding of circuit took ");
     statistics_print_time(private->encoding);
+    perf_counters_print(private->encoding_counters);
     
     printf("Preprocessing took ");
     statistics_print_time(private->preprocessing);
+    perf_counters_print(private->preprocessing_counters);
     
     printf("Building abstraction took ");
     statistics_print_time(private->building_abstraction);
+    perf_counters_print(private->building_abstraction_counters);
     
     printf("Solving took ");
     statistics_print_time(private->solving);
+    perf_counters_print(private->solving_counters);
     
     printf("\nDetailed solving statistics:\n");
-    print_scope_statistics_recursively(private->abstraction);
+    if (private->expansion != NULL) {
+        expansion_print_statistics(private->expansion);
+    } else {
+        print_scope_statistics_recursively(private->abstraction);
+    }
 }
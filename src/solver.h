@@ -15,19 +15,48 @@
 #include "certification.h"
 #include "circuit.h"
 #include "config.h"
+#include "vector.h"
 
 
+typedef enum {
+    SOLVER_ENGINE_AUTO,         // expansion for 2QBF, abstraction otherwise
+    SOLVER_ENGINE_ABSTRACTION,  // one abstraction per quantifier level
+    SOLVER_ENGINE_EXPANSION     // counterexample guided expansion, 2QBF only, see expansion.h
+} solver_engine;
+
+typedef enum {
+    CORE_MINIMIZATION_NONE,         // failed assumptions as reported by the SAT solver
+    CORE_MINIMIZATION_DELETION,     // drop one literal after the other
+    CORE_MINIMIZATION_QUICKXPLAIN   // divide and conquer, fewer SAT calls for small cores
+} core_minimization_mode;
+
 typedef struct {
     // high level features
+    solver_engine engine;
     bool preprocess;
     bool miniscoping;
+    size_t expansion;  // expand innermost universal blocks up to this size during preprocessing, 0 disables
+    bool dependency_scheme;  // move existential variables outwards according to the standard dependency scheme
     bool certify;
     bool statistics;
     bool partial_assignment;
+    bool perf_counters;  // sample hardware performance counters per solving phase and level
+    bool incremental;    // allow repeated solving under assumptions, see solver_assume
+    bool extensible;     // allow extending the circuit between calls of solver_sat, see solver_extend
+    
+    // checkpoints, see checkpoint.h
+    const char* checkpoint;      // file the solver state is written to periodically, NULL disables
+    double checkpoint_interval;  // seconds between two checkpoints
+    const char* resume;          // checkpoint the circuit was read from, its learned state is restored
     
     // low level solver features
+    size_t max_refinements;  // active learned clauses per SAT solver before the least active are retired, 0 keeps all
+    size_t refinement_batch; // candidates per level that are evaluated before their refinements are added
+    core_minimization_mode core_minimization;  // of abstraction entries and UNSAT cores
+    size_t core_minimization_budget;  // SAT calls per minimized core, 0 is unlimited
     bool assignment_b_lit_minimization;  // minimize b_lit entry according to assignments of circuit
-    bool use_partial_deref;
+    bool use_partial_deref;  // requires SATSOLVER_PARTIAL_DEREF
+    bool phase_guidance;     // order assumptions and phases by the recent UNSAT cores
     bool use_combined_abstraction;
     
 #ifdef PARALLEL_SOLVING
@@ -44,11 +73,38 @@ typedef struct {
 #endif
 } Solver;
 
+typedef enum {
+    SOLVER_PHASE_REENCODING = 0,
+    SOLVER_PHASE_PREPROCESSING,
+    SOLVER_PHASE_BUILDING_ABSTRACTION,
+    SOLVER_PHASE_SOLVING,
+    SOLVER_PHASE_NUM
+} solver_phase;
+
 
-Solver*      solver_init(SolverOptions*, Circuit*);
+Solver*      solver_init(SolverOptions*, Circuit*);  // takes ownership of the circuit
 void         solver_free(Solver*);
 SolverOptions* solver_get_default_options(void);
-qbf_res     solver_sat(Solver*);
+qbf_res     solver_sat(Solver*);  // can be called repeatedly in incremental and extensible mode
 void         solver_print_statistics(Solver*);
+double       solver_get_phase_time(Solver*, solver_phase);  // accumulated time in seconds
+
+// Literals (original ids) of the outermost quantifier block if it is winning, i.e.,
+// existential and SAT or universal and UNSAT. NULL if the partial assignment
+// option is not set or the outermost block is losing.
+int_vector*  solver_get_partial_assignment(Solver*);
+
+// Incremental interface: assumes the literal (original id) of a variable of the
+// outermost existential block for the next call of solver_sat only. Constraints
+// can be enabled and retracted by assuming activation variables of this block.
+// Preprocessing does not fix the values of these variables in incremental mode.
+void         solver_assume(Solver*, lit_t);
+bool         solver_failed(Solver*, lit_t);  // assumption was used to derive the last UNSAT result
+
+// Extensible mode: appends the variables and gates of delta to the circuit and
+// replaces the output, see circuit_extend. The abstraction and the refinements
+// that do not depend on the old output are kept. The circuit must be prenex
+// and is not preprocessed. Delta is still owned by the caller.
+void         solver_extend(Solver*, Circuit* delta);
 
 #endif /* defined(__caqe_qcir__caqe__) */
@@ -32,7 +32,7 @@
 #include <sys/time.h>
 #include "util.h"
 
-double get_seconds() {
+double get_seconds(void) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return (double) (tv.tv_usec) / 1000000 + (double) (tv.tv_sec);
@@ -119,3 +119,57 @@ void statistics_print(Stats* s) {
     }
     printf("\n");
 }
+
+void statistics_write(Stats* s, FILE* file) {
+    fprintf(file, "%d %.17g %.17g %.17g %zu",
+            s->calls_num,
+            s->accumulated_value,
+            s->min,
+            s->max,
+            int_vector_count(s->exponential_histogram));
+    for (size_t i = 0; i < int_vector_count(s->exponential_histogram); i += 1) {
+        fprintf(file, " %d", int_vector_get(s->exponential_histogram, i));
+    }
+}
+
+bool statistics_merge(Stats* s, const char* line) {
+    int calls_num;
+    double accumulated_value, min, max;
+    size_t num_buckets;
+    int length;
+    if (sscanf(line, "%d %lf %lf %lf %zu%n", &calls_num, &accumulated_value, &min, &max, &num_buckets, &length) != 5
+        || calls_num < 0 || num_buckets >= 100) {
+        return false;
+    }
+    int buckets[100];
+    for (size_t i = 0; i < num_buckets; i += 1) {
+        line += length;
+        if (sscanf(line, "%d%n", &buckets[i], &length) != 1) {
+            return false;
+        }
+    }
+    if (calls_num == 0) {
+        return true;
+    }
+    
+    if (s->calls_num == 0) {
+        s->max = max;
+        s->min = min;
+    }
+    s->calls_num += calls_num;
+    s->accumulated_value += accumulated_value;
+    if (max > s->max) {
+        s->max = max;
+    }
+    if (min < s->min) {
+        s->min = min;
+    }
+    while (num_buckets > int_vector_count(s->exponential_histogram)) {
+        int_vector_add(s->exponential_histogram, 0);
+    }
+    for (size_t i = 0; i < num_buckets; i += 1) {
+        int cur_value = int_vector_get(s->exponential_histogram, i);
+        int_vector_set(s->exponential_histogram, i, cur_value + buckets[i]);
+    }
+    return true;
+}
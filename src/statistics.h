@@ -27,6 +27,7 @@
 #ifndef __caqe__statistics__
 #define __caqe__statistics__
 
+#include <stdbool.h>
 #include <stdio.h>
 #include "vector.h"
 
@@ -48,5 +49,12 @@ void statistics_print(Stats* s);
 void statistics_start_timer(Stats* s);
 void statistics_stop_and_record_timer(Stats* s);
 void statistics_print_time(Stats* s);
+// Wall clock time in seconds
+double get_seconds(void);
+// For storing statistics, e.g., in checkpoints:
+// Writes the recorded values on one line (without newline)
+void statistics_write(Stats* s, FILE* file);
+// Adds the values of a line written by statistics_write, returns false if the line is malformed
+bool statistics_merge(Stats* s, const char* line);
 
 #endif /* defined(__caqe__statistics__) */